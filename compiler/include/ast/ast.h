@@ -155,7 +155,7 @@ namespace caliburn
 	using ValueResult = std::variant<
 		std::monostate,
 		cllr::TypedSSA,
-		sptr<BaseType>,
+		sptr<const BaseType>,
 		sptr<cllr::LowType>,
 		sptr<Module>,
 		sptr<FunctionGroup>
@@ -168,7 +168,13 @@ namespace caliburn
 		ExprModifiers mods = {};
 		std::map<std::string, uptr<Annotation>> annotations;
 
-		Expr(ExprType t) : type(t) {}
+		//How many expressions have been made on this thread; Used to count AST nodes for CompileStats
+		static inline thread_local uint64_t made = 0;
+
+		Expr(ExprType t) : type(t)
+		{
+			++made;
+		}
 		virtual ~Expr() = default;
 
 		Token firstTkn() const noexcept override = 0;
@@ -187,11 +193,24 @@ namespace caliburn
 			return false;
 		}
 
-		//Only used by top-level statements which declare symbols. The rest, like variables, should use declareSymbols() instead
-		virtual void declareHeader(sptr<SymbolTable> table, out<ErrorHandler> err) {}
+		/*
+		Only used by top-level statements which declare symbols. The rest, like variables, should use declareSymbols() instead
+
+		Headers are declared once per set of compiler settings, since things like dynamic types depend on them. As such,
+		this cannot modify the statement itself.
+		*/
+		virtual void declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const {}
 
 		virtual ValueResult emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const = 0;
 
+		/*
+		Emits this expression as the target of an assignment. By default, that's the same as emitCodeCLLR().
+		*/
+		virtual ValueResult emitLValueCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const
+		{
+			return emitCodeCLLR(table, codeAsm);
+		}
+
 	};
 
 }
@@ -49,7 +49,7 @@ namespace caliburn
 			return canonName == rhs.canonName;
 		}
 
-		virtual sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) = 0;
+		virtual sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const = 0;
 
 	protected:
 		virtual void initLowImpl(sptr<cllr::LowType> impl, sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const {}
@@ -66,7 +66,7 @@ namespace caliburn
 		TypeArray() : BaseType(TypeCategory::ARRAY, "array") {}
 		virtual ~TypeArray() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override;
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
 	};
 
@@ -75,7 +75,7 @@ namespace caliburn
 		TypeBool() : BaseType(TypeCategory::BOOLEAN, "bool") {}
 		virtual ~TypeBool() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override
 		{
 			return codeAsm.pushType(cllr::Instruction(cllr::Opcode::TYPE_BOOL));
 		}
@@ -89,7 +89,7 @@ namespace caliburn
 		TypeFloat(uint32_t bits) : BaseType(TypeCategory::FLOAT, "fp" + std::to_string(bits)), width(bits) {}
 		virtual ~TypeFloat() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override
 		{
 			auto impl = codeAsm.pushType(cllr::Instruction(cllr::Opcode::TYPE_FLOAT, { width }));
 
@@ -110,7 +110,7 @@ namespace caliburn
 		TypeInt(uint32_t bits, bool sign) : BaseType(TypeCategory::INT, (isSigned ? "int" : "uint") + std::to_string(bits)), width(bits), isSigned(sign) {}
 		virtual ~TypeInt() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override
 		{
 			auto const typeOp = (isSigned ? cllr::Opcode::TYPE_INT_SIGN : cllr::Opcode::TYPE_INT_UNSIGN);
 
@@ -127,14 +127,13 @@ namespace caliburn
 
 		std::map<std::string_view, sptr<ParsedVar>> members;
 		std::vector<uptr<ParsedFn>> memberFns;
-		GenArgMap<cllr::LowType> variants;
 
 		TypeStruct(std::string_view name, out<uptr<GenericSignature>> sig, in<std::map<std::string_view, sptr<ParsedVar>>> members, out<std::vector<uptr<ParsedFn>>> fns)
 			: BaseType(TypeCategory::STRUCT, std::string(name)), genSig(std::move(sig)), members(members), memberFns(std::move(fns)) {}
 
 		virtual ~TypeStruct() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override;
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
 	};
 
@@ -151,7 +150,7 @@ namespace caliburn
 		TypeTexture(TextureKind tk) : BaseType(TypeCategory::TEXTURE, std::string("tex").append(TEX_TYPES.at(tk))), kind(tk) {}
 		virtual ~TypeTexture() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override;
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
 		void initLowImpl(sptr<cllr::LowType> impl, sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
@@ -159,9 +158,6 @@ namespace caliburn
 
 	struct TypeVector : BaseType
 	{
-	private:
-		GenArgMap<cllr::LowType> variants;
-	public:
 		const uint32_t elements;
 		const GenericSignature genSig = GenericSignature({
 			GenericName(GenericSymType::TYPE, "FP", GenericResult(new_sptr<ParsedType>("fp32")))
@@ -174,7 +170,7 @@ namespace caliburn
 
 		virtual ~TypeVector() = default;
 
-		virtual sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override;
+		virtual sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
 		void initLowImpl(sptr<cllr::LowType> impl, sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
@@ -185,7 +181,7 @@ namespace caliburn
 		TypeVoid() : BaseType(TypeCategory::VOID, "void") {}
 		virtual ~TypeVoid() = default;
 
-		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) override
+		sptr<cllr::LowType> resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const override
 		{
 			return codeAsm.pushType(cllr::Instruction(cllr::Opcode::TYPE_VOID));
 		}
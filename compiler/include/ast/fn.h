@@ -91,9 +91,6 @@ namespace caliburn
 
 	struct SrcFn : Function
 	{
-	private:
-		GenArgMap<SrcFnImpl> variants;
-	public:
 		std::vector<Token> invokeDims;
 		sptr<ScopeStmt> code;
 
@@ -148,9 +145,6 @@ namespace caliburn
 
 	struct SrcMethod : Method
 	{
-	private:
-		GenArgMap<SrcFnImpl> variants;
-	public:
 		std::vector<Token> invokeDims;
 		sptr<ScopeStmt> code;
 
@@ -28,14 +28,31 @@ namespace caliburn
 			return fn->code->lastTkn();
 		}
 
-		void declareHeader(sptr<SymbolTable> table, out<ErrorHandler> err) override
+		void declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const override
 		{
 			sptr<FunctionGroup> group = nullptr;
-			auto sym = table->find(name.str);
+			auto sym = table->findLocal(name.str);
 
 			MATCH_EMPTY(sym)
 			{
-				group = new_sptr<FunctionGroup>();
+				//Parent tables (like the stdlib) are shared, so overloading one of their groups copies it into this table
+				auto inherited = table->find(name.str);
+
+				MATCH_EMPTY(inherited)
+				{
+					group = new_sptr<FunctionGroup>();
+				}
+				else MATCH(inherited, sptr<FunctionGroup>, parentGroup)
+				{
+					group = new_sptr<FunctionGroup>(**parentGroup);
+				}
+				else
+				{
+					//TODO complain
+					return;
+				}
+
+				table->add(name.str, group);
 			}
 			else MATCH(sym, sptr<FunctionGroup>, fnGroup)
 			{
@@ -44,6 +61,7 @@ namespace caliburn
 			else
 			{
 				//TODO complain
+				return;
 			}
 
 			group->add(fn);
@@ -34,6 +34,15 @@ namespace caliburn
 			return name;
 		}
 
+		/*
+		Finds the module among the sources of the same project, or else loads its interface file from
+		CompilerSettings::moduleDir, then declares it under its name (or alias).
+
+		Since types can't be named through a module yet, the module's types are also declared directly, unless that
+		would shadow an existing symbol.
+		*/
+		void declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const override;
+
 		ValueResult emitCodeCLLR(sptr<SymbolTable>, out<cllr::Assembler> codeAsm) const override
 		{
 			return ValueResult();
@@ -8,7 +8,7 @@
 namespace caliburn
 {
 	/*
-	Currently deprecated; a proper module system will be added eventually
+	A named collection of symbols, e.g. an imported library. See ImportedModule in modfile.h.
 	*/
 	struct Module
 	{
@@ -15,8 +15,6 @@ namespace caliburn
 
 		std::vector<sptr<Expr>> stmts;
 
-		sptr<SymbolTable> scopeTable = new_sptr<SymbolTable>();
-
 		ScopeStmt() : Expr(ExprType::SCOPE) {}
 		//ScopeStmt(in<Token> s, in<Token> e, ParseMap data)
 
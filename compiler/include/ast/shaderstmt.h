@@ -11,6 +11,13 @@
 
 namespace caliburn
 {
+	/*
+	Translates a shader stage's finished (i.e. validated and optimized) CLLR into the output target set by the settings.
+
+	doc: The document the CLLR was emitted from, if there is one; Errors are placed within it.
+	*/
+	uptr<Shader> lowerStage(in<cllr::Assembler> codeAsm, sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errs, ptr<const TextDoc> doc, ptr<CompileStats> stats);
+
 	struct ShaderStage : ParsedObject
 	{
 		const uptr<ParsedFn> base;
@@ -49,7 +56,22 @@ namespace caliburn
 
 		void prettyPrint(out<std::stringstream> ss) const override {}
 
-		uptr<Shader> compile(sptr<const CompilerSettings> settings, out<std::vector<std::string>> errs, in<TextDoc> doc, sptr<SymbolTable> table, std::vector<IOVar> inputs, out<std::vector<IOVar>> outputs);
+		/*
+		Emits this stage's CLLR, which is also where type checking happens. Never returns null; Check the assembler's
+		errors.
+
+		stats: If not null, emission timings and counters are added to it.
+		*/
+		uptr<cllr::Assembler> emit(sptr<const CompilerSettings> settings, sptr<SymbolTable> table, in<IOLayout> ioLayout, in<CancelToken> cancel, ptr<CompileStats> stats) const;
+
+		/*
+		Returns null if compilation failed or was cancelled. Cancellation is checked between each backend stage.
+
+		stats: If not null, backend timings and counters are added to it.
+		*/
+		uptr<Shader> compile(sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errs, in<TextDoc> doc, sptr<SymbolTable> table, in<IOLayout> ioLayout, in<CancelToken> cancel, ptr<CompileStats> stats) const;
+
+		std::string getFullName() const;
 
 	};
 
@@ -79,14 +101,33 @@ namespace caliburn
 
 		void prettyPrint(out<std::stringstream> ss) const override {}
 
-		void declareHeader(sptr<SymbolTable> table, out<ErrorHandler> err) override {} //We don't add shaders to the symbol table
+		void declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const override {} //We don't add shaders to the symbol table
 
 		ValueResult emitCodeCLLR(sptr<SymbolTable>, out<cllr::Assembler> codeAsm) const override
 		{
 			return ValueResult();
 		}
 
-		void compile(sptr<SymbolTable> table, sptr<CompilerSettings> settings, out<ShaderResult> result, in<TextDoc> doc);
+		/*
+		Compiles every stage within this shader. Since the I/O layout is decided beforehand, stages don't depend on one
+		another, and are compiled in parallel on the pool. Results are still added in pipeline order.
+
+		If cancelled, the result is left with an error and possibly partial shaders; The caller is expected to discard it.
+
+		If stats are being collected, each stage's backend stats are added to the result's.
+		*/
+		void compile(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ShaderResult> result, in<TextDoc> doc, in<CancelToken> cancel, out<ThreadPool> pool) const;
+
+		/*
+		Type checks every stage by emitting its CLLR, then stops; Nothing is validated, optimized, or lowered. Stages
+		are emitted in parallel on the pool, same as compile(), and errors are added in declaration order.
+		*/
+		void check(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errs, in<TextDoc> doc, in<CancelToken> cancel, out<ThreadPool> pool) const;
+
+	private:
+		sptr<SymbolTable> makeTable(sptr<SymbolTable> table) const;
+
+		IOLayout makeIOLayout() const;
 
 	};
 
@@ -8,7 +8,10 @@
 
 namespace caliburn
 {
-	static sptr<SymbolTable> makeStdLib(sptr<const CompilerSettings> options)
+	/*
+	Builds a new table of every built-in symbol. Prefer sharedStdLib(), which only does this once.
+	*/
+	static sptr<SymbolTable> makeStdLib()
 	{
 		auto root = new_sptr<SymbolTable>();
 
@@ -40,4 +43,17 @@ namespace caliburn
 		return root;
 	}
 
-}
\ No newline at end of file
+	/*
+	Returns the process-wide standard library table, building it on first use.
+
+	It's read-only, and so are the types within it; Symbol tables only hold const types, and BaseType::resolve() is
+	const, so anything a compile makes out of them, like lowered types or generic instantiations, is kept in that
+	compile's own CLLR assembler. So every compile, on any thread, can share it.
+	Compiles declare their own symbols in a child table.
+
+	The built-ins don't depend on any settings, so there's only ever one. If one ever does, key this on the settings
+	which affect it.
+	*/
+	sptr<const SymbolTable> sharedStdLib();
+
+}
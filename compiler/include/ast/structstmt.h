@@ -17,6 +17,10 @@ namespace caliburn
 
 		Token last;
 
+		/*
+		Made by the parser once the struct is fully parsed, which takes ownership of the generic signature and member
+		functions. This way, headers can be declared over and over without remaking the type.
+		*/
 		sptr<TypeStruct> innerType = nullptr;
 		uptr<GenericSignature> genSig = nullptr;
 		std::map<std::string_view, sptr<ParsedVar>> members;
@@ -47,9 +51,15 @@ namespace caliburn
 			return false;
 		}
 
-		void declareHeader(sptr<SymbolTable> table, out<ErrorHandler> err) override
+		void declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const override
 		{
-			if (!table->add(name.str, new_sptr<TypeStruct>(name.str, genSig, members, memberFns)))
+			if (innerType == nullptr)
+			{
+				//Parsing failed
+				return;
+			}
+
+			if (!table->add(name.str, innerType))
 			{
 				//TODO complain
 			}
@@ -34,7 +34,7 @@ namespace caliburn
 		//this enables for generic constants
 		sptr<Expr>,
 		sptr<Variable>,
-		sptr<BaseType>,
+		sptr<const BaseType>,
 		//This is only used when working with generics
 		sptr<cllr::LowType>
 	>;
@@ -59,9 +59,14 @@ namespace caliburn
 		void reparent(sptr<const SymbolTable> p);
 
 		bool add(std::string_view symName, in<Symbol> sym);
-		bool addType(sptr<BaseType> t);
+		bool addType(sptr<const BaseType> t);
 
 		Symbol find(std::string_view symName) const;
+
+		/*
+		Same as find(), but ignores the parent tables.
+		*/
+		Symbol findLocal(std::string_view symName) const;
 		bool has(std::string_view symName) const;
 		bool isChildOf(sptr<SymbolTable> table) const;
 
@@ -62,7 +62,7 @@ namespace caliburn
 
 		void prettyPrint(out<std::stringstream> ss) const override;
 
-		sptr<BaseType> resolveBase(sptr<const SymbolTable> table) const;
+		sptr<const BaseType> resolveBase(sptr<const SymbolTable> table) const;
 
 		sptr<cllr::LowType> resolve(sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const;
 
@@ -123,6 +123,15 @@ namespace caliburn
 
 		virtual void emitStoreCLLR(sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm, cllr::TypedSSA rhs) = 0;
 
+		/*
+		Emits this variable as the target of an assignment, named by nameTkn. By default, it's written to through
+		whatever emitLoadCLLR() returns.
+		*/
+		virtual cllr::TypedSSA emitLValueCLLR(sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm, in<Token> nameTkn)
+		{
+			return emitLoadCLLR(table, codeAsm);
+		}
+
 	protected:
 		virtual cllr::TypedSSA emitVarCLLR(sptr<const SymbolTable> table, bool isBeingWritten, out<cllr::Assembler> codeAsm) = 0;
 
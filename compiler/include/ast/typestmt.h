@@ -7,16 +7,14 @@ namespace caliburn
 {
 	struct TypedefStmt : Expr
 	{
-		const sptr<const CompilerSettings> settings;
-
 		const Token first;
 		const Token name;
 		const bool isStrong;
 
-		sptr<ParsedType> alias;
+		const sptr<ParsedType> alias;
 		
-		TypedefStmt(sptr<const CompilerSettings> cs, in<Token> f, in<Token> n, sptr<ParsedType> t) :
-			Expr(ExprType::TYPEDEF), settings(cs), first(f), name(n), alias(t), isStrong(first.str == "strong")
+		TypedefStmt(in<Token> f, in<Token> n, sptr<ParsedType> t) :
+			Expr(ExprType::TYPEDEF), first(f), name(n), alias(t), isStrong(first.str == "strong")
 		{
 			
 		}
@@ -34,7 +32,7 @@ namespace caliburn
 		}
 
 		//FIXME not used currently
-		void declareHeader(sptr<SymbolTable> table, out<ErrorHandler> err) override
+		void declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const override
 		{
 			//TODO implement strong typing (needs wrapper)
 			//TODO implement error handling for header declaration and QUIT USING STD::COUT
@@ -46,13 +44,16 @@ namespace caliburn
 				return;
 			}
 
+			//The concrete type depends on the settings, so it can't be stored in the statement
+			sptr<ParsedType> concrete = alias;
+
 			if (alias->name == "dynamic")
 			{
 				auto outTypeName = settings->dynTypes.find(std::string(name.str));
 
 				if (outTypeName != settings->dynTypes.end())
 				{
-					alias = new_sptr<ParsedType>(outTypeName->second);
+					concrete = new_sptr<ParsedType>(outTypeName->second);
 				}
 				else //No default provided
 				{
@@ -64,7 +65,7 @@ namespace caliburn
 
 					if (auto t = alias->genericArgs->getType(0))
 					{
-						alias = t;
+						concrete = t;
 					}
 					else //Generic at index 0 is not a type
 					{
@@ -80,7 +81,7 @@ namespace caliburn
 			At this stage in compilation, the only types in the symbol table are BaseTypes.
 			Therefore, we don't need to worry about full resolving
 			*/
-			if (auto t = alias->resolveBase(table))
+			if (auto t = concrete->resolveBase(table))
 			{
 				if (!table->add(name.str, t))
 				{
@@ -90,7 +91,7 @@ namespace caliburn
 			}
 			else
 			{
-				err.err({ "Unable to resolve type", alias->name }, *alias);
+				err.err({ "Unable to resolve type", concrete->name }, *concrete);
 			}
 
 		}
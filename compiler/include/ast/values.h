@@ -328,6 +328,8 @@ namespace caliburn
 
 		ValueResult emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
 
+		ValueResult emitLValueCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const override;
+
 	};
 
 	struct MemberReadDirectValue : Expr
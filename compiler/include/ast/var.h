@@ -14,8 +14,6 @@ namespace caliburn
 
 	struct LocalVariable : Variable
 	{
-		cllr::TypedSSA varData;
-
 		LocalVariable(std::string_view name) : Variable(name) {}
 		LocalVariable(in<ParsedVar> v) : Variable(v) {}
 		virtual ~LocalVariable() {}
@@ -81,9 +79,12 @@ namespace caliburn
 
 	struct ShaderIOVariable : Variable
 	{
+		//Vertex inputs come from a vertex stage's arguments, and are read-only
+		const bool isVertexInput = false;
+
 		ShaderIOVariable(std::string_view n) : Variable(n) {}
 		ShaderIOVariable(in<ParsedVar> v) : Variable(v) {}
-		ShaderIOVariable(in<FnArg> v) : Variable(v.name)
+		ShaderIOVariable(in<FnArg> v) : Variable(v.name), isVertexInput(true)
 		{
 			typeHint = v.typeHint;
 
@@ -97,6 +98,8 @@ namespace caliburn
 
 		void emitStoreCLLR(sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm, cllr::TypedSSA value) override;
 
+		cllr::TypedSSA emitLValueCLLR(sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm, in<Token> nameTkn) override;
+
 		cllr::TypedSSA emitVarCLLR(sptr<const SymbolTable> table, bool isBeingWritten, out<cllr::Assembler> codeAsm) override;
 
 	};
@@ -9,6 +9,9 @@
 
 #else
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <stdint.h>
@@ -31,6 +34,12 @@
 
 namespace caliburn
 {
+	/*
+	The version of the compiler. Changing this invalidates every cached compilation result, so it must be bumped whenever
+	the output for a given source and settings may change.
+	*/
+	constexpr const char* COMPILER_VERSION = "0.1.0";
+
 	/*
 	Sets the type of compilation target
 
@@ -79,6 +88,23 @@ namespace caliburn
 		DEV
 	};
 
+	/*
+	Caliburn's compilation process is fairly straightforward. Errors during compilation
+	will present the user with the stage the error was generated at.
+	*/
+	enum class CompileStage
+	{
+		UNKNOWN,
+		TOKENIZER,
+		PARSER,
+		AST_VALIDATION,
+		CONDITIONAL_COMPILATION,
+		SYMBOL_GENERATION,
+		CLLR_EMIT,
+		CLLR_VALIDATION,
+		OUT_EMIT
+	};
+
 	struct CompilerSettings
 	{
 		GPUTarget gpuTarget = GPUTarget::SPIRV;
@@ -105,7 +131,73 @@ namespace caliburn
 		std::map<std::string, std::string> dynTypes;
 		uint32_t errorContextLines = 3;
 
-		char _padding[980]{};
+		/*
+		Directory for the persistent compilation cache. Leave empty to disable it.
+
+		Successfully compiled shaders are stored here, keyed by a hash of the source, every setting that affects the
+		output, and the compiler version. Later compilations with the same key skip compilation entirely. The directory
+		can be safely shared between several processes running at once.
+		*/
+		std::string cacheDir;
+
+		/*
+		Maximum size, in bytes, of the in-memory result cache used by Compiler::compileSrcShadersCached(). Once full, the
+		least recently used results are evicted. 0 disables the cache.
+		*/
+		uint64_t memCacheBytes = 64 * 1024 * 1024;
+
+		/*
+		How many worker threads Compiler::compileAsync() uses. 0 uses one per hardware thread.
+		*/
+		uint32_t workerThreads = 0;
+
+		/*
+		If true, every ShaderResult gets a filled-in CompileStats. Off by default, since timing every stage isn't free.
+		*/
+		bool collectStats = false;
+
+		/*
+		If not empty, a Chrome trace_event JSON file is written here, with spans for every compile stage, function and
+		struct instantiation, and output translation, tagged by thread. Open it in chrome://tracing or Perfetto.
+
+		The file is truncated the first time it's used in a process, and every compiler using the same path writes to it.
+		*/
+		std::string traceFile;
+
+		/*
+		Directory holding module interface files, made by Compiler::compileModule(). "import lighting;" loads
+		lighting.cbrnm from here. Loaded modules are shared across every compiler in the process.
+
+		Results in the persistent and in-memory caches are also keyed by the names, sizes, and modification times of the
+		module files here, so rebuilding a module invalidates everything compiled against it.
+		*/
+		std::string moduleDir;
+
+		/*
+		If true, every Shader also gets its stage's optimized CLLR, in Shader::cllr. It can be cached or shipped, then
+		turned into the output target later with Compiler::lowerCLLR(), without running the frontend again.
+		*/
+		bool emitCLLR = false;
+
+		/*
+		If false, ShaderResult::errors only gets each error's bare message. Formatting errors (with source lines,
+		highlighting, and notes) costs far more than finding them, which adds up when compiling lots of broken sources,
+		e.g. when fuzzing. ShaderResult::diagnostics is filled in either way, and can be formatted on demand.
+		*/
+		bool formatErrors = true;
+
+		/*
+		Maximum number of errors each stage of a compile reports; Once reached, the stage stops as soon as it can. 0
+		means no limit.
+		*/
+		uint32_t maxErrors = 100;
+
+		/*
+		If true, the parser pulls tokens from the tokenizer as it needs them, instead of tokenizing the whole source first.
+		Only the few tokens the parser can still backtrack to are held at once, which keeps memory use flat for very
+		large sources. The tokens aren't kept afterwards, so incremental re-parsing falls back to parsing everything again.
+		*/
+		bool streamTokens = false;
 
 	};
 
@@ -144,36 +236,263 @@ namespace caliburn
 
 	struct Shader
 	{
+	private:
+		friend struct ShaderResult;
+
+		std::vector<uint32_t> words;
+
+	public:
 		const ShaderType type;
-		const std::vector<uint32_t> code;
+
+		/*
+		The compiled code, as SPIR-V words. Read only, since shaders from the cached compile methods are shared with
+		other callers; See ShaderResult::takeCode() to move it out of a result the caller owns.
+		*/
+		const std::vector<uint32_t>& code = words;
 
 		std::vector<VertexInputAttribute> inputs;
 		std::vector<DescriptorSet> sets;
 
-		Shader(ShaderType t, const std::vector<uint32_t>& c) : type(t), code(c) {}
+		//The stage's optimized CLLR, in its binary format; Only filled in if CompilerSettings::emitCLLR is set
+		std::vector<uint8_t> cllr;
+
+		Shader(ShaderType t, const std::vector<uint32_t>& c) : words(c), type(t) {}
+		Shader(ShaderType t, std::vector<uint32_t>&& c) : words(std::move(c)), type(t) {}
+
+		//code refers to words, so a copy would still be looking at the original's
+		Shader(const Shader&) = delete;
+		Shader& operator=(const Shader&) = delete;
+
+	};
+
+	/*
+	Timings and counters for a single compilation; See CompilerSettings::collectStats.
+
+	Times are in nanoseconds. The tokenizer, parser, and symbol generation run once per source, so every shader compiled
+	from the same source (or prepared program) reports the same numbers for them. Backend numbers are summed across the
+	shader's stages; Since stages compile in parallel, the total can be more than the wall time of the whole compile.
+
+	Results loaded from the disk cache weren't compiled, so their stats are all 0.
+	*/
+	struct CompileStats
+	{
+		uint64_t tokenizerNs = 0;
+		uint64_t parserNs = 0;
+		uint64_t symbolGenNs = 0;
+		uint64_t cllrEmitNs = 0;
+		uint64_t cllrValidationNs = 0;
+		uint64_t optimizationNs = 0;
+		uint64_t outEmitNs = 0;
+
+		uint64_t tokens = 0;
+		uint64_t astNodes = 0;
+		uint64_t cllrInstructions = 0;
+		uint64_t ssaIDs = 0;
+		uint64_t spirvWords = 0;
+		uint64_t genericInstances = 0;
+
+		CompileStats& operator+=(const CompileStats& rhs)
+		{
+			tokenizerNs += rhs.tokenizerNs;
+			parserNs += rhs.parserNs;
+			symbolGenNs += rhs.symbolGenNs;
+			cllrEmitNs += rhs.cllrEmitNs;
+			cllrValidationNs += rhs.cllrValidationNs;
+			optimizationNs += rhs.optimizationNs;
+			outEmitNs += rhs.outEmitNs;
+
+			tokens += rhs.tokens;
+			astNodes += rhs.astNodes;
+			cllrInstructions += rhs.cllrInstructions;
+			ssaIDs += rhs.ssaIDs;
+			spirvWords += rhs.spirvWords;
+			genericInstances += rhs.genericInstances;
+
+			return *this;
+		}
+
+	};
+
+	/*
+	A single error, before any formatting is done.
+
+	Positions are 0-based lines and columns within the source; The end column is one past the last character of the
+	error. Errors which aren't about any particular code, e.g. a shader not being found, have no location.
+	*/
+	struct Diagnostic
+	{
+		CompileStage stage = CompileStage::UNKNOWN;
+		std::string message;
+		std::vector<std::string> notes;
+
+		bool hasLocation = false;
+		uint32_t startLine = 0;
+		uint32_t startColumn = 0;
+		uint32_t endLine = 0;
+		uint32_t endColumn = 0;
+
+		//A line with more context on the error, such as the start of the statement it's in
+		bool hasContext = false;
+		uint32_t contextLine = 0;
+
+		Diagnostic() = default;
+		Diagnostic(CompileStage s, std::string msg) : stage(s), message(std::move(msg)) {}
+
+		/*
+		Formats this the same way as ShaderResult::errors normally would be.
+
+		src: The source the error was found in. Only used to show lines of code around the error.
+		contextLines: How many lines to show before and after the error.
+		*/
+		CBRN_API std::string format(const std::string& src, uint32_t contextLines = 3) const;
 
 	};
 
 	struct ShaderResult
 	{
 		std::vector<std::unique_ptr<Shader>> shaders;
+
+		//Formatted errors; See CompilerSettings::formatErrors
 		std::vector<std::string> errors;
 
+		//The same errors, unformatted, in the same order
+		std::vector<Diagnostic> diagnostics;
+
+		//Only filled in if CompilerSettings::collectStats is set
+		CompileStats stats;
+
+		//Set if the compilation was abandoned through a CancelToken; Such results never have shaders
+		bool cancelled = false;
+
 		bool success() const
 		{
 			return errors.empty();
 		}
 
+		/*
+		Moves the code out of shaders[i], leaving it empty, so the binary can be kept without copying it. Only for results
+		the caller owns, hence std::move(result).takeCode(i); Results from the cached compile methods are shared, and
+		can't be emptied.
+		*/
+		std::vector<uint32_t> takeCode(size_t i) &&
+		{
+			std::vector<uint32_t> taken;
+			taken.swap(shaders.at(i)->words);
+
+			return taken;
+		}
+
 	};
 
+	/*
+	Used to abandon a compilation partway through, such as when the source was edited again before it finished.
+
+	Copies share the same state, so cancelling any copy cancels them all. Compilations check the token between stages
+	and periodically within long loops, so cancellation is not instant, but it is quick.
+	*/
+	struct CancelToken
+	{
+	private:
+		std::shared_ptr<std::atomic<bool>> flag = std::make_shared<std::atomic<bool>>(false);
+
+	public:
+		void cancel() const
+		{
+			flag->store(true, std::memory_order_relaxed);
+		}
+
+		bool isCancelled() const
+		{
+			return flag->load(std::memory_order_relaxed);
+		}
+
+	};
+
+	/*
+	Describes a single contiguous edit made to a source, in bytes.
+
+	offset: Where the edit starts; The same in both the old and new source.
+	removed: How many bytes were removed from the old source.
+	inserted: How many bytes were inserted in their place.
+	*/
+	struct TextEdit
+	{
+		size_t offset = 0;
+		size_t removed = 0;
+		size_t inserted = 0;
+
+	};
+
+	/*
+	A source file which has been tokenized and parsed, but not yet compiled.
+
+	Opaque on purpose; Nothing within can be changed after preparation, which is what allows one program to be compiled
+	any number of times, with any settings, from any number of threads at once.
+	*/
+	struct PreparedProgram;
+
+	/*
+	One compilation within a batch; See Compiler::compileBatch().
+
+	program: The program to compile, made by prepare() or the like.
+	shaderNames: The names of the shader objects to compile. If empty, every shader object will be compiled.
+	settings: The settings to compile with.
+	*/
+	struct BatchJob
+	{
+		std::shared_ptr<const PreparedProgram> program;
+		std::vector<std::string> shaderNames;
+		CompilerSettings settings;
+
+	};
+
+	/*
+	Opaque in-memory cache of compilation results; See Compiler::compileSrcShadersCached().
+	*/
+	struct ResultCache;
+
+	/*
+	Opaque pool of worker threads; See Compiler::compileAsync().
+	*/
+	struct ThreadPool;
+
+	/*
+	Counters for the in-memory result cache. All counts are since the compiler was made, or since the cache was last
+	cleared.
+	*/
+	struct CacheStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+
+		//Current contents
+		uint64_t entries = 0;
+		uint64_t bytes = 0;
+
+	};
+
+	/*
+	Compiles Caliburn source code into shaders.
+
+	Thread safety: Every method can be called from any number of threads at once on the same compiler, except for
+	construction and destruction. Its settings are fixed at construction, caches are locked internally, and results
+	are never shared unless they're immutable. Each compile gets its own tokens, AST, and CLLR assembler. Prepared
+	programs are read-only once made, and the built-in symbol table is shared read-only by every compiler in the process.
+
+	Don't destroy a compiler while other threads are still calling into it. Compiles already queued with compileAsync()
+	finish before the destructor returns.
+	*/
 	struct Compiler
 	{
 	private:
 		std::shared_ptr<CompilerSettings> settings;
+		std::shared_ptr<ResultCache> memCache;
+		std::shared_ptr<ThreadPool> pool;
 		
 	public:
-		CBRN_API Compiler() : settings(std::make_shared<CompilerSettings>()) {}
-		CBRN_API Compiler(const CompilerSettings& cs) : settings(std::make_shared<CompilerSettings>(cs)) {}
+		CBRN_API Compiler();
+		CBRN_API Compiler(const CompilerSettings& cs);
 		CBRN_API virtual ~Compiler() = default;
 
 		/*
@@ -186,6 +505,255 @@ namespace caliburn
 		*/
 		CBRN_API ShaderResult compileSrcShaders(const std::string& src, const std::string& shaderName);
 
+		/*
+		Same as compileSrcShaders(), but results are kept in a bounded in-memory cache. Meant for hot-reload loops, where
+		the same source tends to be compiled over and over.
+
+		Results are keyed by a hash of the source, the shader name, and this compiler's settings. Failed compilations are
+		cached too, since they fail the same way every time. Results are shared between callers, hence being immutable.
+
+		Safe to call from several threads at once.
+		*/
+		CBRN_API std::shared_ptr<const ShaderResult> compileSrcShadersCached(const std::string& src, const std::string& shaderName);
+
+		/*
+		Compiles raw source code on the compiler's worker pool, without blocking.
+
+		src: The source code, in ASCII. It's copied, so it need not outlive the call.
+		shaderName: The name of the shader object to compile. Cannot be empty.
+		cancel: Token which can abandon the compilation. Cancelled compilations return a result with cancelled set.
+
+		Returns a future for the result.
+		*/
+		CBRN_API std::future<ShaderResult> compileAsync(const std::string& src, const std::string& shaderName, CancelToken cancel = CancelToken());
+
+		/*
+		Same as above, but invokes a callback with the result instead of returning a future. The callback runs on one of
+		the worker threads, and must not destroy this compiler. Anything it throws is caught and dropped.
+		*/
+		CBRN_API void compileAsync(const std::string& src, const std::string& shaderName, std::function<void(ShaderResult)> callback, CancelToken cancel = CancelToken());
+
+		/*
+		Returns the current counters for the in-memory result cache.
+		*/
+		CBRN_API CacheStats getCacheStats() const;
+
+		/*
+		Empties the in-memory result cache and resets its counters. Results already handed out remain valid.
+		*/
+		CBRN_API void clearCache();
+
+		/*
+		Compiles every shader object within raw source code.
+
+		The source is only tokenized, parsed, and declared once; Every shader is then compiled against the same
+		symbol table. For sources with many shader objects, this is far cheaper than repeatedly calling
+		compileSrcShaders().
+
+		src: The source code, in ASCII. UTF-8 is currently not supported.
+
+		Returns a map of shader names to their results. If the source itself has errors, then the map will only
+		contain a single result under an empty name, since shader names cannot be empty.
+		*/
+		CBRN_API std::map<std::string, ShaderResult> compileAllShaders(const std::string& src);
+
+		/*
+		Compiles a set of shader objects within raw source code, sharing one frontend pass between all of them.
+
+		src: The source code, in ASCII. UTF-8 is currently not supported.
+		shaderNames: The names of the shader objects to compile. None can be empty.
+
+		Returns a map of shader names to their results. Every requested name will have a result, even if the
+		shader couldn't be found; An empty name gets one saying so.
+		*/
+		CBRN_API std::map<std::string, ShaderResult> compileShaders(const std::string& src, const std::vector<std::string>& shaderNames);
+
+		/*
+		Tokenizes and parses raw source code, keeping the results around for later compilation.
+
+		The source is copied, so the passed string need not outlive the program. Headers are also declared with this
+		compiler's settings; Compiling with different dynamic types will redeclare them, which is still much cheaper
+		than tokenizing and parsing again.
+
+		src: The source code, in ASCII. UTF-8 is currently not supported.
+
+		Never returns null. If the source has errors, they will be reported by every compilation of the program.
+		*/
+		CBRN_API std::shared_ptr<const PreparedProgram> prepare(const std::string& src);
+
+		/*
+		Prepares an edited version of a previously prepared program. Only the top-level declarations touched by the edit
+		are tokenized and parsed again; The rest are shared with the previous program. Meant for editors and hot reload,
+		where small edits to large sources are the norm.
+
+		previous: The program before the edit.
+		src: The entire source after the edit.
+		edit: The edit which turned the previous program's source into src.
+
+		If the edit doesn't match the sources, or the previous program had errors, then this falls back to prepare().
+		*/
+		CBRN_API std::shared_ptr<const PreparedProgram> reprepare(const std::shared_ptr<const PreparedProgram>& previous, const std::string& src, const TextEdit& edit);
+
+		/*
+		Returns the errors found while parsing a prepared program and declaring its headers with this compiler's settings,
+		without compiling any shaders.
+		*/
+		CBRN_API std::vector<std::string> diagnose(const std::shared_ptr<const PreparedProgram>& program);
+
+		/*
+		Same as above, but declares headers and formats errors with the given settings instead of this compiler's, so the
+		errors match what compiling the program with them would report.
+		*/
+		CBRN_API std::vector<std::string> diagnose(const std::shared_ptr<const PreparedProgram>& program, const CompilerSettings& cs);
+
+		/*
+		Checks raw source code for errors without compiling it. Meant for editors showing errors as the user types.
+
+		Runs the frontend and emits every shader stage's CLLR, which is where type checking happens, then stops; CLLR
+		is never validated, optimized, or lowered to the GPU target, and nothing is cached. Errors are left unformatted,
+		since editors place them by their ranges; See Diagnostic::format().
+
+		src: The source code, in ASCII. UTF-8 is currently not supported. Only needs to live until this returns.
+		*/
+		CBRN_API std::vector<Diagnostic> check(const std::string& src);
+
+		/*
+		Same as check(), but for a prepared program. Pairs well with reprepare(), so only the edited declarations are
+		parsed again.
+		*/
+		CBRN_API std::vector<Diagnostic> checkPrepared(const std::shared_ptr<const PreparedProgram>& program);
+
+		/*
+		Compiles a set of shader objects within a prepared program, using this compiler's settings.
+
+		program: The program to compile, made by prepare(). Need not come from this compiler.
+		shaderNames: The names of the shader objects to compile. If empty, every shader object will be compiled.
+
+		Returns a map of shader names to their results, in the same manner as compileShaders().
+		*/
+		CBRN_API std::map<std::string, ShaderResult> compilePrepared(const std::shared_ptr<const PreparedProgram>& program, const std::vector<std::string>& shaderNames);
+
+		/*
+		Same as compilePrepared() for a single shader object, but results go through the same in-memory cache as
+		compileSrcShadersCached(). Since that cache is keyed by the source, a program reprepared into the same source as
+		an earlier one hits the cache too.
+		*/
+		CBRN_API std::shared_ptr<const ShaderResult> compilePreparedCached(const std::shared_ptr<const PreparedProgram>& program, const std::string& shaderName);
+
+		/*
+		Same as above, but compiles with the given settings instead of this compiler's. Results are cached under the
+		settings they were compiled with, so one compiler can serve requests with any number of different settings,
+		sharing its worker pool and its bounded cache between them.
+
+		cs: The settings to compile with. The cache's size comes from this compiler's settings, not these.
+		*/
+		CBRN_API std::shared_ptr<const ShaderResult> compilePreparedCached(const std::shared_ptr<const PreparedProgram>& program, const std::string& shaderName, const CompilerSettings& cs);
+
+		/*
+		Compiles a set of shader objects within a prepared program, once for each set of settings given. Useful for
+		compiling every combination of dynamic types, optimization levels, etc. that an application needs.
+
+		Since permutations only read the prepared program, they are compiled in parallel, on the compiler's worker pool.
+
+		program: The program to compile, made by prepare().
+		shaderNames: The names of the shader objects to compile. If empty, every shader object will be compiled.
+		permutations: The settings to use for each compilation.
+
+		Returns one map of results per permutation, in the same order as the permutations.
+		*/
+		CBRN_API std::vector<std::map<std::string, ShaderResult>> compilePermutations(const std::shared_ptr<const PreparedProgram>& program, const std::vector<std::string>& shaderNames, const std::vector<CompilerSettings>& permutations);
+
+		/*
+		Compiles any number of prepared programs, each with its own shader names and settings. Meant for build tools,
+		which have a list of jobs to get through. Jobs are compiled in parallel, on the compiler's worker pool.
+
+		Returns one map of results per job, in the same order as the jobs.
+		*/
+		CBRN_API std::vector<std::map<std::string, ShaderResult>> compileBatch(const std::vector<BatchJob>& jobs);
+
+		/*
+		Lists every file a prepared program was made from, for build tools to track: The file it was prepared from, if
+		any, every project source it imports, and the interface file of every module it imports, found within this
+		compiler's module directory. Imports are followed all the way down. Module files which don't exist are left out.
+
+		Returns the paths sorted, without duplicates.
+		*/
+		CBRN_API std::vector<std::string> dependencies(const std::shared_ptr<const PreparedProgram>& program);
+
+		/*
+		Same as compileSrcShaders(), but reads the source straight from a file. The file is memory-mapped instead of
+		read into a string, and must not be modified while it's being compiled.
+
+		If the file can't be read, the result has an error saying so.
+		*/
+		CBRN_API ShaderResult compileFileShaders(const std::string& path, const std::string& shaderName);
+
+		/*
+		Compiles a batch of source files in parallel, on the compiler's worker pool. Each file is memory-mapped, and is
+		prepared and compiled independently of the others.
+
+		paths: The files to compile.
+		shaderNames: The names of the shader objects to compile within every file. If empty, every shader object in each
+		file will be compiled.
+
+		Returns one map of results per file, in the same order as the paths. A file which can't be read gets a single
+		failed result, under an empty name.
+		*/
+		CBRN_API std::vector<std::map<std::string, ShaderResult>> compileFiles(const std::vector<std::string>& paths, const std::vector<std::string>& shaderNames);
+
+		/*
+		Same as prepare(), but maps the source from a file. The program keeps the mapping open for as long as it's alive.
+
+		Returns null if the file can't be read.
+		*/
+		CBRN_API std::shared_ptr<const PreparedProgram> prepareFile(const std::string& path);
+
+		/*
+		Turns a single shader stage's CLLR, taken from Shader::cllr, into the output target set by this compiler's
+		settings. Only the backend runs; The CLLR is already optimized, so optimization settings don't apply.
+
+		CLLR only loads into the same version of the compiler which made it. If it doesn't load, the result has an error
+		saying so. Loaded CLLR is always fully validated before it's lowered, whatever the validation level is set to.
+
+		Returns a result with a single shader on success. Descriptor sets aren't part of CLLR, so they're left empty.
+		*/
+		CBRN_API ShaderResult lowerCLLR(const std::vector<uint8_t>& cllr);
+
+		/*
+		Prepares a project: A set of source files which import each other. Files starting with a module statement, e.g.
+		"module lighting;", can be imported by the others under that name, without needing a module interface file.
+
+		Files are tokenized and parsed in parallel on the compiler's worker pool, after which headers are declared in
+		parallel too, with each file waiting only on the files it imports. The results are the same however the work
+		happens to be scheduled.
+
+		Returns one program per path, in the same order. Files which can't be read, or which are part of a circular
+		import, get a program with an error. Programs keep the files they import alive.
+		*/
+		CBRN_API std::vector<std::shared_ptr<const PreparedProgram>> prepareProject(const std::vector<std::string>& paths);
+
+		/*
+		Prepares a project as above, then compiles every file in it in parallel, in the same manner as compileFiles().
+
+		Results compiled against an imported file are cached under that file's contents too, so editing an import
+		invalidates them.
+		*/
+		CBRN_API std::vector<std::map<std::string, ShaderResult>> compileProject(const std::vector<std::string>& paths, const std::vector<std::string>& shaderNames);
+
+		/*
+		Precompiles a library source into a module interface file, which other sources can then import without
+		tokenizing or parsing the library again.
+
+		The source must start with a module statement, e.g. "module lighting;", and the file should be written to
+		CompilerSettings::moduleDir as <module name>.cbrnm. Shaders within the source aren't part of the module.
+
+		The file is written to a temporary file, then renamed into place, so compiles running at the same time see either
+		the old module or the new one.
+
+		Returns every error found; Nothing is written if there are any.
+		*/
+		CBRN_API std::vector<std::string> compileModule(const std::string& src, const std::string& outPath);
+
 	};
 
 }
@@ -0,0 +1,52 @@
+
+#pragma once
+
+#include <cstddef>
+
+/*
+Picks the widest vector instructions the compiler is allowed to use. AVX2 has to be turned on at build time (see
+CALIBURN_AVX2 in CMakeLists.txt), since it's not available everywhere; SSE2 is always there on x86-64.
+*/
+#if defined(__AVX2__)
+#define CBRN_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CBRN_SCAN_SSE2 1
+#endif
+
+namespace caliburn
+{
+	/*
+	Character scanners for the tokenizer. Each one looks at 16 or 32 bytes at a time where SIMD is available, and one
+	at a time otherwise; Results are the same either way.
+
+	Every scanner takes the text to scan and its length, and returns how many bytes from the start of the text match
+	(or, for the find functions, come before a match). If the whole text matches, that's its length.
+	*/
+
+	/*
+	Name of the scanner implementation in use; "AVX2", "SSE2", or "scalar".
+	*/
+	const char* charScanImpl();
+
+	/*
+	Length of the run of whitespace, which is every ASCII control char and the space.
+	*/
+	size_t scanWhitespace(const char* text, size_t len);
+
+	/*
+	Length of the run of identifier chars; ASCII letters, digits, underscores, and anything outside of ASCII.
+	*/
+	size_t scanIdentifier(const char* text, size_t len);
+
+	/*
+	Offset of the first newline. Used to skip comments.
+	*/
+	size_t findLineEnd(const char* text, size_t len);
+
+	/*
+	Offset of the first char that a string literal's body can't just skip over; The delimiter, a backslash, or a
+	newline.
+	*/
+	size_t findStringStop(const char* text, size_t len, char delim);
+
+}
@@ -19,7 +19,8 @@ namespace caliburn
 	  - Instructions define what the elements in the tuple do.
 	- Represents a single compilation unit.
 	- Flattened down to shader stages, functions, structs, and basic instructions.
-	- Not distributed; Only used internally by compiler.
+	- Can be saved in a compact binary format (see Assembler::save()), so that it can be cached, or shipped and lowered
+	  to an output target later. The format is versioned, but only loads with the same version it was saved with.
 	*/
 	namespace cllr
 	{
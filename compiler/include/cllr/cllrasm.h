@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <deque>
 #include <map>
 #include <stack>
 #include <string>
@@ -12,10 +13,14 @@
 
 #include "cllr.h"
 
+#include "ast/generics.h"
 #include "ast/symbols.h"
 
 namespace caliburn
 {
+	struct Function;
+	struct SrcFnImpl;
+
 	namespace cllr
 	{
 		/*
@@ -55,19 +60,26 @@ namespace caliburn
 
 			std::vector<std::string> strs;
 
+			const IOLayout ioLayout;
 			std::map<std::string_view, IOVar> ioVars;
+			//Names of I/O variables within loaded code; Emitted code views the AST's names instead
+			std::deque<std::string> ioNames;
 			std::map<std::string_view, TypedSSA> ioVarIDs;
 
+			/*
+			Types, functions, and variables are shared between every compile using the same symbol table, but the
+			SSAs they emit are only valid within this assembler. So their code is cached here, not on themselves.
+			*/
+			HashMap<ptr<const BaseType>, GenArgMap<LowType>> typeImpls;
+			HashMap<ptr<const Function>, GenArgMap<SrcFnImpl>> fnImpls;
+			HashMap<ptr<const Variable>, TypedSSA> varIDs;
+
 		public:
-			Assembler(ShaderType t, sptr<const CompilerSettings> cs, std::vector<IOVar> vars) :
-				type(t), settings(cs)
-			{
-				for (auto const& var : vars)
-				{
-					ioVars.emplace(var.name, var);
-				}
+			//Checked between statements; If cancelled, code emission stops early
+			CancelToken cancel;
 
-			}
+			Assembler(ShaderType t, sptr<const CompilerSettings> cs, in<IOLayout> layout = {}) :
+				type(t), errors(new_uptr<ErrorHandler>(CompileStage::CLLR_EMIT, cs)), settings(cs), ioLayout(layout) {}
 
 			virtual ~Assembler() = default;
 
@@ -76,6 +88,16 @@ namespace caliburn
 				return allCode;
 			}
 
+			uint32_t getSSACount() const
+			{
+				return nextSSA - 1;
+			}
+
+			/*
+			Counts the generic types and functions which were instantiated with at least one generic argument.
+			*/
+			size_t countGenericImpls() const;
+
 			SSA beginSect(out<Instruction> i);
 			bool hasSect() const;
 			Instruction getSectHeader();
@@ -93,7 +115,18 @@ namespace caliburn
 			TypedSSA pushValue(out<Instruction> ins, sptr<LowType> type);
 			sptr<LowType> pushType(Opcode op);
 			sptr<LowType> pushType(out<Instruction> ins);
+			/*
+			Declares a shader I/O variable, or returns the existing one.
+
+			Whether it's an input or an output is decided by its first use within this shader stage. Variables within
+			the I/O layout use their location from it; The rest, such as vertex inputs, are numbered in order of use.
+			*/
 			TypedSSA pushIOVar(std::string_view name, ShaderIOVarType type, sptr<LowType> dataType);
+			/*
+			Takes the next output location for something which isn't an I/O variable, i.e. a fragment shader's returned
+			colour. Has to be called before any outputs are declared, or they may be numbered around it.
+			*/
+			uint32_t reserveOutput();
 
 			void beginLoop(SSA start, SSA end);
 			SSA getLoopStart() const;
@@ -103,6 +136,21 @@ namespace caliburn
 			size_t addString(in<std::string> str);
 			std::string getString(size_t index) const;
 
+			out<GenArgMap<LowType>> getTypeImpls(ptr<const BaseType> t)
+			{
+				return typeImpls[t];
+			}
+
+			out<GenArgMap<SrcFnImpl>> getFnImpls(ptr<const Function> fn)
+			{
+				return fnImpls[fn];
+			}
+
+			out<TypedSSA> getVarData(ptr<const Variable> v)
+			{
+				return varIDs[v];
+			}
+
 			std::vector<IOVar> getIOByType(ShaderIOVarType type) const
 			{
 				std::vector<IOVar> inputs;
@@ -143,9 +191,28 @@ namespace caliburn
 			*/
 			uint32_t flatten();
 
+			/*
+			Serializes the finished code into the binary CLLR format; See cllrfile.cpp for the layout. Covers the
+			instructions, string table, and I/O variables, which is everything a backend needs. Debug tokens, and
+			anything only used while emitting (e.g. struct members), aren't kept.
+
+			Only whole code can be saved, i.e. with no code sections left open.
+			*/
+			void save(out<std::vector<uint8_t>> bytes) const;
+
+			/*
+			Loads code saved by save(), ready to be validated, optimized, or translated into an output target. The
+			settings needn't match the ones the code was emitted with.
+
+			Returns null if the data is malformed, or was saved by a different version of the format.
+			*/
+			static uptr<Assembler> load(in<std::vector<uint8_t>> bytes, sptr<const CompilerSettings> cs);
+
 		private:
 			void doBookkeeping(in<Instruction> i);
 
+			sptr<LowType> makeType(in<Instruction> ins);
+
 		};
 
 		struct Section
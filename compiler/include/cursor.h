@@ -0,0 +1,183 @@
+
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include "basic.h"
+
+namespace caliburn
+{
+	/*
+	Cursor is a read-only view over a contiguous array, with an index into it. It doesn't own or copy anything, so the
+	array has to outlive it.
+
+	Reading past either end gives back a placeholder instead of going out of bounds, since truncated sources make the
+	tokenizer and parser look past the end all the time. Debug builds throw std::out_of_range instead, to catch code
+	which relies on that by mistake.
+	*/
+	template<typename T>
+	struct Cursor
+	{
+	private:
+		const T* data = nullptr;
+		size_t len = 0;
+		size_t index = 0;
+
+		//Given out for anything out of bounds
+		T pastEnd{};
+
+		const T& at(size_t i) const
+		{
+#ifndef NDEBUG
+			if (i >= len)
+			{
+				throw std::out_of_range("Cursor index out of range");
+			}
+#endif
+
+			return i < len ? data[i] : pastEnd;
+		}
+
+	public:
+		Cursor(const T* d, size_t n, in<T> end = T()) : data(d), len(n), pastEnd(end) {}
+
+		Cursor(in<std::vector<T>> backend, in<T> end = T()) : Cursor(backend.data(), backend.size(), end) {}
+
+		/*
+		Direct accessor
+		*/
+		const T& operator[](size_t i) const
+		{
+			return at(i);
+		}
+
+		/*
+		Returns true if more than count elements are available from the current offset
+		*/
+		bool hasRem(size_t count) const
+		{
+			return remaining() > count;
+		}
+
+		/*
+		Returns true if the current offset points to a valid element
+		*/
+		bool hasCur() const
+		{
+			return index < len;
+		}
+
+		/*
+		Fetches the element at the current offset
+		*/
+		const T& cur() const
+		{
+			return at(index);
+		}
+
+		/*
+		Increments offset, then returns the element at the new offset.
+		*/
+		const T& next()
+		{
+			++index;
+			return at(index);
+		}
+
+		/*
+		Saves element at current index, increments index, then returns.
+		*/
+		const T& take()
+		{
+			auto const& x = at(index);
+			++index;
+			return x;
+		}
+
+		/*
+		Returns the element at (index + offset).
+		*/
+		const T& peek(size_t off) const
+		{
+			return at(index + off);
+		}
+
+		/*
+		Returns the element at (index - offset). Anything before the start wraps around, so it's out of bounds too.
+		*/
+		const T& peekBack(size_t off) const
+		{
+			return at(index - off);
+		}
+
+		const T& first() const
+		{
+			return at(0);
+		}
+
+		const T& last() const
+		{
+			return at(len - 1);
+		}
+
+		/*
+		Pointer to the element at the current offset, for scanning ahead. Only remaining() elements are valid.
+		*/
+		const T* curPtr() const
+		{
+			return data + (index < len ? index : len);
+		}
+
+		/*
+		Increments the current offset. That's it.
+		*/
+		void consume(size_t count = 1)
+		{
+			index += count;
+		}
+
+		size_t offset() const
+		{
+			return index;
+		}
+
+		size_t length() const
+		{
+			return len;
+		}
+
+		/*
+		Never underflows, even if the offset was moved past the end.
+		*/
+		size_t remaining() const
+		{
+			return index < len ? len - index : 0;
+		}
+
+		/*
+		Manually sets the offset.
+
+		Despite the name, no check is done to ensure the passed offset is less than the current one.
+		*/
+		void revertTo(size_t i)
+		{
+			index = i;
+		}
+
+		/*
+		Subtracts the current offset by the passed offset.
+
+		If this will result in an integer underflow, nothing happens.
+		*/
+		void rewind(size_t off = 1)
+		{
+			if (off <= index)
+			{
+				index -= off;
+			}
+		}
+
+	};
+
+}
@@ -0,0 +1,77 @@
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "basic.h"
+#include "sha256.h"
+
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+
+namespace caliburn
+{
+	/*
+	A persistent, content-addressed cache of compiled shaders.
+
+	Each entry is a single file named after the key's digest, which covers the source, every setting that affects the
+	output, the compiler version, and the shader name. Since the key covers everything, entries are never invalidated;
+	They simply stop being looked up.
+
+	Multiple processes can use the same directory at once. Entries are written to a uniquely-named temporary file, then
+	renamed into place, so a reader will either see a whole entry or none at all. Unreadable entries are treated as
+	misses, and only successful compilations are stored.
+	*/
+	struct DiskCache
+	{
+		const std::string dir;
+
+		DiskCache(in<std::string> d) : dir(d) {}
+		virtual ~DiskCache() = default;
+
+		/*
+		Hashes everything that goes into a key except the shader name. Every shader in a source shares it, so hash it
+		once and make each shader's key with makeKey(srcKey, shaderName).
+
+		importKey: Covers whatever other project sources the source imports; See PreparedProgram::importKey.
+		*/
+		static Digest makeSourceKey(std::string_view src, in<CompilerSettings> settings, std::string_view importKey = "");
+
+		static Digest makeKey(in<Digest> srcKey, std::string_view shaderName);
+
+		static Digest makeKey(std::string_view src, in<CompilerSettings> settings, std::string_view shaderName, std::string_view importKey = "")
+		{
+			return makeKey(makeSourceKey(src, settings, importKey), shaderName);
+		}
+
+		/*
+		A digest of the name, size and modification time of every module file in moduleDir, which goes into each key so
+		that rebuilding a module misses the cache, whether it's renamed into place or rewritten. The list of files is kept
+		per directory, and only read again once the directory changes, or after forgetModuleStamps(); Every file in it is
+		stamped on each call.
+		*/
+		static Digest moduleStamp(in<std::string> moduleDir);
+
+		/*
+		Drops every kept list of module files; Called whenever this process writes a module.
+		*/
+		static void forgetModuleStamps();
+
+		/*
+		Loads a cached result. Returns false if there's no entry, or if the entry couldn't be read; Those are deleted, so
+		that the next store() replaces them.
+		*/
+		bool load(in<Digest> key, out<ShaderResult> result) const;
+
+		/*
+		Stores a successful result. Failures to write are silently ignored, since the cache is only an optimization.
+		*/
+		void store(in<Digest> key, in<ShaderResult> result) const;
+
+	private:
+		std::string entryPath(in<Digest> key) const;
+
+	};
+
+}
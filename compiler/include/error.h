@@ -10,23 +10,6 @@
 
 namespace caliburn
 {
-	/*
-	Caliburn's compilation process is fairly straightforward. Errors during compilation
-	will present the user with the stage the error was generated at.
-	*/
-	enum class CompileStage
-	{
-		UNKNOWN,
-		TOKENIZER,
-		PARSER,
-		AST_VALIDATION,
-		CONDITIONAL_COMPILATION,
-		SYMBOL_GENERATION,
-		CLLR_EMIT,
-		CLLR_VALIDATION,
-		OUT_EMIT
-	};
-
 	/*
 	Strings for the CompileStage enum
 	*/
@@ -36,6 +19,35 @@ namespace caliburn
 		"Target Compilation"
 	};
 
+	/*
+	Joins words with a space after each, which is how messages are built from several pieces. Much cheaper than a
+	stringstream.
+	*/
+	template<typename Strs>
+	std::string joinWords(in<Strs> words)
+	{
+		std::string joined;
+
+		for (auto const& word : words)
+		{
+			joined.append(word);
+			joined.push_back(' ');
+		}
+
+		return joined;
+	}
+
+	/*
+	Formats a diagnostic against the document it came from. Lines and columns outside of the document are ignored, so
+	any document can be passed in.
+	*/
+	std::string formatDiagnostic(in<Diagnostic> d, in<TextDoc> doc, uint32_t contextLines);
+
+	/*
+	Turns diagnostics into ShaderResult-style error strings, formatted or not depending on the settings.
+	*/
+	void formatDiagnostics(in<std::vector<Diagnostic>> diags, in<TextDoc> doc, in<CompilerSettings> settings, out<std::vector<std::string>> out);
+
 	struct Error
 	{
 		CompileStage stage = CompileStage::UNKNOWN;
@@ -57,16 +69,14 @@ namespace caliburn
 
 		void note(in<std::vector<std::string>> idea_list)
 		{
-			std::stringstream ss;
-
-			for (auto const& item : idea_list)
-				ss << item << ' ';
-
-			notes.push_back(ss.str());
-
+			notes.push_back(joinWords(idea_list));
 		}
 
-		std::string print(in<TextDoc> txt, sptr<const CompilerSettings> settings) const;
+		/*
+		doc: If not null, token positions are looked up within it, so that tokens from declarations reused by
+		reprepareProgram() are placed where they are now, not where they were parsed.
+		*/
+		Diagnostic toDiagnostic(ptr<const TextDoc> doc = nullptr) const;
 
 	};
 
@@ -75,11 +85,33 @@ namespace caliburn
 
 	Also note that errors are handled via shared pointers. This is to enable for the creation of notes after
 	initial error creation.
+
+	Once CompilerSettings::maxErrors errors are made, the rest are dropped without building their messages. Stages
+	should check isFull() and stop early.
 	*/
 	struct ErrorHandler
 	{
 	private:
 		sptr<const CompilerSettings> settings;
+
+		//Handed out in place of dropped errors, so callers can still add notes to them
+		sptr<Error> overflow;
+		size_t dropped = 0;
+
+		sptr<Error> drop()
+		{
+			++dropped;
+
+			if (overflow == nullptr)
+			{
+				overflow = new_sptr<Error>();
+			}
+
+			overflow->notes.clear();
+
+			return overflow;
+		}
+
 	public:
 		const CompileStage stage;
 
@@ -99,40 +131,48 @@ namespace caliburn
 			out.insert(out.end(), errors.begin(), errors.end());
 		}
 
-		void printout(out<std::vector<std::string>> out, in<TextDoc> doc) const
+		bool isFull() const
 		{
-			for (auto const& e : errors)
-			{
-				out.push_back(e->print(doc, settings));
-			}
-
+			return settings->maxErrors != 0 && errors.size() >= settings->maxErrors;
 		}
 
+		/*
+		Adds every error as a diagnostic, plus one more if any were dropped.
+
+		doc: The document the errors were found in, if known; See Error::toDiagnostic().
+		*/
+		void report(out<std::vector<Diagnostic>> out, ptr<const TextDoc> doc = nullptr) const;
+
 		//Error-generation methods beyond this point
 
 		sptr<Error> err(in<std::vector<std::string_view>> msgs, in<ParsedObject> keyObj)
 		{
-			std::stringstream ss;
-
-			for (auto const& msg : msgs)
-				ss << msg << ' ';
+			if (isFull())
+			{
+				return drop();
+			}
 
-			return err(ss.str(), keyObj);
+			return err(joinWords(msgs), keyObj);
 		}
 
 		sptr<Error> err(in<std::string> msg, in<ParsedObject> keyObj)
 		{
+			if (isFull())
+			{
+				return drop();
+			}
+
 			return err(msg, keyObj.firstTkn(), keyObj.lastTkn());
 		}
 
 		sptr<Error> err(in<std::vector<std::string_view>> msgs, in<Token> keyTkn)
 		{
-			std::stringstream ss;
-
-			for (auto const& msg : msgs)
-				ss << msg << ' ';
+			if (isFull())
+			{
+				return drop();
+			}
 
-			return err(ss.str(), keyTkn);
+			return err(joinWords(msgs), keyTkn);
 		}
 
 		sptr<Error> err(in<std::string> msg, in<Token> keyTkn)
@@ -142,12 +182,12 @@ namespace caliburn
 
 		sptr<Error> err(in<std::vector<std::string_view>> msgs, in<Token> startTkn, in<Token> endTkn)
 		{
-			std::stringstream ss;
-
-			for (auto const& msg : msgs)
-				ss << msg << ' ';
+			if (isFull())
+			{
+				return drop();
+			}
 
-			return err(ss.str(), startTkn, endTkn);
+			return err(joinWords(msgs), startTkn, endTkn);
 		}
 
 		sptr<Error> err(in<std::vector<std::string>> msgs)
@@ -157,22 +197,22 @@ namespace caliburn
 
 		sptr<Error> err(in<std::initializer_list<std::string>> msgs, in<Token> tkn)
 		{
-			std::stringstream ss;
-
-			for (auto const& msg : msgs)
-				ss << msg << ' ';
+			if (isFull())
+			{
+				return drop();
+			}
 
-			return err(ss.str(), tkn, tkn);
+			return err(joinWords(msgs), tkn, tkn);
 		}
 
 		sptr<Error> err(in<std::vector<std::string>> msgs, in<Token> tkn)
 		{
-			std::stringstream ss;
-
-			for (auto const& msg : msgs)
-				ss << msg << ' ';
+			if (isFull())
+			{
+				return drop();
+			}
 
-			return err(ss.str(), tkn, tkn);
+			return err(joinWords(msgs), tkn, tkn);
 		}
 
 		sptr<Error> err(in<std::string> msg, in<Token> tknStart, in<Token> tknEnd);
@@ -39,6 +39,12 @@ namespace caliburn
 		uint32_t index;
 	};
 
+	/*
+	Maps the name of each shader I/O variable to its location. Every stage within a shader uses the same layout, so
+	one stage's outputs line up with the next stage's inputs without either one being compiled first.
+	*/
+	using IOLayout = std::map<std::string_view, uint32_t>;
+
 	//TODO audit these texture variants
 	enum class TextureKind
 	{
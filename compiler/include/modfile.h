@@ -0,0 +1,127 @@
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "basic.h"
+#include "source.h"
+
+#include "ast/ast.h"
+#include "ast/module.h"
+
+namespace caliburn
+{
+	struct PreparedProgram;
+
+	//Module interface files are named <module name> + this, and looked up in CompilerSettings::moduleDir
+	static constexpr std::string_view MODULE_FILE_EXT = ".cbrnm";
+
+	/*
+	A module's headers, declared with one set of dynamic types, and the errors found doing so. Positions within the
+	errors are within the module's own text.
+	*/
+	struct ModuleHeaders
+	{
+		sptr<SymbolTable> table;
+		std::vector<Diagnostic> errors;
+
+	};
+
+	/*
+	A module loaded from a binary interface file.
+
+	The file holds the module's source text, followed by its already-parsed top-level declarations: Types, function
+	signatures, generic templates, and every function body, since generics are instantiated from the AST. So loading
+	one never tokenizes or parses anything.
+
+	Like a prepared program, nothing here changes after loading, so one module is shared by every compile that imports
+	it. Headers depend on the dynamic types, so they're declared once per set of them; See headers().
+	*/
+	struct ModuleInterface
+	{
+	private:
+		mutable std::mutex headerLock;
+		mutable std::map<std::map<std::string, std::string>, sptr<const ModuleHeaders>> declared;
+
+	public:
+		std::string name;
+
+		//The whole interface file; Every token in the AST is a view into its source text section
+		sptr<const SourceText> file;
+
+		//The module's own source; Token positions in the AST are lines and columns within it
+		std::string_view text;
+
+		//Strings the AST refers to which aren't in the source text
+		std::deque<std::string> strings;
+
+		std::vector<sptr<Expr>> ast;
+
+		/*
+		Decodes an interface file. Returns null if it's malformed, or was written by a different compiler version.
+		*/
+		static sptr<const ModuleInterface> read(sptr<const SourceText> file);
+
+		/*
+		Finds and loads a module from a directory of interface files.
+
+		Loaded modules are kept for the life of the process, and shared between every compiler. A module is only loaded
+		again if its file changes, so interface files should be replaced (e.g. by renaming over them), not rewritten in
+		place; The old file stays mapped for as long as anything still uses it. On Windows, where a mapped file can't be
+		renamed over, modules are read into memory instead.
+
+		Returns null if the module doesn't exist or couldn't be read.
+		*/
+		static sptr<const ModuleInterface> find(in<std::string> dir, in<std::string> name);
+
+		/*
+		Returns the module's headers, as declared with the given settings. They're only declared the first time a set of
+		dynamic types is used, then shared by every compile using the same ones, like a prepared program's headers.
+
+		Imports within the module are resolved against the module directory only; Sources of whichever project imported
+		it can't be seen from inside.
+		*/
+		sptr<const ModuleHeaders> headers(sptr<const CompilerSettings> settings) const;
+
+	};
+
+	/*
+	The symbol an import statement declares. Its table holds the module's headers, declared with the importing compile's
+	settings.
+	*/
+	struct ImportedModule : Module
+	{
+		const sptr<const ModuleInterface> iface;
+		const sptr<SymbolTable> table;
+
+		ImportedModule(sptr<const ModuleInterface> i, sptr<SymbolTable> t) : iface(i), table(t) {}
+		virtual ~ImportedModule() = default;
+
+		sptr<SymbolTable> getTable() const override
+		{
+			return table;
+		}
+
+	};
+
+	/*
+	Serializes a successfully prepared program into a module interface file. The program must have a module statement,
+	which names the module. Shaders aren't part of a module's interface, and are left out.
+
+	Returns false, with errors added, if the program can't be made into a module.
+	*/
+	bool writeModule(in<PreparedProgram> prog, out<std::string> bytes, out<std::vector<std::string>> errors);
+
+	/*
+	Writes an interface file atomically: First to a temporary file, then renamed over the path. Returns false if either
+	step failed.
+	*/
+	bool storeModuleFile(in<std::string> path, in<std::string> bytes);
+
+	std::string moduleFilePath(in<std::string> dir, std::string_view name);
+
+}
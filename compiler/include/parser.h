@@ -4,9 +4,9 @@
 #include <functional>
 #include <utility>
 
-#include "buffer.h"
 #include "error.h"
 #include "syntax.h"
+#include "tokencursor.h"
 
 #include "ast/ast.h"
 #include "ast/fn.h"
@@ -34,15 +34,59 @@ namespace caliburn
 	{
 	private:
 		sptr<const CompilerSettings> settings;
-		Buffer<Token> tkns;
+		TokenCursor tkns;
+
 	public:
 		const uptr<ErrorHandler> errors;
 
-		Parser(sptr<const CompilerSettings> cs, in<std::vector<Token>> tokenVec) :
-			settings(cs), tkns(tokenVec), errors(new_uptr<ErrorHandler>(CompileStage::PARSER, cs)) {}
+		/*
+		Token offsets at which each declaration returned by parse() starts. Used for incremental re-parsing.
+		*/
+		std::vector<size_t> declStarts;
+
+		/*
+		The first token of each declaration returned by parse(). Streamed tokens are gone once parsed, so these are kept
+		here instead.
+		*/
+		std::vector<Token> declFirstTkns;
+
+		//How many expressions parse() made, including ones which were backtracked over
+		uint64_t nodeCount = 0;
+
+		//Checked between declarations; If cancelled, parse() stops early
+		CancelToken cancel;
+
+		/*
+		The tokens aren't copied, so they have to outlive the parser.
+		*/
+		Parser(sptr<const CompilerSettings> cs, in<TokenStream> tokens) :
+			settings(cs), tkns(tokens), errors(new_uptr<ErrorHandler>(CompileStage::PARSER, cs)) {}
+
+		Parser(in<TokenStream> tokens) :
+			settings(nullptr), tkns(tokens), errors(new_uptr<ErrorHandler>(CompileStage::PARSER)) {}
 
-		Parser(in<std::vector<Token>> tokenVec) :
-			settings(nullptr), tkns(tokenVec), errors(new_uptr<ErrorHandler>(CompileStage::PARSER)) {}
+		/*
+		Pulls tokens from the tokenizer as they're needed, instead of needing all of them up front. Only the few the
+		parser can still backtrack to are kept. The tokenizer has to outlive the parser.
+		*/
+		Parser(sptr<const CompilerSettings> cs, out<Tokenizer> source) :
+			settings(cs), tkns(source), errors(new_uptr<ErrorHandler>(CompileStage::PARSER, cs)) {}
+
+		/*
+		How many tokens were parsed. Only the total once parse() is done.
+		*/
+		size_t tokenCount() const
+		{
+			return tkns.count();
+		}
+
+		/*
+		The most tokens held at once while streaming.
+		*/
+		size_t peakTokenWindow() const
+		{
+			return tkns.getPeakWindow();
+		}
 
 		virtual ~Parser() {}
 
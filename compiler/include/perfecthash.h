@@ -0,0 +1,145 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace caliburn
+{
+	/*
+	A fixed set of strings, each with a value, looked up with one hash and one compare.
+
+	The hash is seeded, and the seed is picked so that every string gets a slot of its own, so there are never
+	collisions to probe past. Strings longer than any key are turned down before hashing.
+
+	Seeds are found ahead of time with findSeed() and written down, instead of searched for during constant
+	evaluation, which quickly runs into the compiler's limits. Check the result with a static_assert on found.
+
+	Entry needs a std::string_view named str; Whatever else it has is up to the user.
+
+	SLOTS: Table size. Has to be a power of 2; The bigger it is compared to the number of entries, the sooner a seed is
+	found.
+	*/
+	template<typename Entry, size_t N, size_t SLOTS>
+	struct PerfectHash
+	{
+		static_assert((SLOTS & (SLOTS - 1)) == 0, "Slot count has to be a power of 2");
+		static_assert(N < 0xFF, "Slots store entry indices in a byte");
+
+		static constexpr uint8_t EMPTY = 0xFF;
+		static constexpr uint32_t MAX_SEEDS = 10'000;
+
+		std::array<Entry, N> entries{};
+		std::array<uint8_t, SLOTS> slots{};
+		uint32_t seed = 0;
+		size_t maxLen = 0;
+		bool found = false;
+
+		/*
+		FNV-1a, starting from the seed, then mixed so that the seed reaches the low bits; Otherwise, the slot would only
+		depend on the low bits of the seed, and most seeds would fail the same way.
+		*/
+		static constexpr uint32_t hash(std::string_view str, uint32_t seed)
+		{
+			uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+
+			for (auto const c : str)
+			{
+				h ^= (uint8_t)c;
+				h *= 16777619u;
+			}
+
+			h ^= h >> 16;
+			h *= 0x7FEB352Du;
+			h ^= h >> 15;
+
+			return h;
+		}
+
+		constexpr PerfectHash(const Entry (&list)[N], uint32_t s) : seed(s)
+		{
+			for (size_t i = 0; i < N; ++i)
+			{
+				entries[i] = list[i];
+				maxLen = entries[i].str.size() > maxLen ? entries[i].str.size() : maxLen;
+			}
+
+			found = tryFill();
+
+		}
+
+		/*
+		Returns the first seed which gives every entry its own slot, or MAX_SEEDS if there isn't one. Slow; Run it once
+		whenever the entries change, and write down what it returns.
+		*/
+		static uint32_t findSeed(const Entry (&list)[N])
+		{
+			for (uint32_t s = 0; s < MAX_SEEDS; ++s)
+			{
+				if (PerfectHash(list, s).found)
+				{
+					return s;
+				}
+
+			}
+
+			return MAX_SEEDS;
+		}
+
+		/*
+		Returns null if the string isn't in the set.
+		*/
+		constexpr const Entry* find(std::string_view str) const
+		{
+			if (str.size() > maxLen)
+			{
+				return nullptr;
+			}
+
+			auto const idx = slots[hash(str, seed) & (SLOTS - 1)];
+
+			if (idx == EMPTY || entries[idx].str != str)
+			{
+				return nullptr;
+			}
+
+			return &entries[idx];
+		}
+
+	private:
+		constexpr bool tryFill()
+		{
+			for (auto& s : slots)
+			{
+				s = EMPTY;
+			}
+
+			for (size_t i = 0; i < N; ++i)
+			{
+				auto& s = slots[hash(entries[i].str, seed) & (SLOTS - 1)];
+
+				if (s != EMPTY)
+				{
+					return false;
+				}
+
+				s = (uint8_t)i;
+
+			}
+
+			return true;
+		}
+
+	};
+
+	/*
+	Deduces the entry count from the list.
+	*/
+	template<size_t SLOTS, typename Entry, size_t N>
+	constexpr PerfectHash<Entry, N, SLOTS> makePerfectHash(const Entry (&list)[N], uint32_t seed)
+	{
+		return PerfectHash<Entry, N, SLOTS>(list, seed);
+	}
+
+}
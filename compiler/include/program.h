@@ -0,0 +1,169 @@
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "basic.h"
+#include "source.h"
+#include "strhelp.h"
+#include "syntax.h"
+#include "tokenstream.h"
+
+#include "ast/ast.h"
+#include "ast/module.h"
+#include "ast/shaderstmt.h"
+
+namespace caliburn
+{
+	/*
+	Where a top-level declaration sits within its source.
+
+	Declarations cover the source end to end; Each one runs from its first token up to the first token of the next, so
+	any trailing whitespace and comments belong to it. The first declaration always starts at the very beginning.
+	*/
+	struct DeclSpan
+	{
+		size_t firstToken = 0;
+		size_t startByte = 0;
+
+	};
+
+	/*
+	Everything the frontend makes out of a single source string. Shaders are compiled against the AST, so all of this has
+	to outlive every shader compiled from it.
+
+	Nothing here is modified after preparation.
+	*/
+	struct PreparedProgram
+	{
+		//The document and every new token are views into this
+		const sptr<const SourceText> src;
+		const sptr<TextDoc> doc;
+
+		//The file this was prepared from; Empty if it was prepared from a string
+		std::string path;
+
+		/*
+		Sources of earlier versions of this program. Declarations reused by incremental re-parsing still point into them,
+		so they have to be kept alive.
+		*/
+		std::vector<sptr<const SourceText>> retained;
+
+		TokenStream tokens;
+		std::vector<sptr<Expr>> ast;
+		std::vector<DeclSpan> decls;
+		std::map<std::string_view, ptr<const ShaderStmt>> shaders;
+		std::vector<Diagnostic> errors;
+
+		//Headers declared at preparation time, and the dynamic types they were declared with
+		std::map<std::string, std::string> headerDynTypes;
+		sptr<SymbolTable> headers;
+		std::vector<Diagnostic> headerErrors;
+
+		/*
+		Other sources in the same project which this one imports, by module name; See prepareProject(). Every one of them
+		has its headers declared before this program does. Empty for standalone sources.
+		*/
+		std::map<std::string, sptr<const PreparedProgram>, std::less<>> imports;
+
+		//Hex digest of every imported source, transitively; Goes into cache keys, so that editing an import invalidates
+		//results compiled against it. Empty if nothing is imported.
+		std::string importKey;
+
+		//Frontend stats, if CompilerSettings::collectStats was set. Only covers the work actually done, so a reprepared
+		//program only counts the time spent on the declarations which were parsed again.
+		CompileStats stats;
+
+		PreparedProgram(sptr<const SourceText> s) : src(s), doc(new_sptr<TextDoc>(s->text())), tokens(doc) {}
+
+		bool success() const
+		{
+			return errors.empty();
+		}
+
+	};
+
+	/*
+	The symbol an import statement declares when it names another source in the same project. Its table is the imported
+	program's headers.
+	*/
+	struct SourceModule : Module
+	{
+		const sptr<const PreparedProgram> prog;
+		const sptr<SymbolTable> table;
+
+		SourceModule(sptr<const PreparedProgram> p, sptr<SymbolTable> t) : prog(p), table(t) {}
+		virtual ~SourceModule() = default;
+
+		sptr<SymbolTable> getTable() const override
+		{
+			return table;
+		}
+
+	};
+
+	/*
+	Populates a new symbol table with the built-in symbols, then declares the headers of every statement in the AST.
+
+	While this runs, import statements can find the program's imports through findImport().
+	*/
+	sptr<SymbolTable> declareHeaders(in<PreparedProgram> prog, sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errors);
+
+	/*
+	Populates a new symbol table with the built-in symbols, then declares the headers of a module loaded from a file. Its
+	imports can only be other module files, so findImport() finds nothing while this runs.
+	*/
+	sptr<SymbolTable> declareModuleHeaders(in<std::vector<sptr<Expr>>> ast, sptr<const CompilerSettings> settings, out<ErrorHandler> err);
+
+	/*
+	Finds a project source imported by the program whose headers are being declared on this thread. Returns null if it
+	doesn't import one by that name, or if no headers are being declared.
+	*/
+	sptr<const PreparedProgram> findImport(std::string_view name);
+
+	/*
+	Returns an imported program's headers, as declared with the given settings. Only declares them again if the
+	settings have different dynamic types than the ones they were declared with; Errors from doing so are left out,
+	since they're reported by the imported program itself.
+	*/
+	sptr<SymbolTable> importedHeaders(in<PreparedProgram> prog, sptr<const CompilerSettings> settings);
+
+	/*
+	Declares the headers of a freshly-parsed program, with the settings it's being prepared with. Its imports, if any,
+	must already be declared.
+	*/
+	void declareProgram(out<PreparedProgram> prog, sptr<const CompilerSettings> settings);
+
+	/*
+	Same as prepareProgram(), but stops short of declaring headers; See declareProgram().
+	*/
+	sptr<PreparedProgram> parseProgram(sptr<const SourceText> src, sptr<const CompilerSettings> settings, in<CancelToken> cancel = CancelToken());
+
+	/*
+	Tokenizes and parses an entire source, then declares its headers.
+
+	If cancelled partway through, the program is returned with an error instead.
+	*/
+	sptr<PreparedProgram> prepareProgram(sptr<const SourceText> src, sptr<const CompilerSettings> settings, in<CancelToken> cancel = CancelToken());
+
+	/*
+	Same as above, but makes an owned copy of the source first.
+	*/
+	sptr<PreparedProgram> prepareProgram(in<std::string> src, sptr<const CompilerSettings> settings, in<CancelToken> cancel = CancelToken());
+
+	/*
+	Makes a new program out of an edited version of a previous one.
+
+	Only the declarations touched by the edit are tokenized and parsed again. Declarations before and after the edit are
+	reused as is; Those after it are only moved by the edit's byte delta, and the new document keeps track of where their
+	old text went, so their errors are still placed correctly. Headers are always declared again, since any declaration
+	can refer to any other.
+
+	If the previous program had errors, the edit doesn't match the two sources, or too many old sources are being kept
+	alive, then the whole source is prepared from scratch instead.
+	*/
+	sptr<PreparedProgram> reprepareProgram(sptr<const PreparedProgram> prev, in<std::string> src, in<TextEdit> edit, sptr<const CompilerSettings> settings);
+
+}
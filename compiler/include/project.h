@@ -0,0 +1,31 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "basic.h"
+#include "program.h"
+#include "threadpool.h"
+
+namespace caliburn
+{
+	/*
+	Prepares a set of source files which import each other, spread over a pool.
+
+	Every file is read, tokenized, and parsed in parallel first. A file starting with a module statement can then be
+	imported by the others under that name; Imports which don't name a file in the project fall back to module
+	interface files, as usual. Headers are declared in parallel too, but each file only once every file it imports has
+	been declared, so the work fans out along the import graph.
+
+	Every file is only ever declared against imports which are finished, so the results, errors included, are the same
+	no matter how the work was scheduled.
+
+	Files which can't be read, declare a module name already taken by an earlier file, or are part of (or import) a
+	circular chain of imports get an error instead.
+
+	Returns one program per path, in the same order.
+	*/
+	std::vector<sptr<PreparedProgram>> prepareProject(in<std::vector<std::string>> paths, sptr<const CompilerSettings> settings, out<ThreadPool> pool);
+
+}
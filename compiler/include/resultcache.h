@@ -0,0 +1,89 @@
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "basic.h"
+#include "sha256.h"
+
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+
+namespace caliburn
+{
+	struct DigestHash
+	{
+		size_t operator()(in<Digest> d) const
+		{
+			//The digest is already uniformly distributed, so any bytes will do
+			size_t h = 0;
+
+			for (size_t i = 0; i < sizeof(size_t); ++i)
+			{
+				h = (h << 8) | d[i];
+			}
+
+			return h;
+		}
+
+	};
+
+	/*
+	A thread-safe, least-recently-used cache of compilation results, bounded by an estimate of their size in memory.
+
+	Results are immutable once cached, so they can be handed out to any number of callers without copying.
+	*/
+	struct ResultCache
+	{
+	private:
+		struct Entry
+		{
+			Digest key;
+			std::shared_ptr<const ShaderResult> result;
+			uint64_t bytes;
+		};
+
+		const uint64_t maxBytes;
+
+		mutable std::mutex lock;
+
+		//Front is the most recently used
+		std::list<Entry> lru;
+		HashMap<Digest, std::list<Entry>::iterator, DigestHash> entries;
+
+		CacheStats stats;
+
+	public:
+		ResultCache(uint64_t max) : maxBytes(max) {}
+		virtual ~ResultCache() = default;
+
+		/*
+		Returns the cached result for the key, or null if there isn't one. Counts towards the hit/miss counters.
+		*/
+		std::shared_ptr<const ShaderResult> find(in<Digest> key);
+
+		/*
+		Adds a result, evicting old ones until it fits. Results bigger than the whole cache are not added.
+		*/
+		void add(in<Digest> key, std::shared_ptr<const ShaderResult> result);
+
+		CacheStats getStats() const;
+
+		/*
+		Makes the key for a compile. Starts from the disk cache's key, but also covers every setting that only changes
+		errors and stats, since failed results are cached here too.
+		*/
+		static Digest makeKey(std::string_view src, in<CompilerSettings> settings, std::string_view shaderName, std::string_view importKey = "");
+
+		void clear();
+
+		/*
+		Roughly estimates how much memory a result takes up.
+		*/
+		static uint64_t sizeOf(in<ShaderResult> result);
+
+	};
+
+}
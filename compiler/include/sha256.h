@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <stdint.h>
+
+#include "basic.h"
+
+namespace caliburn
+{
+	using Digest = std::array<uint8_t, 32>;
+
+	/*
+	A plain SHA-256 implementation, used to give compiled output a content-based key.
+
+	Data can be fed in any number of pieces; Call finish() once everything is in. The hasher cannot be reused after.
+	*/
+	struct SHA256
+	{
+	private:
+		std::array<uint32_t, 8> state = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+		};
+
+		std::array<uint8_t, 64> block{};
+		size_t blockLen = 0;
+		uint64_t totalLen = 0;
+
+	public:
+		SHA256() = default;
+		virtual ~SHA256() = default;
+
+		void update(const void* data, size_t len);
+
+		void update(std::string_view str)
+		{
+			update(str.data(), str.size());
+		}
+
+		/*
+		Hashes a length-prefixed string. Use this for fields in a compound key, so that, say, "ab" + "c" and
+		"a" + "bc" do not produce the same digest.
+		*/
+		void updateField(std::string_view str)
+		{
+			updateU32((uint32_t)str.size());
+			update(str);
+		}
+
+		void updateU32(uint32_t v)
+		{
+			uint8_t bytes[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+			update(bytes, 4);
+		}
+
+		Digest finish();
+
+		static std::string toHex(in<Digest> digest);
+
+	private:
+		void compress(const uint8_t* chunk);
+
+	};
+
+}
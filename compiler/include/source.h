@@ -0,0 +1,99 @@
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "basic.h"
+
+namespace caliburn
+{
+	/*
+	The text of a single source, however it happens to be stored.
+
+	Documents and tokens are views into this text, so whatever holds on to them (mainly PreparedProgram) holds on to the
+	source too.
+	*/
+	struct SourceText
+	{
+		virtual ~SourceText() = default;
+
+		virtual std::string_view text() const = 0;
+
+	};
+
+	/*
+	A source which owns a copy of its text.
+	*/
+	struct OwnedSource : SourceText
+	{
+	private:
+		const std::string str;
+
+	public:
+		OwnedSource(in<std::string> s) : str(s) {}
+		OwnedSource(std::string&& s) : str(std::move(s)) {}
+
+		std::string_view text() const override
+		{
+			return str;
+		}
+
+	};
+
+	/*
+	A source viewing text owned by someone else. Only safe for programs which never outlive the call that made them,
+	such as the ones made internally by Compiler::compileShaders().
+	*/
+	struct ViewSource : SourceText
+	{
+	private:
+		const std::string_view str;
+
+	public:
+		ViewSource(std::string_view s) : str(s) {}
+
+		std::string_view text() const override
+		{
+			return str;
+		}
+
+	};
+
+	/*
+	A read-only memory mapping of an entire file. The file's contents are never copied onto the heap; The OS pages them
+	in as they're read.
+
+	The file must not be modified while it's mapped.
+	*/
+	struct MappedFile : SourceText
+	{
+	private:
+		ptr<const char> data = nullptr;
+		size_t size = 0;
+
+#ifdef _WIN32
+		ptr<void> fileHandle = nullptr;
+		ptr<void> mapHandle = nullptr;
+#endif
+
+		MappedFile() = default;
+
+	public:
+		/*
+		Maps a file. Returns null if it couldn't be opened or mapped.
+		*/
+		static sptr<MappedFile> open(in<std::string> path);
+
+		MappedFile(const MappedFile&) = delete;
+
+		virtual ~MappedFile();
+
+		std::string_view text() const override
+		{
+			return std::string_view(data, size);
+		}
+
+	};
+
+}
@@ -32,6 +32,8 @@ namespace caliburn
             ExecutionModel type;
             std::string name;
             std::vector<uint32_t> io;
+            //Where a fragment shader's returned colour goes
+            uint32_t outLocation = 0;
         };
 
         struct VarData
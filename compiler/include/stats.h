@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include "basic.h"
+#include "trace.h"
+
+namespace caliburn
+{
+	/*
+	Times a compile stage, from its creation to its destruction (or stop()).
+
+	The time is added to a counter, in nanoseconds, and a span is added to a trace. Either one can be null; If both are,
+	the clock is never read, so this costs nothing when stats and tracing are turned off.
+
+	name has to outlive the timer; It's meant to be a string literal.
+	*/
+	struct StageTimer
+	{
+	private:
+		ptr<uint64_t> counter;
+		const sptr<TraceWriter> trace;
+		const std::string_view name;
+		const std::string detail;
+		std::chrono::steady_clock::time_point start;
+		bool running;
+
+	public:
+		StageTimer(ptr<uint64_t> c, sptr<TraceWriter> t = nullptr, std::string_view n = "", in<std::string> d = "") :
+			counter(c), trace(t), name(n), detail(t ? d : ""), running(c != nullptr || t != nullptr)
+		{
+			if (running)
+			{
+				start = std::chrono::steady_clock::now();
+			}
+
+		}
+
+		StageTimer(const StageTimer&) = delete;
+
+		virtual ~StageTimer()
+		{
+			stop();
+		}
+
+		void stop()
+		{
+			if (!running)
+			{
+				return;
+			}
+
+			running = false;
+
+			auto const end = std::chrono::steady_clock::now();
+
+			if (counter != nullptr)
+			{
+				*counter += SCAST<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+			}
+
+			if (trace != nullptr)
+			{
+				trace->addSpan(name, detail, start, end);
+			}
+
+		}
+
+	};
+
+}
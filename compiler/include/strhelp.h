@@ -216,17 +216,72 @@ namespace caliburn
 	};
 
 	/*
-	A TextDoc is responsible for keeping track of lines within a string
+	A TextDoc is responsible for keeping track of lines within a string.
+
+	Only the offset each line starts at is stored. Tokens don't track their own position while being made, so this is
+	also how a byte offset gets turned back into a line and column, whenever something needs one.
+
+	Offsets are 32-bit, same as in a TokenStream.
 	*/
 	struct TextDoc
 	{
+		/*
+		A stretch of an older version of the document, still pointed into by declarations reused from it, and where it
+		now starts within this one.
+		*/
+		struct MovedText
+		{
+			std::string_view old;
+			size_t offset = 0;
+
+		};
+
 		const std::string_view text;
 
-		std::vector<std::string_view> lines;
+		std::vector<uint32_t> lineStarts;
+
+		//Empty unless this document was made by editing an older one; See reprepareProgram()
+		std::vector<MovedText> moved;
 		
 		TextDoc(in<std::string_view> str);
 
-		std::string_view getLine(TextPos pos) const;
+		size_t lineCount() const
+		{
+			return lineStarts.size();
+		}
+
+		/*
+		Returns the line's text, without the line break. Lines past the end are empty.
+		*/
+		std::string_view getLine(size_t line) const;
+
+		std::string_view getLine(TextPos pos) const
+		{
+			return getLine(pos.line);
+		}
+
+		/*
+		Finds the line and column of a byte offset. Columns count bytes.
+		*/
+		TextPos posOf(size_t offset) const
+		{
+			size_t hint = 0;
+			return posOf(offset, hint);
+		}
+
+		/*
+		Same as above, but starts looking from the line of an earlier lookup, so walking forward through a document only
+		costs a compare or two per lookup.
+
+		hint: The line to start from; Gets set to the line found.
+		*/
+		TextPos posOf(size_t offset, out<size_t> hint) const;
+
+		/*
+		Finds the line and column of a view into this document, or into any text moved into it. Views into anything else
+		keep the position they were made with.
+		*/
+		TextPos posOf(std::string_view str, in<TextPos> fallback) const;
 
 	};
 
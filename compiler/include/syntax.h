@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "basic.h"
+#include "perfecthash.h"
 #include "strhelp.h"
 
 namespace caliburn
@@ -23,33 +24,6 @@ namespace caliburn
 	static const std::string_view DEC_INTS = "0123456789";
 	static const std::string_view HEX_INTS = "0123456789ABCDEFabcdef";
 	
-	/*
-	This is the complete list of Caliburn's reserved keywords.
-
-	Some of these are also types. These are not valid for users to use; Rather,
-	they are reserved to enable for internal use.
-	*/
-	static const std::unordered_set<std::string_view> KEYWORDS = {
-		//Array is a keyword not because it's used, but because it's an internal type
-		"array",
-		"break",
-		"case", "class", "const", "continue",
-		"def", "default", "delete", "discard", "do", "dynamic",
-		"enum",
-		"false", "for",
-		"if", "import", "in", "is",
-		"module",
-		"new",
-		"op", "override",
-		"pass", "private", "public",
-		"record", "return",
-		"self", "shader", "shared", "sign", "strong", "struct", "switch",
-		"this", "true", "type",
-		"unreachable", "unsign", "uses",
-		"var", "void",
-		"while", "where", "wrapped"
-	};
-
 	static constexpr std::string_view OPERATOR_CHARS = "!$%&*+-/<=>^|~";
 
 	/*
@@ -189,33 +163,84 @@ namespace caliburn
 	};
 
 	/*
-	This enables for an arbitrary string to have a specific token type
+	A string which always makes the same token type, no matter where it's found.
 	*/
-	static const HashMap<std::string_view, TokenType> TOKEN_TYPE_OVERRIDES = {
-		{"=",		TokenType::SETTER},
-		{"(",		TokenType::START_PAREN},
-		{")",		TokenType::END_PAREN},
-		{",",		TokenType::COMMA},
-		{".",		TokenType::PERIOD},
-		{":",		TokenType::COLON},
-		{";",		TokenType::END},
-		{"[",		TokenType::START_BRACKET},
-		{"]",		TokenType::END_BRACKET},
-		{"{",		TokenType::START_SCOPE},
-		{"}",		TokenType::END_SCOPE},
-		{"true",	TokenType::LITERAL_BOOL},
-		{"false",	TokenType::LITERAL_BOOL},
-		{"->",		TokenType::ARROW},
-		{"=>",		TokenType::ARROW}
+	struct TokenWord
+	{
+		std::string_view str;
+		TokenType type = TokenType::UNKNOWN;
 	};
 
 	/*
-	Used by the tokenizer to discern valid operator tokens of length 2 or more. Single-char ops are always valid.
+	Every string with a token type of its own, which the tokenizer looks up once per token:
+
+	* Caliburn's reserved keywords. Some of these are also types. These are not valid for users to use; Rather, they are
+	reserved to enable for internal use.
+	* Every valid operator of length 2 or more. Single-char ops are always valid, so they're only here if they're
+	special.
+	* Single chars with a specific meaning.
 	*/
-	static const std::unordered_set<std::string_view> LONG_OPS = {
-		"++", "//", "&&", "||", "<<", ">>", "==", "!=", ">=", "<=", "->", "=>"
+	static constexpr TokenWord TOKEN_WORDS[] = {
+		//Array is a keyword not because it's used, but because it's an internal type
+		{"array",		TokenType::KEYWORD},
+		{"break",		TokenType::KEYWORD},
+		{"case",		TokenType::KEYWORD}, {"class", TokenType::KEYWORD}, {"const", TokenType::KEYWORD}, {"continue", TokenType::KEYWORD},
+		{"def",			TokenType::KEYWORD}, {"default", TokenType::KEYWORD}, {"delete", TokenType::KEYWORD}, {"discard", TokenType::KEYWORD}, {"do", TokenType::KEYWORD}, {"dynamic", TokenType::KEYWORD},
+		{"enum",		TokenType::KEYWORD},
+		{"false",		TokenType::LITERAL_BOOL}, {"for", TokenType::KEYWORD},
+		{"if",			TokenType::KEYWORD}, {"import", TokenType::KEYWORD}, {"in", TokenType::KEYWORD}, {"is", TokenType::KEYWORD},
+		{"module",		TokenType::KEYWORD},
+		{"new",			TokenType::KEYWORD},
+		{"op",			TokenType::KEYWORD}, {"override", TokenType::KEYWORD},
+		{"pass",		TokenType::KEYWORD}, {"private", TokenType::KEYWORD}, {"public", TokenType::KEYWORD},
+		{"record",		TokenType::KEYWORD}, {"return", TokenType::KEYWORD},
+		{"self",		TokenType::KEYWORD}, {"shader", TokenType::KEYWORD}, {"shared", TokenType::KEYWORD}, {"sign", TokenType::KEYWORD}, {"strong", TokenType::KEYWORD}, {"struct", TokenType::KEYWORD}, {"switch", TokenType::KEYWORD},
+		{"this",		TokenType::KEYWORD}, {"true", TokenType::LITERAL_BOOL}, {"type", TokenType::KEYWORD},
+		{"unreachable",	TokenType::KEYWORD}, {"unsign", TokenType::KEYWORD}, {"uses", TokenType::KEYWORD},
+		{"var",			TokenType::KEYWORD}, {"void", TokenType::KEYWORD},
+		{"while",		TokenType::KEYWORD}, {"where", TokenType::KEYWORD}, {"wrapped", TokenType::KEYWORD},
+
+		{"++",	TokenType::OPERATOR},
+		{"//",	TokenType::OPERATOR},
+		{"&&",	TokenType::OPERATOR},
+		{"||",	TokenType::OPERATOR},
+		{"<<",	TokenType::OPERATOR},
+		{">>",	TokenType::OPERATOR},
+		{"==",	TokenType::OPERATOR},
+		{"!=",	TokenType::OPERATOR},
+		{">=",	TokenType::OPERATOR},
+		{"<=",	TokenType::OPERATOR},
+		{"->",	TokenType::ARROW},
+		{"=>",	TokenType::ARROW},
+
+		{"=",	TokenType::SETTER},
+		{"(",	TokenType::START_PAREN},
+		{")",	TokenType::END_PAREN},
+		{",",	TokenType::COMMA},
+		{".",	TokenType::PERIOD},
+		{":",	TokenType::COLON},
+		{";",	TokenType::END},
+		{"[",	TokenType::START_BRACKET},
+		{"]",	TokenType::END_BRACKET},
+		{"{",	TokenType::START_SCOPE},
+		{"}",	TokenType::END_SCOPE}
 	};
 
+	//From PerfectHash::findSeed(); Has to be found again whenever TOKEN_WORDS changes
+	static constexpr uint32_t TOKEN_WORD_SEED = 199;
+
+	static constexpr auto TOKEN_WORD_TABLE = makePerfectHash<512>(TOKEN_WORDS, TOKEN_WORD_SEED);
+
+	static_assert(TOKEN_WORD_TABLE.found, "TOKEN_WORD_SEED has collisions; Find a new one with PerfectHash::findSeed()");
+
+	/*
+	Returns null if the string doesn't have a token type of its own.
+	*/
+	constexpr const TokenWord* findTokenWord(std::string_view str)
+	{
+		return TOKEN_WORD_TABLE.find(str);
+	}
+
 	/*
 	Unary ops have a higher precedent than infix ops, hence this separate map
 	*/
@@ -0,0 +1,84 @@
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "basic.h"
+
+namespace caliburn
+{
+	/*
+	A fixed-size, work-stealing thread pool.
+
+	Every worker has its own queue. Tasks submitted from a worker go onto that worker's queue, and it runs its own newest
+	tasks first, which keeps related work on a warm cache. Idle workers steal the oldest tasks from the others. Tasks
+	submitted from outside the pool are spread between the queues.
+
+	Threads are only started once the first task is submitted, so an unused pool costs nothing. Destroying the pool
+	finishes every task already submitted. Do not destroy a pool from within one of its own tasks.
+
+	Tasks must not throw.
+	*/
+	struct ThreadPool
+	{
+	private:
+		struct WorkQueue
+		{
+			std::mutex lock;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		const uint32_t threadCount;
+
+		std::vector<uptr<WorkQueue>> queues;
+		std::vector<std::thread> threads;
+		std::once_flag started;
+
+		std::mutex sleepLock;
+		std::condition_variable wake;
+		size_t pending = 0;
+		bool stopping = false;
+
+		atom<size_t> nextQueue = 0;
+
+	public:
+		/*
+		threads: How many worker threads to run. 0 uses std::thread::hardware_concurrency().
+		*/
+		ThreadPool(uint32_t threads);
+		virtual ~ThreadPool();
+
+		/*
+		Queues a task. Nothing waits on it, so anything it throws is caught and dropped, rather than taking the worker
+		(and the process) down with it.
+		*/
+		void submit(std::function<void()> task);
+
+		/*
+		Runs work(i) for every index below count, spread over the pool, and returns once every call has finished.
+
+		The calling thread works too, so this can't deadlock even when called from within the pool. If any call throws,
+		the exception from the lowest index is rethrown once every other call has finished.
+		*/
+		void forEach(size_t count, std::function<void(size_t)> work);
+
+		uint32_t size() const
+		{
+			return threadCount;
+		}
+
+	private:
+		void start();
+
+		void run(size_t idx);
+
+		bool tryTake(size_t idx, out<std::function<void()>> task);
+
+	};
+
+}
@@ -0,0 +1,270 @@
+
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include "basic.h"
+#include "syntax.h"
+#include "tokenizer.h"
+#include "tokenstream.h"
+
+namespace caliburn
+{
+	struct TokenCursor;
+
+	/*
+	A position the parser may want to go back to. While it's alive, a streaming cursor keeps every token from it onwards
+	around; Tokens before every checkpoint (and a few for peekBack()) are let go of.
+
+	Made by TokenCursor::mark(), and meant to live on the stack, so they're let go of in reverse order.
+	*/
+	struct TokenCheckpoint
+	{
+		const ptr<TokenCursor> cursor;
+		const size_t offset;
+
+		TokenCheckpoint(ptr<TokenCursor> c, size_t off);
+		TokenCheckpoint(in<TokenCheckpoint>) = delete;
+		~TokenCheckpoint();
+
+		TokenCheckpoint& operator=(in<TokenCheckpoint>) = delete;
+
+	};
+
+	/*
+	The parser's view of its tokens. Walks a TokenStream the same way Cursor does, but tokens can also be pulled from a
+	tokenizer as they're needed, instead of tokenizing everything first. Streamed tokens are kept in a window which only spans from the
+	oldest live checkpoint to the furthest the parser has looked ahead, so memory use depends on how far the parser
+	backtracks, not on how big the source is.
+
+	Tokens are stored compactly, and made into whole Tokens as they're read, so they're returned by value.
+
+	Reading past either end gives back a placeholder, same as Cursor; Debug builds throw std::out_of_range instead.
+	Reading before the window always throws std::out_of_range, since the token is gone and a placeholder would just
+	have the parser carry on with the wrong tokens; It means a backtrack didn't use a checkpoint.
+	*/
+	struct TokenCursor
+	{
+	private:
+		//How many tokens are pulled at a time
+		static constexpr size_t PULL_TOKENS = 64;
+		//How many tokens before the current one are always kept, for peekBack() and rewind()
+		static constexpr size_t HISTORY = 8;
+
+		//Only set when streaming
+		ptr<Tokenizer> source = nullptr;
+		TokenStream window;
+		std::vector<size_t> pins;
+
+		//Either the window, or the tokens passed in
+		ptr<const TokenStream> data = nullptr;
+		//Index of the first token in data
+		size_t windowStart = 0;
+		//One past the index of the last token made so far
+		size_t filled = 0;
+		bool exhausted = true;
+
+		size_t index = 0;
+		size_t peakWindow = 0;
+
+		//The parser mostly moves forward, so positions are looked up starting from the last one's line
+		size_t lineHint = 0;
+
+		Token pastEnd;
+
+		/*
+		Tokenizes until the given index is made, or the source runs out.
+		*/
+		void pull(size_t i);
+
+		Token at(size_t i)
+		{
+			if (!exhausted && i >= filled)
+			{
+				pull(i);
+			}
+
+			//Anything before the window wraps around, so this checks both ends
+			if (i - windowStart < filled - windowStart)
+			{
+				return data->at(i - windowStart, lineHint);
+			}
+
+			if (i < windowStart)
+			{
+				throw std::out_of_range("Token cursor went back past its window; Backtracking further than rewind() allows needs a checkpoint");
+			}
+
+#ifndef NDEBUG
+			throw std::out_of_range("Token cursor index out of range");
+#endif
+
+			return pastEnd;
+		}
+
+	public:
+		/*
+		Makes an empty token just past the last one, so that errors at the end of the source point somewhere sensible.
+		*/
+		static Token makeEndToken(in<TokenStream> tokens)
+		{
+			if (tokens.empty())
+			{
+				return Token();
+			}
+
+			auto const last = tokens.size() - 1;
+			auto const end = tokens.offsets[last] + tokens.lengths[last];
+
+			return Token(tokens.doc->text.substr(end, 0), TokenType::UNKNOWN, tokens.doc->posOf(end));
+		}
+
+		/*
+		Views every token at once. They aren't copied, so they have to outlive the cursor.
+		*/
+		TokenCursor(in<TokenStream> tokens) :
+			data(&tokens), filled(tokens.size()), pastEnd(makeEndToken(tokens)) {}
+
+		/*
+		Pulls tokens from a tokenizer as they're needed. The tokenizer has to outlive the cursor.
+		*/
+		TokenCursor(out<Tokenizer> src) : source(&src), window(src.doc), data(&window), exhausted(false) {}
+
+		TokenCursor(in<TokenCursor>) = delete;
+
+		bool hasRem(size_t count)
+		{
+			if (!exhausted && index + count >= filled)
+			{
+				pull(index + count);
+			}
+
+			return index + count < filled;
+		}
+
+		bool hasCur()
+		{
+			return hasRem(0);
+		}
+
+		Token cur()
+		{
+			return at(index);
+		}
+
+		Token next()
+		{
+			++index;
+			return at(index);
+		}
+
+		Token take()
+		{
+			auto const x = at(index);
+			++index;
+			return x;
+		}
+
+		Token peek(size_t off)
+		{
+			return at(index + off);
+		}
+
+		Token peekBack(size_t off)
+		{
+			return at(index - off);
+		}
+
+		/*
+		The last token made so far. Once the parser has hit the end, that's the last token of the source.
+		*/
+		Token last()
+		{
+			return filled == 0 ? pastEnd : at(filled - 1);
+		}
+
+		void consume(size_t count = 1)
+		{
+			index += count;
+		}
+
+		size_t offset() const
+		{
+			return index;
+		}
+
+		/*
+		Remembers the current offset, so that revertTo() can go back to it.
+		*/
+		TokenCheckpoint mark()
+		{
+			if (source != nullptr)
+			{
+				pins.push_back(index);
+			}
+
+			return TokenCheckpoint(this, index);
+		}
+
+		void revertTo(in<TokenCheckpoint> point)
+		{
+			index = point.offset;
+		}
+
+		/*
+		Subtracts the current offset by the passed offset. When streaming, only the last HISTORY tokens are kept for this (and
+		peekBack()); Reading any further back throws.
+
+		If this will result in an integer underflow, nothing happens.
+		*/
+		void rewind(size_t off = 1)
+		{
+			if (off <= index)
+			{
+				index -= off;
+			}
+		}
+
+		/*
+		The most tokens held at once while streaming.
+		*/
+		size_t getPeakWindow() const
+		{
+			return peakWindow;
+		}
+
+		/*
+		Tokens are only counted once made, so when streaming, this is only the total once the parser's done.
+		*/
+		size_t count() const
+		{
+			return filled;
+		}
+
+	private:
+		friend struct TokenCheckpoint;
+
+		void unpin(size_t off)
+		{
+			if (source == nullptr)
+			{
+				return;
+			}
+
+			//Checkpoints go out of scope in reverse, so this is nearly always the last one
+			for (auto it = pins.rbegin(); it != pins.rend(); ++it)
+			{
+				if (*it == off)
+				{
+					pins.erase(std::next(it).base());
+					break;
+				}
+
+			}
+
+		}
+
+	};
+
+}
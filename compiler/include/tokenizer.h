@@ -2,12 +2,17 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <string>
 
 #include "basic.h"
-#include "buffer.h"
+#include "cursor.h"
 #include "strhelp.h"
 #include "syntax.h"
+#include "tokenstream.h"
+
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
 
 namespace caliburn
 {
@@ -38,23 +43,31 @@ namespace caliburn
 	struct Tokenizer
 	{
 	private:
-		Buffer<char> buf;
-		TextPos pos;
+		//Offset of the buffer's first char within the document
+		const size_t base = 0;
 
-		std::array<CharType, 128> asciiTypes;
+		//Views the document's text directly
+		Cursor<char> buf;
 
-		Token makeCharTkn(TokenType t) const
-		{
-			return Token(doc->text.substr(buf.offset(), 1), t, pos);
-		}
+		std::array<CharType, 128> asciiTypes;
 
 	public:
 		sptr<TextDoc> doc;
 
+		//Checked periodically; If cancelled, tokenizing stops early
+		CancelToken cancel;
+
 		//TODO use 32-bit wide chars for UTF-8 support
 		//or, y'know, find a UTF-8 library (NOT BOOST)
 		Tokenizer(sptr<TextDoc> doc);
 
+		/*
+		Makes a tokenizer which starts partway through the document. Used for incremental re-parsing.
+
+		start: The offset of the first char to tokenize.
+		*/
+		Tokenizer(sptr<TextDoc> doc, size_t start);
+
 		virtual ~Tokenizer() = default;
 
 		/*
@@ -62,7 +75,46 @@ namespace caliburn
 
 		Running this multiple times in a row invokes UB. And by that I mean you'll probably get bupkis the second time.
 		*/
-		std::vector<Token> tokenize();
+		TokenStream tokenize();
+
+		/*
+		Tokenizes until either the document ends, or the tokenizer lands on one of the given sync points between tokens.
+		Since tokenizing only depends on the text, everything from a sync point onwards will tokenize the same as it did
+		before an edit.
+
+		Unlike tokenize(), this can be called again to continue on from where it stopped.
+
+		syncPoints: Document offsets to stop at, sorted in ascending order.
+		tokens: Output stream; New tokens are appended to it. Has to be for the same document.
+		maxTokens: Stops once this many tokens were added, so tokens can be made a few at a time.
+
+		Returns true if it stopped at a sync point.
+		*/
+		bool tokenizeUntil(in<std::vector<size_t>> syncPoints, out<TokenStream> tokens, size_t maxTokens = SIZE_MAX);
+
+		/*
+		Returns true once the whole document is tokenized.
+		*/
+		bool done() const
+		{
+			return !buf.hasCur();
+		}
+
+		/*
+		The current offset within the document.
+		*/
+		size_t offset() const
+		{
+			return base + buf.offset();
+		}
+
+		/*
+		The text position of the current offset. Positions aren't tracked while tokenizing, so this has to look it up.
+		*/
+		TextPos getPos() const
+		{
+			return doc->posOf(offset());
+		}
 
 	private:
 		/*
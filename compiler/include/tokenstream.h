@@ -0,0 +1,117 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "basic.h"
+#include "strhelp.h"
+#include "syntax.h"
+
+namespace caliburn
+{
+	/*
+	Tokens as the tokenizer makes them: Parallel arrays of byte offsets, lengths, and types, which take 9 bytes a token
+	instead of a Token's 32. The parser goes through these a token at a time, so the smaller they are, the fewer cache
+	misses it takes.
+
+	Positions aren't stored at all; operator[] works them out from the document's line starts when making a Token.
+
+	Offsets are into the whole document, so a stream made from partway through one still lines up with it.
+	*/
+	struct TokenStream
+	{
+		sptr<const TextDoc> doc;
+
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> lengths;
+		std::vector<TokenType> types;
+
+		TokenStream() = default;
+		TokenStream(sptr<const TextDoc> d) : doc(d) {}
+
+		size_t size() const
+		{
+			return types.size();
+		}
+
+		bool empty() const
+		{
+			return types.empty();
+		}
+
+		void reserve(size_t count)
+		{
+			offsets.reserve(count);
+			lengths.reserve(count);
+			types.reserve(count);
+		}
+
+		void clear()
+		{
+			offsets.clear();
+			lengths.clear();
+			types.clear();
+		}
+
+		void push(size_t offset, size_t length, TokenType type)
+		{
+			offsets.push_back(SCAST<uint32_t>(offset));
+			lengths.push_back(SCAST<uint32_t>(length));
+			types.push_back(type);
+		}
+
+		std::string_view str(size_t i) const
+		{
+			return doc->text.substr(offsets[i], lengths[i]);
+		}
+
+		/*
+		Makes a whole Token, position and all.
+		*/
+		Token operator[](size_t i) const
+		{
+			return Token(str(i), types[i], doc->posOf(offsets[i]));
+		}
+
+		/*
+		Same as operator[], but with a line hint; See TextDoc::posOf().
+		*/
+		Token at(size_t i, out<size_t> lineHint) const
+		{
+			return Token(str(i), types[i], doc->posOf(offsets[i], lineHint));
+		}
+
+		/*
+		Appends tokens [start, end) of another stream, moving their offsets by shift. Used to keep the tokens from around
+		an edit, which only moved within the source.
+		*/
+		void append(in<TokenStream> from, size_t start, size_t end, int64_t shift = 0)
+		{
+			for (auto i = start; i < end; ++i)
+			{
+				push(SCAST<size_t>(from.offsets[i] + shift), from.lengths[i], from.types[i]);
+			}
+
+		}
+
+		void append(in<TokenStream> from)
+		{
+			offsets.insert(offsets.end(), from.offsets.begin(), from.offsets.end());
+			lengths.insert(lengths.end(), from.lengths.begin(), from.lengths.end());
+			types.insert(types.end(), from.types.begin(), from.types.end());
+		}
+
+		/*
+		Removes the first count tokens.
+		*/
+		void dropFront(size_t count)
+		{
+			offsets.erase(offsets.begin(), offsets.begin() + count);
+			lengths.erase(lengths.begin(), lengths.begin() + count);
+			types.erase(types.begin(), types.begin() + count);
+		}
+
+	};
+
+}
@@ -0,0 +1,100 @@
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "basic.h"
+
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+
+namespace caliburn
+{
+	/*
+	Writes Chrome trace_event JSON (the "JSON Array Format") to a single file. Every span is a complete ("X") event,
+	tagged with the thread it ran on.
+
+	The closing bracket is never written, which the format explicitly allows; That way the file is valid no matter when
+	the process stops. Events are buffered, and written out whenever the buffer fills up, after every top-level compile,
+	and at exit.
+
+	There's one writer per file, shared by every compiler in the process.
+	*/
+	struct TraceWriter
+	{
+	private:
+		const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+		std::mutex lock;
+		std::ofstream file;
+		std::string buffer;
+
+	public:
+		/*
+		Returns the writer for a file, opening it (and truncating it) the first time it's asked for.
+		*/
+		static sptr<TraceWriter> forFile(in<std::string> path);
+
+		/*
+		Returns the writer named by settings.traceFile, or null if tracing is off.
+		*/
+		static sptr<TraceWriter> forSettings(in<CompilerSettings> settings)
+		{
+			if (settings.traceFile.empty())
+			{
+				return nullptr;
+			}
+
+			return forFile(settings.traceFile);
+		}
+
+		TraceWriter(in<std::string> path);
+		virtual ~TraceWriter();
+
+		void addSpan(std::string_view name, std::string_view detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+		void flush();
+
+	};
+
+	/*
+	Adds a span covering its lifetime to a trace. Does nothing if the writer is null.
+
+	name has to outlive the span; It's meant to be a string literal.
+	*/
+	struct TraceSpan
+	{
+	private:
+		const sptr<TraceWriter> writer;
+		const std::string_view name;
+		const std::string detail;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		TraceSpan(sptr<TraceWriter> w, std::string_view n, in<std::string> d = "") : writer(w), name(n), detail(w ? d : "")
+		{
+			if (writer != nullptr)
+			{
+				start = std::chrono::steady_clock::now();
+			}
+
+		}
+
+		TraceSpan(const TraceSpan&) = delete;
+
+		virtual ~TraceSpan()
+		{
+			if (writer != nullptr)
+			{
+				writer->addSpan(name, detail, start, std::chrono::steady_clock::now());
+			}
+
+		}
+
+	};
+
+}
@@ -1,6 +1,8 @@
 
 #include "ast/basetypes.h"
 
+#include "trace.h"
+
 using namespace caliburn;
 
 void TypeFloat::initLowImpl(sptr<cllr::LowType> impl, sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const
@@ -37,7 +39,7 @@ void TypeInt::initLowImpl(sptr<cllr::LowType> impl, sptr<GenericArguments> gArgs
 
 }
 
-sptr<cllr::LowType> TypeArray::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm)
+sptr<cllr::LowType> TypeArray::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
 	if (!sig.canApply(*gArgs))
 	{
@@ -73,13 +75,17 @@ sptr<cllr::LowType> TypeArray::resolve(sptr<GenericArguments> gArgs, sptr<const
 	return impl;
 }
 
-sptr<cllr::LowType> TypeStruct::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm)
+sptr<cllr::LowType> TypeStruct::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
+	auto& variants = codeAsm.getTypeImpls(this);
+
 	if (auto found = variants.find(gArgs); found != variants.end())
 	{
 		return found->second;
 	}
 
+	auto span = TraceSpan(TraceWriter::forSettings(*codeAsm.settings), "TypeStruct::resolve", canonName);
+
 	auto genTable = new_sptr<SymbolTable>(table);
 
 	//populate table with generics and members
@@ -124,7 +130,7 @@ sptr<cllr::LowType> TypeStruct::resolve(sptr<GenericArguments> gArgs, sptr<const
 	return impl;
 }
 
-sptr<cllr::LowType> TypeTexture::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm)
+sptr<cllr::LowType> TypeTexture::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
 	auto genTable = new_sptr<SymbolTable>(table);
 
@@ -162,7 +168,7 @@ void TypeTexture::initLowImpl(sptr<cllr::LowType> impl, sptr<GenericArguments> g
 
 }
 
-sptr<cllr::LowType> TypeVector::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm)
+sptr<cllr::LowType> TypeVector::resolve(sptr<GenericArguments> gArgs, sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
 	if (gArgs->empty())
 	{
@@ -175,6 +181,8 @@ sptr<cllr::LowType> TypeVector::resolve(sptr<GenericArguments> gArgs, sptr<const
 		return nullptr;
 	}
 
+	auto& variants = codeAsm.getTypeImpls(this);
+
 	if (auto found = variants.find(gArgs); found != variants.end())
 	{
 		return found->second;
@@ -4,6 +4,8 @@
 
 #include "cllr/cllrtype.h"
 
+#include "trace.h"
+
 using namespace caliburn;
 
 cllr::TypedSSA SrcFn::call(in<std::vector<cllr::TypedSSA>> callIDs, sptr<GenericArguments> gArgs, out<cllr::Assembler> codeAsm)
@@ -24,6 +26,7 @@ cllr::TypedSSA SrcFn::call(in<std::vector<cllr::TypedSSA>> callIDs, sptr<Generic
 	}
 	
 	sptr<SrcFnImpl> impl = nullptr;
+	auto& variants = codeAsm.getFnImpls(this);
 
 	if (auto found = variants.find(gArgs); found != variants.end())
 	{
@@ -65,6 +68,9 @@ cllr::TypedSSA SrcFnImpl::emitFnDeclCLLR(out<cllr::Assembler> codeAsm)
 		return cllr::TypedSSA(rt, id);
 	}
 
+	//Only traced when the body is actually emitted, not every time it's called
+	auto span = TraceSpan(TraceWriter::forSettings(*codeAsm.settings), "SrcFnImpl::emitFnDeclCLLR");
+
 	id = codeAsm.beginSect(cllr::Instruction(cllr::Opcode::FUNCTION, { (uint32_t)args->size() }, { rt->id }));
 
 	for (auto i = 0; i < args->size(); ++i)
@@ -199,6 +205,7 @@ cllr::TypedSSA SrcMethod::call(in<std::vector<cllr::TypedSSA>> argVals, sptr<Gen
 	}
 
 	sptr<SrcFnImpl> impl = nullptr;
+	auto& variants = codeAsm.getFnImpls(this);
 
 	if (auto found = variants.find(gArgs); found != variants.end())
 	{
@@ -0,0 +1,129 @@
+
+#include "ast/modstmts.h"
+
+#include <set>
+
+#include "modfile.h"
+#include "program.h"
+
+#include "ast/structstmt.h"
+#include "ast/typestmt.h"
+
+using namespace caliburn;
+
+//Modules currently being imported on this thread, so that circular imports are caught instead of recursing forever
+static thread_local std::set<std::string> importing;
+
+/*
+Types can't be named through a module yet, so they're made visible directly, unless that would shadow something.
+*/
+static void exposeTypes(in<std::vector<sptr<Expr>>> ast, sptr<SymbolTable> modTable, sptr<SymbolTable> table)
+{
+	for (auto const& stmt : ast)
+	{
+		std::string_view typeName;
+
+		if (stmt->type == ExprType::TYPEDEF)
+		{
+			typeName = RCAST<ptr<const TypedefStmt>>(stmt.get())->name.str;
+		}
+		else if (stmt->type == ExprType::STRUCT || stmt->type == ExprType::RECORD || stmt->type == ExprType::CLASS)
+		{
+			typeName = RCAST<ptr<const StructStmt>>(stmt.get())->name.str;
+		}
+		else
+		{
+			continue;
+		}
+
+		auto const sym = modTable->findLocal(typeName);
+
+		if (std::holds_alternative<sptr<const BaseType>>(sym) && !table->has(typeName))
+		{
+			table->add(typeName, sym);
+		}
+
+	}
+
+}
+
+void ImportStmt::declareHeader(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ErrorHandler> err) const
+{
+	auto const modName = std::string(name.str);
+	auto const symName = alias.exists() ? alias.str : name.str;
+
+	//Sources within the same project take precedence over module files
+	if (auto const source = findImport(name.str))
+	{
+		if (!source->success() || source->headers == nullptr)
+		{
+			err.err({ "Cannot import module", name.str, "since it has errors" }, name);
+			return;
+		}
+
+		auto const modTable = importedHeaders(*source, settings);
+
+		if (!table->add(symName, new_sptr<SourceModule>(source, modTable)))
+		{
+			err.err({ "Duplicate symbol:", symName }, alias.exists() ? alias : name);
+			return;
+		}
+
+		exposeTypes(source->ast, modTable, table);
+
+		return;
+	}
+
+	if (settings->moduleDir.empty())
+	{
+		auto e = err.err({ "Cannot import", name.str }, *this);
+		e->note("Set CompilerSettings::moduleDir to the directory holding your module files");
+		return;
+	}
+
+	auto const iface = ModuleInterface::find(settings->moduleDir, modName);
+
+	if (iface == nullptr)
+	{
+		auto e = err.err({ "Module not found:", name.str }, name);
+		e->note({ "Looked for", moduleFilePath(settings->moduleDir, modName) });
+		return;
+	}
+
+	if (!importing.insert(modName).second)
+	{
+		err.err({ "Circular import of module", name.str }, name);
+		return;
+	}
+
+	auto const modHeaders = iface->headers(settings);
+
+	importing.erase(modName);
+
+	if (!modHeaders->errors.empty())
+	{
+		//Positions within these errors refer to the module's own text, so that's what they're formatted against
+		auto const modDoc = TextDoc(iface->text);
+
+		for (auto const& d : modHeaders->errors)
+		{
+			auto e = err.err({ "In module", std::string(name.str) + ":", d.message }, name);
+
+			if (settings->formatErrors)
+			{
+				e->note(formatDiagnostic(d, modDoc, settings->errorContextLines));
+			}
+
+		}
+
+	}
+
+	if (!table->add(symName, new_sptr<ImportedModule>(iface, modHeaders->table)))
+	{
+		err.err({ "Duplicate symbol:", symName }, alias.exists() ? alias : name);
+		return;
+	}
+
+	exposeTypes(iface->ast, modHeaders->table, table);
+
+}
@@ -21,10 +21,16 @@ void ScopeStmt::prettyPrint(out<std::stringstream> ss) const
 
 ValueResult ScopeStmt::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
-	scopeTable->reparent(table);
+	//Made fresh every time, since the same scope can be emitted by several assemblers at once
+	auto scopeTable = new_sptr<SymbolTable>(table);
 
 	for (auto const& inner : stmts)
 	{
+		if (codeAsm.cancel.isCancelled() || codeAsm.errors->isFull())
+		{
+			break;
+		}
+
 		inner->emitCodeCLLR(scopeTable, codeAsm);
 	}
 
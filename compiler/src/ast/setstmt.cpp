@@ -6,7 +6,7 @@ using namespace caliburn;
 
 ValueResult SetStmt::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
-	auto lres = lhs->emitCodeCLLR(table, codeAsm);
+	auto lres = lhs->emitLValueCLLR(table, codeAsm);
 	auto rres = rhs->emitCodeCLLR(table, codeAsm);
 
 	cllr::TypedSSA lval, rval;
@@ -27,7 +27,7 @@ ValueResult SetStmt::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembler>
 	}
 	else
 	{
-		//TODO complain
+		codeAsm.errors->err("Cannot assign something which isn't a value", *rhs);
 		return ValueResult();
 	}
 
@@ -8,9 +8,67 @@
 
 #include "spirv/cllrspirv.h"
 
+#include "stats.h"
+#include "threadpool.h"
+
 using namespace caliburn;
 
-uptr<Shader> ShaderStage::compile(sptr<const CompilerSettings> settings, out<std::vector<std::string>> errs, in<TextDoc> doc, sptr<SymbolTable> table, std::vector<IOVar> inputs, out<std::vector<IOVar>> outputs)
+uptr<Shader> caliburn::lowerStage(in<cllr::Assembler> codeAsm, sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errs, ptr<const TextDoc> doc, ptr<CompileStats> stats)
+{
+	uptr<Shader> outShader;
+
+	if (settings->gpuTarget == GPUTarget::SPIRV)
+	{
+		auto outTimer = StageTimer(stats ? &stats->outEmitNs : nullptr);
+
+		auto spirvAsm = cllr::SPIRVOutAssembler(settings);
+		auto spirvCode = spirvAsm.translateCLLR(codeAsm);
+
+		outTimer.stop();
+
+		if (stats)
+		{
+			stats->spirvWords += spirvCode.size();
+		}
+
+		//Whatever the backend made of code it couldn't translate isn't a usable shader
+		if (!spirvAsm.errors->empty())
+		{
+			spirvAsm.errors->report(errs, doc);
+
+			return nullptr;
+		}
+
+		//The backend's buffer becomes the shader's; No copy
+		outShader = new_uptr<Shader>(codeAsm.type, std::move(spirvCode));
+
+	}
+	else
+	{
+		//TODO complain
+		return nullptr;
+	}
+	
+	if (codeAsm.type == ShaderType::VERTEX)
+	{
+		for (auto const& var : codeAsm.getIOByType(ShaderIOVarType::INPUT))
+		{
+			//TODO assign input format
+			outShader->inputs.push_back(VertexInputAttribute{ std::string(var.name), var.index, 0});
+
+		}
+
+	}
+
+	return outShader;
+}
+
+std::string ShaderStage::getFullName() const
+{
+	return (std::stringstream() << parentName.str << "_" << SHADER_TYPE_NAMES.at(type)).str();
+}
+
+uptr<cllr::Assembler> ShaderStage::emit(sptr<const CompilerSettings> settings, sptr<SymbolTable> table, in<IOLayout> ioLayout, in<CancelToken> cancel, ptr<CompileStats> stats) const
 {
 	sptr<SymbolTable> stageTable = table;
 
@@ -26,103 +84,187 @@ uptr<Shader> ShaderStage::compile(sptr<const CompilerSettings> settings, out<std
 
 	}
 
-	auto codeAsm = cllr::Assembler(type, settings, inputs);
+	auto const fullName = getFullName();
+
+	auto const trace = TraceWriter::forSettings(*settings);
+	auto emitTimer = StageTimer(stats ? &stats->cllrEmitNs : nullptr, trace, "CLLR emit");
+
+	auto codeAsm = new_uptr<cllr::Assembler>(type, settings, ioLayout);
+	codeAsm->cancel = cancel;
 
-	auto const fullName = (std::stringstream() << parentName.str << "_" << SHADER_TYPE_NAMES.at(type)).str();
-	auto const nameID = SCAST<uint32_t>(codeAsm.addString(fullName));
+	auto const nameID = SCAST<uint32_t>(codeAsm->addString(fullName));
 
-	auto const typeOut = base->returnType->resolve(stageTable, codeAsm);
+	auto const typeOut = base->returnType->resolve(stageTable, *codeAsm);
 
 	if (typeOut == nullptr)
 	{
-		codeAsm.errors->err("Could not resolve type", *base->returnType);
+		codeAsm->errors->err("Could not resolve type", *base->returnType);
 
-		return nullptr;
+		return codeAsm;
+	}
+
+	uint32_t retLocation = 0;
+
+	//A fragment shader's returned colour is an output of its own, so it gets the first location before any variables do
+	if (type == ShaderType::FRAGMENT)
+	{
+		retLocation = codeAsm->reserveOutput();
+	}
+
+	auto const stageID = codeAsm->beginSect(cllr::Instruction(cllr::Opcode::SHADER_STAGE, { (uint32_t)type, nameID, retLocation }, { typeOut->id }).debug(first));
+
+	base->code->emitCodeCLLR(stageTable, *codeAsm);
+
+	codeAsm->endSect(cllr::Instruction(cllr::Opcode::SHADER_STAGE_END, {}, { stageID }));
+
+	emitTimer.stop();
+
+	if (stats)
+	{
+		stats->cllrInstructions += codeAsm->getCode().size();
+		stats->ssaIDs += codeAsm->getSSACount();
+		stats->genericInstances += codeAsm->countGenericImpls();
 	}
 
-	auto const stageID = codeAsm.beginSect(cllr::Instruction(cllr::Opcode::SHADER_STAGE, { (uint32_t)type, nameID }, { typeOut->id }).debug(first));
+	return codeAsm;
+}
+
+uptr<Shader> ShaderStage::compile(sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errs, in<TextDoc> doc, sptr<SymbolTable> table, in<IOLayout> ioLayout, in<CancelToken> cancel, ptr<CompileStats> stats) const
+{
+	auto const trace = TraceWriter::forSettings(*settings);
+	auto stageSpan = TraceSpan(trace, "Shader stage", getFullName());
 
-	base->code->emitCodeCLLR(stageTable, codeAsm);
+	auto const asmPtr = emit(settings, table, ioLayout, cancel, stats);
+	auto& codeAsm = *asmPtr;
 
-	codeAsm.endSect(cllr::Instruction(cllr::Opcode::SHADER_STAGE_END, {}, { stageID }));
+	if (cancel.isCancelled())
+	{
+		return nullptr;
+	}
 
 	if (!codeAsm.errors->empty())
 	{
-		codeAsm.errors->printout(errs, doc);
+		codeAsm.errors->report(errs, &doc);
 
 		return nullptr;
 	}
 
+	auto validTimer = StageTimer(stats ? &stats->cllrValidationNs : nullptr, trace, "CLLR validation");
 	auto validator = cllr::Validator(settings);
 	
 	if (!validator.validate(codeAsm))
+	{
+		validator.errors->report(errs, &doc);
+
+		return nullptr;
+	}
+
+	if (cancel.isCancelled())
 	{
 		return nullptr;
 	}
 
+	validTimer.stop();
+
+	auto optTimer = StageTimer(stats ? &stats->optimizationNs : nullptr, trace, "Optimization");
 	auto op = cllr::Optimizer(settings);
 	op.optimize(codeAsm);
+	optTimer.stop();
 
-	uptr<Shader> outShader;
-
-	if (settings->gpuTarget == GPUTarget::SPIRV)
+	if (cancel.isCancelled())
 	{
-		auto spirvAsm = cllr::SPIRVOutAssembler(settings);
-		auto spirvCode = spirvAsm.translateCLLR(codeAsm);
-		
-		outShader = new_uptr<Shader>(type, spirvCode);
+		return nullptr;
+	}
 
-		spirvAsm.errors->printout(errs, doc);
+	auto outShader = lowerStage(codeAsm, settings, errs, &doc, stats);
 
-	}
-	else
+	if (outShader != nullptr && settings->emitCLLR)
 	{
-		//TODO complain
-		return nullptr;
+		codeAsm.save(outShader->cllr);
 	}
-	
-	if (type == ShaderType::VERTEX)
-	{
-		for (auto const& var : codeAsm.getIOByType(ShaderIOVarType::INPUT))
-		{
-			//TODO assign input format
-			outShader->inputs.push_back(VertexInputAttribute{ std::string(var.name), var.index, 0});
 
-		}
+	return outShader;
+}
 
+sptr<SymbolTable> ShaderStmt::makeTable(sptr<SymbolTable> table) const
+{
+	auto shaderSyms = new_sptr<SymbolTable>(table);
+
+	for (auto const& io : ioVars)
+	{
+		shaderSyms->add(io->name, io);
 	}
 
-	outputs = codeAsm.getIOByType(ShaderIOVarType::OUTPUT);
+	return shaderSyms;
+}
 
-	return outShader;
+IOLayout ShaderStmt::makeIOLayout() const
+{
+	//Locations of what's passed between stages; They follow declaration order, so every stage agrees on them
+	IOLayout ioLayout;
+
+	for (auto const& io : ioVars)
+	{
+		ioLayout.emplace(io->name, (uint32_t)ioLayout.size());
+	}
+
+	return ioLayout;
 }
 
-void ShaderStmt::compile(sptr<SymbolTable> table, sptr<CompilerSettings> settings, out<ShaderResult> result, in<TextDoc> doc)
+void ShaderStmt::compile(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<ShaderResult> result, in<TextDoc> doc, in<CancelToken> cancel, out<ThreadPool> pool) const
 {
 	if (stages.empty())
 	{
 		return;
 	}
 
-	auto shaderSyms = new_sptr<SymbolTable>(table);
+	auto const shaderSyms = makeTable(table);
+	auto const ioLayout = makeIOLayout();
 
-	for (auto const& io : ioVars)
+	//Sort a view of the stages, since the same shader can be compiled many times over, even concurrently
+	std::vector<ptr<const ShaderStage>> sorted;
+
+	for (auto const& stage : stages)
 	{
-		shaderSyms->add(io->name, io);
+		sorted.push_back(stage.get());
 	}
 
-	std::sort(stages.begin(), stages.end());
+	std::stable_sort(sorted.begin(), sorted.end(), LAMBDA(ptr<const ShaderStage> a, ptr<const ShaderStage> b)
+	{
+		return *a < *b;
+	});
 
-	std::vector<IOVar> inputs{};
+	//Every stage gets its own errors and stats, so that they're still added in pipeline order
+	std::vector<uptr<Shader>> shaders(sorted.size());
+	std::vector<std::vector<Diagnostic>> stageErrs(sorted.size());
+	std::vector<CompileStats> stageStats(sorted.size());
 
-	for (auto const& stage : stages)
+	//Stages only share the I/O layout, which is already decided; The pool's threads are already running, so handing it
+	//even small stages costs little more than a queue push
+	pool.forEach(sorted.size(), [&](size_t i)
+	{
+		if (!cancel.isCancelled())
+		{
+			shaders[i] = sorted[i]->compile(settings, stageErrs[i], doc, shaderSyms, ioLayout, cancel, settings->collectStats ? &stageStats[i] : nullptr);
+		}
+
+	});
+
+	for (size_t i = 0; i < sorted.size(); ++i)
 	{
-		std::vector<IOVar> outputs;
+		result.diagnostics.insert(result.diagnostics.end(), stageErrs[i].begin(), stageErrs[i].end());
+		result.stats += stageStats[i];
 
-		auto shader = stage->compile(settings, result.errors, doc, shaderSyms, inputs, outputs);
+		auto& shader = shaders[i];
 
 		if (shader == nullptr)
 		{
+			//Otherwise the result would look successful, just with a stage missing
+			if (stageErrs[i].empty() && !cancel.isCancelled())
+			{
+				result.diagnostics.push_back(Diagnostic{ CompileStage::UNKNOWN, "Could not compile shader stage " + sorted[i]->getFullName() });
+			}
+
 			continue;
 		}
 
@@ -130,18 +272,44 @@ void ShaderStmt::compile(sptr<SymbolTable> table, sptr<CompilerSettings> setting
 
 		for (auto const& [_, name] : descriptors)
 		{
-			shader->sets.push_back(DescriptorSet{ std::string(name.str), descIdx });
+			shader->sets.push_back(DescriptorSet{ std::string(name.str), descIdx, 0 });
 			++descIdx;
 		}
 
 		result.shaders.push_back(std::move(shader));
 
-		for (auto const& out : outputs)
+	}
+
+	//Keeps a cancelled compile from ever looking like a successful one
+	if (cancel.isCancelled())
+	{
+		result.diagnostics.push_back(Diagnostic{ CompileStage::UNKNOWN, "Compilation cancelled" });
+	}
+
+}
+
+void ShaderStmt::check(sptr<SymbolTable> table, sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errs, in<TextDoc> doc, in<CancelToken> cancel, out<ThreadPool> pool) const
+{
+	auto const shaderSyms = makeTable(table);
+	auto const ioLayout = makeIOLayout();
+
+	//Emitted on the pool for the same reasons as in compile()
+	std::vector<std::vector<Diagnostic>> stageErrs(stages.size());
+
+	pool.forEach(stages.size(), [&](size_t i)
+	{
+		if (!cancel.isCancelled())
 		{
-			inputs.push_back(IOVar{ out.name, ShaderIOVarType::INPUT, out.index });
+			auto const codeAsm = stages[i]->emit(settings, shaderSyms, ioLayout, cancel, nullptr);
 
+			codeAsm->errors->report(stageErrs[i], &doc);
 		}
 
+	});
+
+	for (auto const& stageErr : stageErrs)
+	{
+		errs.insert(errs.end(), stageErr.begin(), stageErr.end());
 	}
 
 }
@@ -0,0 +1,12 @@
+
+#include "ast/stdlib.h"
+
+using namespace caliburn;
+
+sptr<const SymbolTable> caliburn::sharedStdLib()
+{
+	//Initialization of function statics is thread-safe
+	static const sptr<const SymbolTable> stdLib = makeStdLib();
+
+	return stdLib;
+}
@@ -27,7 +27,7 @@ bool SymbolTable::add(std::string_view symName, in<Symbol> sym)
 	return true;
 }
 
-bool SymbolTable::addType(sptr<BaseType> t)
+bool SymbolTable::addType(sptr<const BaseType> t)
 {
 	return add(t->canonName, t);
 }
@@ -49,6 +49,18 @@ Symbol SymbolTable::find(std::string_view symName) const
 	return Symbol();
 }
 
+Symbol SymbolTable::findLocal(std::string_view symName) const
+{
+	auto result = symbols.find(symName);
+
+	if (result != symbols.end())
+	{
+		return result->second;
+	}
+
+	return Symbol();
+}
+
 bool SymbolTable::has(std::string_view symName) const
 {
 	return !std::holds_alternative<std::monostate>(find(symName));
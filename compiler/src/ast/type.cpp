@@ -32,11 +32,11 @@ void ParsedType::prettyPrint(out<std::stringstream> ss) const
 
 }
 
-sptr<BaseType> ParsedType::resolveBase(sptr<const SymbolTable> table) const
+sptr<const BaseType> ParsedType::resolveBase(sptr<const SymbolTable> table) const
 {
 	auto typeSym = table->find(name);
 
-	if (auto bType = std::get_if<sptr<BaseType>>(&typeSym))
+	if (auto bType = std::get_if<sptr<const BaseType>>(&typeSym))
 	{
 		return *bType;
 	}
@@ -69,7 +69,7 @@ sptr<cllr::LowType> ParsedType::resolve(sptr<const SymbolTable> table, out<cllr:
 
 		return *lType;
 	}
-	else MATCH(typeSym, sptr<BaseType>, bType)
+	else MATCH(typeSym, sptr<const BaseType>, bType)
 	{
 		return (**bType).resolve(genericArgs, table, codeAsm);
 	}
@@ -86,7 +86,8 @@ sptr<ParsedType> ParsedType::parse(in<std::string> str)
 {
 	//Not a fan of doing this, BUT the code reuse is super easy
 	Tokenizer t(new_sptr<TextDoc>(str));
-	Parser p(t.tokenize());
+	auto const tokens = t.tokenize();
+	Parser p(tokens);
 
 	auto pt = p.parseTypeName();
 
@@ -271,7 +271,7 @@ ValueResult VarReadValue::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assemb
 		return *mod;
 	}
 
-	MATCH(sym, sptr<BaseType>, t)
+	MATCH(sym, sptr<const BaseType>, t)
 	{
 		return *t;
 	}
@@ -285,6 +285,25 @@ ValueResult VarReadValue::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assemb
 	return ValueResult();
 }
 
+ValueResult VarReadValue::emitLValueCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const
+{
+	auto const sym = table->find(varStr);
+
+	MATCH(sym, sptr<Variable>, var)
+	{
+		auto const lval = (*var)->emitLValueCLLR(table, codeAsm, varTkn);
+
+		if (lval.value == 0)
+		{
+			return ValueResult();
+		}
+
+		return lval;
+	}
+
+	return emitCodeCLLR(table, codeAsm);
+}
+
 ValueResult MemberReadDirectValue::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembler> codeAsm) const
 {
 	auto tgtRes = target->emitCodeCLLR(table, codeAsm);
@@ -355,7 +374,7 @@ ValueResult MemberReadChainValue::emitCodeCLLR(sptr<SymbolTable> table, out<cllr
 			return *fn;
 		}
 
-		MATCH(targetSym, sptr<BaseType>, t)
+		MATCH(targetSym, sptr<const BaseType>, t)
 		{
 			return *t;
 		}
@@ -470,7 +489,7 @@ ValueResult FnCallValue::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Assembl
 	{
 		return (*fnGroup)->call(argIDs, genArgs, codeAsm);
 	}
-	else MATCH(fnResult, sptr<BaseType>, baseType)
+	else MATCH(fnResult, sptr<const BaseType>, baseType)
 	{
 		lType = (*baseType)->resolve(genArgs, table, codeAsm);
 	}
@@ -550,7 +569,7 @@ ValueResult MethodCallValue::emitCodeCLLR(sptr<SymbolTable> table, out<cllr::Ass
 			return (**fg).call(argIDs, genArgs, codeAsm);
 		}
 
-		//TODO construct type if sptr<BaseType> or sptr<LowType> found
+		//TODO construct type if sptr<const BaseType> or sptr<LowType> found
 
 		auto e = codeAsm.errors->err("Not a function:", name);
 		return ValueResult();
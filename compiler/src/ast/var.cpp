@@ -38,19 +38,23 @@ void LocalVariable::prettyPrint(out<std::stringstream> ss) const
 
 cllr::TypedSSA LocalVariable::emitVarCLLR(sptr<const SymbolTable> table, bool isBeingWritten, out<cllr::Assembler> codeAsm)
 {
+	auto& varData = codeAsm.getVarData(this);
+
 	if (varData.value != 0)
 	{
 		return varData;
 	}
 
-	if (initValue == nullptr)
+	auto init = initValue;
+
+	if (init == nullptr)
 	{
-		initValue = new_sptr<ZeroValue>();
+		init = new_sptr<ZeroValue>();
 	}
 
 	auto localScope = new_sptr<SymbolTable>(table);
 
-	auto initRes = initValue->emitCodeCLLR(localScope, codeAsm);
+	auto initRes = init->emitCodeCLLR(localScope, codeAsm);
 	cllr::TypedSSA v;
 
 	MATCH(initRes, cllr::TypedSSA, valPtr)
@@ -59,7 +63,7 @@ cllr::TypedSSA LocalVariable::emitVarCLLR(sptr<const SymbolTable> table, bool is
 	}
 	else
 	{
-		codeAsm.errors->err("Invalid variable initializer", *initValue);
+		codeAsm.errors->err("Invalid variable initializer", *init);
 		return cllr::TypedSSA();
 	}
 
@@ -255,6 +259,18 @@ void ShaderIOVariable::emitStoreCLLR(sptr<const SymbolTable> table, out<cllr::As
 
 }
 
+cllr::TypedSSA ShaderIOVariable::emitLValueCLLR(sptr<const SymbolTable> table, out<cllr::Assembler> codeAsm, in<Token> nameTkn)
+{
+	if (isVertexInput)
+	{
+		codeAsm.errors->err({ "Vertex input", std::string(name), "cannot be assigned to" }, nameTkn);
+		return cllr::TypedSSA();
+	}
+
+	//Reading it first would make it an input, so the output variable itself is written to
+	return emitVarCLLR(table, true, codeAsm);
+}
+
 cllr::TypedSSA ShaderIOVariable::emitVarCLLR(sptr<const SymbolTable> table, bool isBeingWritten, out<cllr::Assembler> codeAsm)
 {
 	if (auto t = typeHint->resolve(table, codeAsm))
@@ -2,95 +2,822 @@
 #define CBRN_BUILD_DLL
 #include "caliburn.h"
 
+#include <algorithm>
+#include <exception>
+#include <set>
+
+#include "diskcache.h"
 #include "error.h"
-#include "parser.h"
-#include "tokenizer.h"
+#include "modfile.h"
+#include "program.h"
+#include "project.h"
+#include "resultcache.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
 
-#include "ast/rootmod.h"
-#include "ast/ctrlstmt.h"
 #include "ast/modstmts.h"
-#include "ast/stdlib.h"
+
+#include "cllr/cllrasm.h"
+#include "cllr/cllrvalid.h"
 
 using namespace caliburn;
 
+/*
+Adds an error which isn't about any code in particular, so it needs no formatting.
+*/
+static void addError(out<ShaderResult> result, in<std::string> msg)
+{
+	result.diagnostics.push_back(Diagnostic{ CompileStage::UNKNOWN, msg });
+	result.errors.push_back(msg);
+}
+
+/*
+Loads every named shader it can from the disk cache. Returns the names which weren't found, without duplicates.
+
+srcKey: See DiskCache::makeSourceKey(). If null, the disk cache is off, and every name is a miss.
+*/
+static std::vector<std::string> loadCached(ptr<const Digest> srcKey, in<std::vector<std::string>> names, in<CompilerSettings> settings, out<std::map<std::string, ShaderResult>> results)
+{
+	std::vector<std::string> misses;
+	std::set<std::string_view> seen;
+
+	auto const cache = DiskCache(settings.cacheDir);
+
+	for (auto const& name : names)
+	{
+		if (!seen.insert(name).second)
+		{
+			continue;
+		}
+
+		if (srcKey != nullptr)
+		{
+			ShaderResult cached;
+
+			if (cache.load(DiskCache::makeKey(*srcKey, name), cached))
+			{
+				results[name] = std::move(cached);
+				continue;
+			}
+
+		}
+
+		misses.push_back(name);
+
+	}
+
+	return misses;
+}
+
+/*
+Compiles shader objects within a prepared program. If no names are given, every shader object is compiled.
+
+srcKey: The program's disk cache key, if the caller already made one; See DiskCache::makeSourceKey().
+*/
+static std::map<std::string, ShaderResult> compileEach(out<ThreadPool> pool, in<PreparedProgram> prog, in<std::vector<std::string>> shaderNames, sptr<const CompilerSettings> settings, in<CancelToken> cancel, ptr<const Digest> srcKey)
+{
+	std::map<std::string, ShaderResult> results;
+
+	bool const compileAll = shaderNames.empty();
+	std::vector<std::string> names;
+
+	//A source which didn't parse may have only some of its shaders, so it's reported under an empty name instead
+	if (compileAll && prog.errors.empty())
+	{
+		for (auto const& [name, _] : prog.shaders)
+		{
+			names.push_back(std::string(name));
+		}
+
+	}
+
+	//Every other name still gets its own result
+	for (auto const& name : shaderNames)
+	{
+		if (name.length() == 0)
+		{
+			if (results[name].errors.empty())
+			{
+				addError(results[name], "Passed shader name is empty!");
+			}
+
+			continue;
+		}
+
+		names.push_back(name);
+
+	}
+
+	//Every shader's key starts with this, so the source is only hashed once however many shaders there are
+	Digest progKey{};
+
+	if (!settings->cacheDir.empty() && srcKey == nullptr)
+	{
+		progKey = DiskCache::makeSourceKey(prog.src->text(), *settings, prog.importKey);
+		srcKey = &progKey;
+	}
+
+	auto const pending = loadCached(srcKey, names, *settings, results);
+
+	if (!names.empty() && pending.empty())
+	{
+		return results;
+	}
+
+	auto errors = prog.errors;
+	auto table = prog.headers;
+	auto frontStats = prog.stats;
+
+	if (errors.empty())
+	{
+		//Dynamic types are resolved when declaring headers, so different ones need their own symbol table
+		if (settings->dynTypes == prog.headerDynTypes)
+		{
+			errors = prog.headerErrors;
+		}
+		else
+		{
+			frontStats.symbolGenNs = 0;
+
+			auto timer = StageTimer(settings->collectStats ? &frontStats.symbolGenNs : nullptr, TraceWriter::forSettings(*settings), "Symbol generation");
+			table = declareHeaders(prog, settings, errors);
+
+		}
+
+	}
+
+	if (!errors.empty())
+	{
+		if (compileAll)
+		{
+			//Only a single result under an empty name, whatever shaders were found
+			results.clear();
+			results[""].diagnostics = errors;
+
+			return results;
+		}
+
+		for (auto const& name : pending)
+		{
+			results[name].diagnostics = errors;
+		}
+
+		return results;
+	}
+
+	//COMPILE
+
+	for (auto const& name : pending)
+	{
+		auto& result = results[name];
+
+		if (settings->collectStats)
+		{
+			result.stats = frontStats;
+		}
+
+		auto found = prog.shaders.find(name);
+
+		if (found == prog.shaders.end())
+		{
+			result.diagnostics.push_back(Diagnostic{ CompileStage::UNKNOWN, "Shader not found: " + name });
+			continue;
+		}
+
+		if (cancel.isCancelled())
+		{
+			break;
+		}
+
+		//where the real magic happens
+		{
+			auto span = TraceSpan(TraceWriter::forSettings(*settings), "Compile shader", name);
+			found->second->compile(table, settings, result, *prog.doc, cancel, pool);
+		}
+
+		//A cancelled compile stops wherever it was, so it's marked right away, and never reaches the disk cache.
+		//compileProgram() replaces every result once they're all back.
+		if (cancel.isCancelled())
+		{
+			result.cancelled = true;
+			break;
+		}
+
+		//A stage which failed without saying why mustn't be cached as a good result
+		if (srcKey != nullptr && result.shaders.size() == found->second->stages.size())
+		{
+			DiskCache(settings->cacheDir).store(DiskCache::makeKey(*srcKey, name), result);
+		}
+
+	}
+
+	return results;
+}
+
+/*
+Finds the errors in a prepared program without making any shaders. Headers are only declared again if the settings
+call for different dynamic types.
+
+typeCheck: If set, every shader stage's CLLR is emitted too, stopping right before validation.
+*/
+static std::vector<Diagnostic> checkProgram(out<ThreadPool> pool, in<PreparedProgram> prog, sptr<const CompilerSettings> settings, bool typeCheck, in<CancelToken> cancel)
+{
+	if (!prog.success())
+	{
+		return prog.errors;
+	}
+
+	auto table = prog.headers;
+	std::vector<Diagnostic> errors;
+
+	if (settings->dynTypes == prog.headerDynTypes)
+	{
+		errors = prog.headerErrors;
+	}
+	else
+	{
+		table = declareHeaders(prog, settings, errors);
+	}
+
+	if (!errors.empty() || !typeCheck)
+	{
+		return errors;
+	}
+
+	for (auto const& [_, shader] : prog.shaders)
+	{
+		shader->check(table, settings, errors, *prog.doc, cancel, pool);
+	}
+
+	return errors;
+}
+
+/*
+Same as compileEach(), but if the compilation was cancelled, every result is replaced with a cancelled one, so callers
+never see partial results.
+
+Errors are only formatted here, once everything is compiled. Results loaded from the disk cache never have any, since
+only successful compiles are stored.
+*/
+static std::map<std::string, ShaderResult> compileProgram(out<ThreadPool> pool, in<PreparedProgram> prog, in<std::vector<std::string>> shaderNames, sptr<const CompilerSettings> settings, in<CancelToken> cancel, ptr<const Digest> srcKey = nullptr)
+{
+	auto results = compileEach(pool, prog, shaderNames, settings, cancel, srcKey);
+
+	if (auto trace = TraceWriter::forSettings(*settings))
+	{
+		trace->flush();
+	}
+
+	if (cancel.isCancelled())
+	{
+		for (auto& [_, result] : results)
+		{
+			result.shaders.clear();
+			result.errors = { "Compilation cancelled" };
+			result.diagnostics = { Diagnostic{ CompileStage::UNKNOWN, "Compilation cancelled" } };
+			result.cancelled = true;
+		}
+
+		return results;
+	}
+
+	for (auto& [_, result] : results)
+	{
+		if (!result.diagnostics.empty())
+		{
+			//addError() already put in bare messages; The formatted ones replace them
+			result.errors.clear();
+			formatDiagnostics(result.diagnostics, *prog.doc, *settings, result.errors);
+		}
+
+	}
+
+	return results;
+}
+
+/*
+Compiles a single shader object within a prepared program, through an in-memory cache. Results are keyed by the
+source, the settings, and whatever the program imports.
+
+useCache: If not set, the cache is skipped entirely.
+*/
+static std::shared_ptr<const ShaderResult> compileCached(out<ThreadPool> pool, out<ResultCache> cache, in<PreparedProgram> prog, in<std::string> shaderName, sptr<const CompilerSettings> settings, bool useCache)
+{
+	auto const compile = LAMBDA()
+	{
+		auto results = compileProgram(pool, prog, { shaderName }, settings, CancelToken());
+
+		return new_sptr<const ShaderResult>(std::move(results.at(shaderName)));
+	};
+
+	if (!useCache || shaderName.length() == 0)
+	{
+		return compile();
+	}
+
+	auto const key = ResultCache::makeKey(prog.src->text(), *settings, shaderName, prog.importKey);
+
+	if (auto found = cache.find(key))
+	{
+		return found;
+	}
+
+	auto result = compile();
+
+	cache.add(key, result);
+
+	return result;
+}
+
+/*
+Compiles a set of shader objects within raw source code, only preparing it if some aren't already in the disk cache.
+*/
+static std::map<std::string, ShaderResult> compileNamed(out<ThreadPool> pool, sptr<const SourceText> src, in<std::vector<std::string>> shaderNames, sptr<const CompilerSettings> settings, in<CancelToken> cancel)
+{
+	std::map<std::string, ShaderResult> results;
+
+	if (shaderNames.empty())
+	{
+		return results;
+	}
+
+	//Don't bother tokenizing or parsing if every shader was already compiled
+	if (std::find(shaderNames.begin(), shaderNames.end(), "") == shaderNames.end())
+	{
+		Digest srcKey{};
+
+		if (!settings->cacheDir.empty())
+		{
+			srcKey = DiskCache::makeSourceKey(src->text(), *settings);
+		}
+
+		auto const keyPtr = settings->cacheDir.empty() ? nullptr : &srcKey;
+		auto const misses = loadCached(keyPtr, shaderNames, *settings, results);
+
+		if (misses.empty())
+		{
+			return results;
+		}
+
+		auto compiled = compileProgram(pool, *prepareProgram(src, settings, cancel), misses, settings, cancel, keyPtr);
+		results.insert(std::make_move_iterator(compiled.begin()), std::make_move_iterator(compiled.end()));
+
+		return results;
+	}
+
+	return compileProgram(pool, *prepareProgram(src, settings, cancel), shaderNames, settings, cancel);
+}
+
+/*
+Runs compile(i) for every index below count, spread over the pool, and returns the results in order. See
+ThreadPool::forEach().
+*/
+template<typename Fn>
+static std::vector<std::map<std::string, ShaderResult>> compileOnPool(out<ThreadPool> pool, size_t count, Fn compile)
+{
+	std::vector<std::map<std::string, ShaderResult>> results(count);
+
+	pool.forEach(count, [&results, &compile](size_t i)
+	{
+		results[i] = compile(i);
+	});
+
+	return results;
+}
+
+/*
+Adds the interface file of every module an AST imports, and of every module those import in turn. Imports found within
+projectImports are left out, since they're project sources, not modules.
+*/
+static void addModuleFiles(in<std::vector<sptr<Expr>>> ast, ptr<const std::map<std::string, sptr<const PreparedProgram>, std::less<>>> projectImports, in<std::string> moduleDir, out<std::set<std::string>> deps)
+{
+	if (moduleDir.empty())
+	{
+		return;
+	}
+
+	for (auto const& stmt : ast)
+	{
+		if (stmt->type != ExprType::IMPORT)
+		{
+			continue;
+		}
+
+		auto const name = RCAST<ptr<const ImportStmt>>(stmt.get())->name.str;
+
+		if (projectImports != nullptr && projectImports->find(name) != projectImports->end())
+		{
+			continue;
+		}
+
+		auto const path = moduleFilePath(moduleDir, name);
+
+		//Already followed
+		if (deps.count(path))
+		{
+			continue;
+		}
+
+		if (auto const mod = ModuleInterface::find(moduleDir, std::string(name)))
+		{
+			deps.insert(path);
+			addModuleFiles(mod->ast, nullptr, moduleDir, deps);
+		}
+
+	}
+
+}
+
+Compiler::Compiler() : Compiler(CompilerSettings()) {}
+
+Compiler::Compiler(const CompilerSettings& cs) :
+	settings(new_sptr<CompilerSettings>(cs)),
+	memCache(new_sptr<ResultCache>(cs.memCacheBytes)),
+	pool(new_sptr<ThreadPool>(cs.workerThreads)) {}
+
 ShaderResult Compiler::compileSrcShaders(const std::string& src, const std::string& shaderName)
 {
 	ShaderResult result;
 
 	if (shaderName.length() == 0)
 	{
-		result.errors.push_back("Passed shader name is empty!");
+		addError(result, "Passed shader name is empty!");
 		return result;
 	}
 
-	auto doc = new_sptr<TextDoc>(src);
+	auto results = compileShaders(src, { shaderName });
+
+	return std::move(results.at(shaderName));
+}
+
+std::shared_ptr<const ShaderResult> Compiler::compileSrcShadersCached(const std::string& src, const std::string& shaderName)
+{
+	if (settings->memCacheBytes == 0)
+	{
+		return new_sptr<const ShaderResult>(compileSrcShaders(src, shaderName));
+	}
+
+	auto const key = ResultCache::makeKey(src, *settings, shaderName);
+
+	if (auto found = memCache->find(key))
+	{
+		return found;
+	}
+
+	auto result = new_sptr<const ShaderResult>(compileSrcShaders(src, shaderName));
+
+	memCache->add(key, result);
+
+	return result;
+}
+
+CacheStats Compiler::getCacheStats() const
+{
+	return memCache->getStats();
+}
+
+void Compiler::clearCache()
+{
+	memCache->clear();
+}
+
+std::map<std::string, ShaderResult> Compiler::compileAllShaders(const std::string& src)
+{
+	return compileProgram(*pool, *prepare(src), {}, settings, CancelToken());
+}
+
+std::map<std::string, ShaderResult> Compiler::compileShaders(const std::string& src, const std::vector<std::string>& shaderNames)
+{
+	return compileNamed(*pool, new_sptr<ViewSource>(src), shaderNames, settings, CancelToken());
+}
+
+std::shared_ptr<const PreparedProgram> Compiler::prepare(const std::string& src)
+{
+	return prepareProgram(src, settings);
+}
+
+std::shared_ptr<const PreparedProgram> Compiler::reprepare(const std::shared_ptr<const PreparedProgram>& previous, const std::string& src, const TextEdit& edit)
+{
+	return reprepareProgram(previous, src, edit, settings);
+}
+
+std::vector<std::string> Compiler::diagnose(const std::shared_ptr<const PreparedProgram>& program)
+{
+	std::vector<std::string> errors;
+
+	formatDiagnostics(checkProgram(*pool, *program, settings, false, CancelToken()), *program->doc, *settings, errors);
+
+	return errors;
+}
+
+std::vector<std::string> Compiler::diagnose(const std::shared_ptr<const PreparedProgram>& program, const CompilerSettings& cs)
+{
+	auto const jobSettings = new_sptr<const CompilerSettings>(cs);
+	std::vector<std::string> errors;
+
+	formatDiagnostics(checkProgram(*pool, *program, jobSettings, false, CancelToken()), *program->doc, *jobSettings, errors);
+
+	return errors;
+}
+
+std::vector<Diagnostic> Compiler::check(const std::string& src)
+{
+	auto const prog = prepareProgram(new_sptr<ViewSource>(src), settings);
+
+	return checkProgram(*pool, *prog, settings, true, CancelToken());
+}
+
+std::vector<Diagnostic> Compiler::checkPrepared(const std::shared_ptr<const PreparedProgram>& program)
+{
+	return checkProgram(*pool, *program, settings, true, CancelToken());
+}
+
+std::map<std::string, ShaderResult> Compiler::compilePrepared(const std::shared_ptr<const PreparedProgram>& program, const std::vector<std::string>& shaderNames)
+{
+	return compileProgram(*pool, *program, shaderNames, settings, CancelToken());
+}
+
+std::shared_ptr<const ShaderResult> Compiler::compilePreparedCached(const std::shared_ptr<const PreparedProgram>& program, const std::string& shaderName)
+{
+	return compileCached(*pool, *memCache, *program, shaderName, settings, settings->memCacheBytes != 0);
+}
+
+std::shared_ptr<const ShaderResult> Compiler::compilePreparedCached(const std::shared_ptr<const PreparedProgram>& program, const std::string& shaderName, const CompilerSettings& cs)
+{
+	return compileCached(*pool, *memCache, *program, shaderName, new_sptr<const CompilerSettings>(cs), settings->memCacheBytes != 0);
+}
+
+std::vector<std::map<std::string, ShaderResult>> Compiler::compilePermutations(const std::shared_ptr<const PreparedProgram>& program, const std::vector<std::string>& shaderNames, const std::vector<CompilerSettings>& permutations)
+{
+	return compileOnPool(*pool, permutations.size(), [pool = pool.get(), program, shaderNames, permutations](size_t i)
+	{
+		return compileProgram(*pool, *program, shaderNames, new_sptr<const CompilerSettings>(permutations[i]), CancelToken());
+	});
+
+}
 
-	auto t = Tokenizer(doc);
-	auto tokens = t.tokenize();
+ShaderResult Compiler::compileFileShaders(const std::string& path, const std::string& shaderName)
+{
+	ShaderResult result;
 
-	auto p = Parser(settings, tokens);
-	auto ast = p.parse();
+	if (shaderName.length() == 0)
+	{
+		addError(result, "Passed shader name is empty!");
+		return result;
+	}
 
-	if (!p.errors->empty())
+	auto const file = MappedFile::open(path);
+
+	if (file == nullptr)
 	{
-		p.errors->printout(result.errors, *doc);
+		addError(result, "Could not read file: " + path);
 		return result;
 	}
 
-	//TODO AST validation and conditional compilation go here
+	return std::move(compileNamed(*pool, file, { shaderName }, settings, CancelToken()).at(shaderName));
+}
 
-	//COMPILE
+std::vector<std::map<std::string, ShaderResult>> Compiler::compileBatch(const std::vector<BatchJob>& jobs)
+{
+	return compileOnPool(*pool, jobs.size(), [pool = pool.get(), jobs](size_t i)
+	{
+		return compileProgram(*pool, *jobs[i].program, jobs[i].shaderNames, new_sptr<const CompilerSettings>(jobs[i].settings), CancelToken());
+	});
 
-	ptr<ShaderStmt> shaderStmt = nullptr;
+}
 
-	for (auto const& stmt : ast)
+std::vector<std::string> Compiler::dependencies(const std::shared_ptr<const PreparedProgram>& program)
+{
+	std::set<std::string> deps;
+	std::set<ptr<const PreparedProgram>> visited;
+	std::vector<ptr<const PreparedProgram>> pending = { program.get() };
+
+	while (!pending.empty())
 	{
-		//where the real magic happens
-		if (stmt->type == ExprType::SHADER)
+		auto const prog = pending.back();
+		pending.pop_back();
+
+		if (!visited.insert(prog).second)
 		{
-			auto shadDecl = RCAST<ptr<ShaderStmt>>(stmt.get());
+			continue;
+		}
 
-			if (shadDecl->name.str != shaderName)
-			{
-				continue;
-			}
+		if (!prog->path.empty())
+		{
+			deps.insert(prog->path);
+		}
 
-			if (shaderStmt == nullptr)
-			{
-				shaderStmt = shadDecl;
-			}
+		for (auto const& [_, imported] : prog->imports)
+		{
+			pending.push_back(imported.get());
+		}
 
-			break;
+		addModuleFiles(prog->ast, &prog->imports, settings->moduleDir, deps);
+
+	}
+
+	return std::vector<std::string>(deps.begin(), deps.end());
+}
+
+std::vector<std::map<std::string, ShaderResult>> Compiler::compileFiles(const std::vector<std::string>& paths, const std::vector<std::string>& shaderNames)
+{
+	return compileOnPool(*pool, paths.size(), [pool = pool.get(), paths, shaderNames, cs = settings](size_t i)
+	{
+		auto const file = MappedFile::open(paths[i]);
+
+		if (file == nullptr)
+		{
+			std::map<std::string, ShaderResult> results;
+			addError(results[""], "Could not read file: " + paths[i]);
+
+			return results;
+		}
+
+		if (shaderNames.empty())
+		{
+			return compileProgram(*pool, *prepareProgram(file, cs), {}, cs, CancelToken());
 		}
 
+		return compileNamed(*pool, file, shaderNames, cs, CancelToken());
+	});
+
+}
+
+std::shared_ptr<const PreparedProgram> Compiler::prepareFile(const std::string& path)
+{
+	auto const file = MappedFile::open(path);
+
+	if (file == nullptr)
+	{
+		return nullptr;
 	}
 
-	if (shaderStmt == nullptr)
+	auto prog = prepareProgram(file, settings);
+
+	prog->path = path;
+
+	return prog;
+}
+
+ShaderResult Compiler::lowerCLLR(const std::vector<uint8_t>& cllr)
+{
+	ShaderResult result;
+
+	auto const codeAsm = cllr::Assembler::load(cllr, settings);
+
+	if (codeAsm == nullptr)
 	{
-		result.errors.push_back(((std::stringstream() << "Shader not found: " << shaderName).str()));
+		addError(result, "Could not load CLLR; It's either malformed, or from a different compiler version");
 		return result;
 	}
 
-	//Populate the built-in symbols table
-	auto root = makeStdLib(settings);
+	//The data could come from anywhere, so it's always fully validated before the backend trusts it
+	auto validSettings = settings;
 
-	auto table = new_sptr<SymbolTable>(root);
+	if (settings->vLvl < ValidationLevel::FULL)
+	{
+		auto full = new_sptr<CompilerSettings>(*settings);
+		full->vLvl = ValidationLevel::FULL;
+		validSettings = full;
+	}
 
-	auto symErr = ErrorHandler(CompileStage::SYMBOL_GENERATION, settings);
+	auto validator = cllr::Validator(validSettings);
+	uptr<Shader> shader;
 
-	//Declare headers
-	for (auto const& stmt : ast)
+	if (!validator.validate(*codeAsm))
 	{
-		stmt->declareHeader(table, symErr);
+		validator.errors->report(result.diagnostics);
+	}
+	else
+	{
+		try
+		{
+			shader = lowerStage(*codeAsm, settings, result.diagnostics, nullptr, settings->collectStats ? &result.stats : nullptr);
+		}
+		catch (std::exception const& e)
+		{
+			result.diagnostics.push_back(Diagnostic{ CompileStage::UNKNOWN, "Could not lower CLLR: " + std::string(e.what()) });
+		}
+
 	}
 
-	if (!symErr.empty())
+	//Loaded code has no debug tokens, so errors have no source to point into
+	formatDiagnostics(result.diagnostics, TextDoc(""), *settings, result.errors);
+
+	if (shader == nullptr)
 	{
-		symErr.printout(result.errors, *doc);
+		if (result.errors.empty())
+		{
+			addError(result, "Unsupported output target");
+		}
+
 		return result;
 	}
 
-	shaderStmt->compile(table, settings, result, *doc);
+	if (settings->emitCLLR)
+	{
+		shader->cllr = cllr;
+	}
+
+	result.shaders.push_back(std::move(shader));
 
 	return result;
 }
+
+std::vector<std::shared_ptr<const PreparedProgram>> Compiler::prepareProject(const std::vector<std::string>& paths)
+{
+	auto const progs = caliburn::prepareProject(paths, settings, *pool);
+
+	return std::vector<std::shared_ptr<const PreparedProgram>>(progs.begin(), progs.end());
+}
+
+std::vector<std::map<std::string, ShaderResult>> Compiler::compileProject(const std::vector<std::string>& paths, const std::vector<std::string>& shaderNames)
+{
+	auto const progs = caliburn::prepareProject(paths, settings, *pool);
+
+	return compileOnPool(*pool, progs.size(), [pool = pool.get(), progs, shaderNames, cs = settings](size_t i)
+	{
+		return compileProgram(*pool, *progs[i], shaderNames, cs, CancelToken());
+	});
+
+}
+
+std::vector<std::string> Compiler::compileModule(const std::string& src, const std::string& outPath)
+{
+	auto const prog = prepareProgram(src, settings);
+
+	std::vector<std::string> errors;
+	std::string bytes;
+
+	formatDiagnostics(prog->success() ? prog->headerErrors : prog->errors, *prog->doc, *settings, errors);
+
+	if (!errors.empty() || !writeModule(*prog, bytes, errors))
+	{
+		return errors;
+	}
+
+	if (!storeModuleFile(outPath, bytes))
+	{
+		errors.push_back("Could not write module file: " + outPath);
+	}
+
+	//The directory's timestamp can be too coarse to show a rewrite right after a compile
+	DiskCache::forgetModuleStamps();
+
+	return errors;
+}
+
+std::future<ShaderResult> Compiler::compileAsync(const std::string& src, const std::string& shaderName, CancelToken cancel)
+{
+	auto promise = new_sptr<std::promise<ShaderResult>>();
+	auto future = promise->get_future();
+
+	compileAsync(src, shaderName, [promise](ShaderResult result)
+	{
+		promise->set_value(std::move(result));
+	}, cancel);
+
+	return future;
+}
+
+void Compiler::compileAsync(const std::string& src, const std::string& shaderName, std::function<void(ShaderResult)> callback, CancelToken cancel)
+{
+	//Capture copies only; The compiler itself may be gone by the time this runs, though its pool finishes every task first
+	pool->submit([pool = pool.get(), src, shaderName, callback, cancel, cs = settings]()
+	{
+		ShaderResult result;
+
+		try
+		{
+			if (shaderName.length() == 0)
+			{
+				addError(result, "Passed shader name is empty!");
+			}
+			else
+			{
+				result = std::move(compileNamed(*pool, new_sptr<ViewSource>(src), { shaderName }, cs, cancel).at(shaderName));
+			}
+
+		}
+		catch (std::exception const& e)
+		{
+			addError(result, "Internal compiler error: " + std::string(e.what()));
+		}
+		catch (...)
+		{
+			addError(result, "Internal compiler error");
+		}
+
+		try
+		{
+			callback(std::move(result));
+		}
+		catch (...)
+		{
+			//The callback is the caller's code; Whatever it throws mustn't escape onto a worker thread
+		}
+
+	});
+
+}
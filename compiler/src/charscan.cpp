@@ -0,0 +1,263 @@
+
+#include "charscan.h"
+
+#include <cstdint>
+
+#include "basic.h"
+
+#if defined(CBRN_SCAN_AVX2)
+#include <immintrin.h>
+#elif defined(CBRN_SCAN_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace caliburn;
+
+/*
+Scalar versions of every char class. The vector versions below have to agree with these exactly, since they're used to
+finish off whatever's too short to fill a whole vector.
+*/
+
+static bool isWhitespace(uint8_t c)
+{
+	return c <= ' ';
+}
+
+static bool isIdentifier(uint8_t c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+}
+
+#if defined(CBRN_SCAN_AVX2) || defined(CBRN_SCAN_SSE2)
+
+static uint32_t lowestBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+#if defined(CBRN_SCAN_AVX2)
+
+using Vec = __m256i;
+static constexpr size_t VEC_WIDTH = 32;
+
+static Vec load(const char* p) { return _mm256_loadu_si256(RCAST<const __m256i*>(p)); }
+static Vec splat(char c) { return _mm256_set1_epi8(c); }
+static Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+static Vec orV(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+static Vec sub(Vec a, Vec b) { return _mm256_sub_epi8(a, b); }
+static Vec minU(Vec a, Vec b) { return _mm256_min_epu8(a, b); }
+static Vec negative(Vec a) { return _mm256_cmpgt_epi8(_mm256_setzero_si256(), a); }
+static uint32_t bits(Vec a) { return (uint32_t)_mm256_movemask_epi8(a); }
+
+#else
+
+using Vec = __m128i;
+static constexpr size_t VEC_WIDTH = 16;
+
+static Vec load(const char* p) { return _mm_loadu_si128(RCAST<const __m128i*>(p)); }
+static Vec splat(char c) { return _mm_set1_epi8(c); }
+static Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+static Vec orV(Vec a, Vec b) { return _mm_or_si128(a, b); }
+static Vec sub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+static Vec minU(Vec a, Vec b) { return _mm_min_epu8(a, b); }
+static Vec negative(Vec a) { return _mm_cmplt_epi8(a, _mm_setzero_si128()); }
+static uint32_t bits(Vec a) { return (uint32_t)_mm_movemask_epi8(a); }
+
+#endif
+
+//Only the low VEC_WIDTH bits of a mask are used
+static constexpr uint32_t FULL_MASK = (uint32_t)((1ull << VEC_WIDTH) - 1);
+
+/*
+Unsigned a <= max, per byte
+*/
+static Vec atMost(Vec a, Vec max)
+{
+	return eq(minU(a, max), a);
+}
+
+/*
+Unsigned lo <= a <= hi, per byte. Subtracting lo wraps anything below it around to the top, so one compare does both.
+*/
+static Vec inRange(Vec a, char lo, char hi)
+{
+	return atMost(sub(a, splat(lo)), splat((char)(hi - lo)));
+}
+
+static uint32_t whitespaceMask(Vec v)
+{
+	return bits(atMost(v, splat(' ')));
+}
+
+static uint32_t identifierMask(Vec v)
+{
+	//Setting 0x20 lowercases letters, and doesn't turn anything else into one
+	auto const letters = inRange(orV(v, splat(0x20)), 'a', 'z');
+	auto const digits = inRange(v, '0', '9');
+
+	return bits(orV(orV(letters, digits), orV(eq(v, splat('_')), negative(v))));
+}
+
+/*
+Offset of the first byte for which the mask is unset, finishing off the tail with the scalar class.
+*/
+template<typename VecFn, typename ScalarFn>
+static size_t scanWhile(const char* text, size_t len, VecFn vecMask, ScalarFn scalar)
+{
+	size_t i = 0;
+
+	for (; i + VEC_WIDTH <= len; i += VEC_WIDTH)
+	{
+		auto const misses = ~vecMask(load(text + i)) & FULL_MASK;
+
+		if (misses != 0)
+		{
+			return i + lowestBit(misses);
+		}
+
+	}
+
+	while (i < len && scalar((uint8_t)text[i]))
+	{
+		++i;
+	}
+
+	return i;
+}
+
+/*
+Offset of the first byte for which the mask is set, finishing off the tail with the scalar class.
+*/
+template<typename VecFn, typename ScalarFn>
+static size_t scanUntil(const char* text, size_t len, VecFn vecMask, ScalarFn scalar)
+{
+	size_t i = 0;
+
+	for (; i + VEC_WIDTH <= len; i += VEC_WIDTH)
+	{
+		auto const hits = vecMask(load(text + i));
+
+		if (hits != 0)
+		{
+			return i + lowestBit(hits);
+		}
+
+	}
+
+	while (i < len && !scalar((uint8_t)text[i]))
+	{
+		++i;
+	}
+
+	return i;
+}
+
+const char* caliburn::charScanImpl()
+{
+#if defined(CBRN_SCAN_AVX2)
+	return "AVX2";
+#else
+	return "SSE2";
+#endif
+}
+
+size_t caliburn::scanWhitespace(const char* text, size_t len)
+{
+	return scanWhile(text, len, whitespaceMask, isWhitespace);
+}
+
+size_t caliburn::scanIdentifier(const char* text, size_t len)
+{
+	return scanWhile(text, len, identifierMask, isIdentifier);
+}
+
+size_t caliburn::findLineEnd(const char* text, size_t len)
+{
+	auto const nl = splat('\n');
+
+	return scanUntil(text, len, [nl](Vec v) { return bits(eq(v, nl)); }, [](uint8_t c) { return c == '\n'; });
+}
+
+size_t caliburn::findStringStop(const char* text, size_t len, char delim)
+{
+	auto const nl = splat('\n');
+	auto const esc = splat('\\');
+	auto const end = splat(delim);
+
+	return scanUntil(text, len, [nl, esc, end](Vec v)
+	{
+		return bits(orV(orV(eq(v, nl), eq(v, esc)), eq(v, end)));
+	},
+	[delim](uint8_t c)
+	{
+		return c == '\n' || c == '\\' || c == (uint8_t)delim;
+	});
+
+}
+
+#else
+
+const char* caliburn::charScanImpl()
+{
+	return "scalar";
+}
+
+size_t caliburn::scanWhitespace(const char* text, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len && isWhitespace((uint8_t)text[i]))
+	{
+		++i;
+	}
+
+	return i;
+}
+
+size_t caliburn::scanIdentifier(const char* text, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len && isIdentifier((uint8_t)text[i]))
+	{
+		++i;
+	}
+
+	return i;
+}
+
+size_t caliburn::findLineEnd(const char* text, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len && text[i] != '\n')
+	{
+		++i;
+	}
+
+	return i;
+}
+
+size_t caliburn::findStringStop(const char* text, size_t len, char delim)
+{
+	size_t i = 0;
+
+	while (i < len && text[i] != '\n' && text[i] != '\\' && text[i] != delim)
+	{
+		++i;
+	}
+
+	return i;
+}
+
+#endif
@@ -43,6 +43,39 @@ void Assembler::endSect(in<Instruction> i)
 
 }
 
+size_t Assembler::countGenericImpls() const
+{
+	size_t count = 0;
+
+	for (auto const& [_, impls] : typeImpls)
+	{
+		for (auto const& [gArgs, _] : impls)
+		{
+			if (gArgs != nullptr && !gArgs->empty())
+			{
+				++count;
+			}
+
+		}
+
+	}
+
+	for (auto const& [_, impls] : fnImpls)
+	{
+		for (auto const& [gArgs, _] : impls)
+		{
+			if (gArgs != nullptr && !gArgs->empty())
+			{
+				++count;
+			}
+
+		}
+
+	}
+
+	return count;
+}
+
 SSA Assembler::createSSA(in<Instruction> ins)
 {
 	auto const nxt = nextSSA;
@@ -151,24 +184,7 @@ sptr<LowType> Assembler::pushType(out<Instruction> ins)
 	allCode.push_back(ins);
 	doBookkeeping(ins);
 
-	sptr<LowType> t = nullptr;
-
-	switch (ins.op)
-	{
-		case Opcode::TYPE_VOID: t = new_sptr<LowVoid>(id); break;
-		case Opcode::TYPE_FLOAT: t = new_sptr<LowFloat>(id, ins.operands[0]); break;
-		case Opcode::TYPE_INT_SIGN: PASS;
-		case Opcode::TYPE_INT_UNSIGN: t = new_sptr<LowInt>(id, ins.op, ins.operands[0]); break;
-		case Opcode::TYPE_ARRAY: t = new_sptr<LowArray>(id, ins.operands[0], getType(ins.refs[0])); break;
-		case Opcode::TYPE_VECTOR: t = new_sptr<LowVector>(id, ins.operands[0], getType(ins.refs[0])); break;
-		case Opcode::TYPE_MATRIX: t = new_sptr<LowMatrix>(id, ins.operands[0], ins.operands[1], getType(ins.refs[0])); break;
-		case Opcode::TYPE_STRUCT: t = new_sptr<LowStruct>(id); break;
-		case Opcode::TYPE_BOOL: t = new_sptr<LowBool>(id); break;
-		case Opcode::TYPE_TEXTURE: t = new_sptr<LowTexture>(id, SCAST<TextureKind>(ins.operands[0])); break;
-		//case Opcode::TYPE_PTR: t = new_sptr<LowPointer>(id);
-		//case Opcode::TYPE_TUPLE: t = new_sptr<LowTuple>(id);
-		default: break;//TODO complain
-	}
+	auto const t = makeType(ins);
 
 	types.emplace(ins, t);
 	ssaToType.emplace(id, t);
@@ -178,6 +194,13 @@ sptr<LowType> Assembler::pushType(out<Instruction> ins)
 
 TypedSSA Assembler::pushIOVar(std::string_view name, ShaderIOVarType type, sptr<LowType> dataType)
 {
+	//A variable is either an input or an output within a stage, never both
+	if (auto it = ioVars.find(name); it != ioVars.end() && it->second.type != type)
+	{
+		errors->err(std::vector<std::string>{ "Shader I/O variable", std::string(name), "is used as both an input and an output" });
+		return TypedSSA();
+	}
+
 	if (auto it = ioVarIDs.find(name); it != ioVarIDs.end())
 	{
 		return it->second;
@@ -185,35 +208,34 @@ TypedSSA Assembler::pushIOVar(std::string_view name, ShaderIOVarType type, sptr<
 
 	uint32_t index = 0;
 
-	if (auto it = ioVars.find(name); it != ioVars.end())
-	{
-		auto const& var = it->second;
-
-		if (var.type != type)
-		{
-			//TODO complain
-			return TypedSSA();
-		}
-
-		index = var.index;
+	//The layout only covers what's passed between stages; Vertex inputs and fragment outputs are numbered on their own
+	bool const isVarying = (type == ShaderIOVarType::INPUT) ? (this->type != ShaderType::VERTEX) : (this->type != ShaderType::FRAGMENT);
 
+	if (auto it = ioLayout.find(name); isVarying && it != ioLayout.end())
+	{
+		index = it->second;
 	}
 	else
 	{
 		uint32_t& nextIdx = (type == ShaderIOVarType::INPUT) ? nextInput : nextOutput;
 
 		index = nextIdx;
-		ioVars.emplace(name, IOVar{ name, type, index });
-
 		++nextIdx;
 	}
 
+	ioVars.emplace(name, IOVar{ name, type, index });
+
 	auto res = TypedSSA(dataType, pushNew(Instruction((type == ShaderIOVarType::INPUT) ? Opcode::VAR_SHADER_IN : Opcode::VAR_SHADER_OUT, { index }, { dataType->id })));
 	ioVarIDs.emplace(name, res);
 
 	return res;
 }
 
+uint32_t Assembler::reserveOutput()
+{
+	return nextOutput++;
+}
+
 void Assembler::beginLoop(SSA start, SSA end)
 {
 	if (!hasSect())
@@ -366,6 +388,29 @@ uint32_t Assembler::flatten()
 	return replaced;
 }
 
+sptr<LowType> Assembler::makeType(in<Instruction> ins)
+{
+	auto const id = ins.index;
+
+	switch (ins.op)
+	{
+		case Opcode::TYPE_VOID: return new_sptr<LowVoid>(id);
+		case Opcode::TYPE_FLOAT: return new_sptr<LowFloat>(id, ins.operands[0]);
+		case Opcode::TYPE_INT_SIGN: PASS;
+		case Opcode::TYPE_INT_UNSIGN: return new_sptr<LowInt>(id, ins.op, ins.operands[0]);
+		case Opcode::TYPE_ARRAY: return new_sptr<LowArray>(id, ins.operands[0], getType(ins.refs[0]));
+		case Opcode::TYPE_VECTOR: return new_sptr<LowVector>(id, ins.operands[0], getType(ins.refs[0]));
+		case Opcode::TYPE_MATRIX: return new_sptr<LowMatrix>(id, ins.operands[0], ins.operands[1], getType(ins.refs[0]));
+		case Opcode::TYPE_STRUCT: return new_sptr<LowStruct>(id);
+		case Opcode::TYPE_BOOL: return new_sptr<LowBool>(id);
+		case Opcode::TYPE_TEXTURE: return new_sptr<LowTexture>(id, SCAST<TextureKind>(ins.operands[0]));
+		//case Opcode::TYPE_PTR: return new_sptr<LowPointer>(id);
+		//case Opcode::TYPE_TUPLE: return new_sptr<LowTuple>(id);
+		default: return nullptr;//TODO complain
+	}
+
+}
+
 void Assembler::doBookkeeping(in<Instruction> ins)
 {
 	for (auto const& refID : ins.refs)
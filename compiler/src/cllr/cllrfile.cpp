@@ -0,0 +1,452 @@
+
+#include <algorithm>
+
+#include "cllr/cllrasm.h"
+#include "cllr/cllrtypes.h"
+
+using namespace caliburn::cllr;
+
+/*
+Binary CLLR layout. Numbers marked "var" are unsigned LEB128 varints; Most operands and SSAs are small, so this is
+roughly a quarter of the size of the in-memory instructions.
+
+	u32		magic ("CLLR")
+	u32		format version
+	var		opcode count; Guards against the opcode list changing without the version being bumped
+	var		shader type
+	var		SSA count
+
+	var		string count
+	(var length, bytes)...
+
+	var		I/O variable count
+	(var name length, name bytes, u8 I/O type, var location, var SSA, var data type SSA)...
+
+	var		instruction count
+	(var opcode, u8 mask, var index, var output type, var operand/ref...)...
+
+	u32		magic again, so truncated data is caught
+
+Each instruction's mask has a bit for every operand (the low 4 bits) and ref (the high 4 bits) which isn't 0; Only
+those are written, in order.
+*/
+
+//"CLLR" in little-endian
+static constexpr uint32_t CLLR_MAGIC = 0x524C4C43;
+//Bump whenever the layout above, or the meaning of any opcode or operand, changes
+static constexpr uint32_t CLLR_FORMAT = 2;
+
+static_assert(MAX_OPS + MAX_REFS <= 8, "Instruction masks only have 8 bits");
+
+//Operands which index into the string table, as (opcode, operand)
+static const std::pair<Opcode, size_t> STRING_OPERANDS[] = {
+	{ Opcode::SHADER_STAGE, 1 },
+	{ Opcode::VALUE_LIT_STR, 0 }
+};
+
+static void writeU32(out<std::vector<uint8_t>> bytes, uint32_t v)
+{
+	bytes.push_back((uint8_t)v);
+	bytes.push_back((uint8_t)(v >> 8));
+	bytes.push_back((uint8_t)(v >> 16));
+	bytes.push_back((uint8_t)(v >> 24));
+}
+
+static void writeVar(out<std::vector<uint8_t>> bytes, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		bytes.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+
+	bytes.push_back((uint8_t)v);
+}
+
+static void writeStr(out<std::vector<uint8_t>> bytes, std::string_view str)
+{
+	writeVar(bytes, str.size());
+	bytes.insert(bytes.end(), str.begin(), str.end());
+}
+
+/*
+Reads from a byte span. Every read past the end fails, and keeps failing, so callers can check once after reading a
+whole record.
+*/
+struct CLLRReader
+{
+	const std::vector<uint8_t>& bytes;
+	size_t off = 0;
+	bool failed = false;
+
+	CLLRReader(in<std::vector<uint8_t>> b) : bytes(b) {}
+
+	uint8_t u8()
+	{
+		if (off >= bytes.size())
+		{
+			failed = true;
+			return 0;
+		}
+
+		return bytes[off++];
+	}
+
+	uint32_t u32()
+	{
+		uint32_t v = 0;
+
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+		{
+			v |= (uint32_t)u8() << shift;
+		}
+
+		return v;
+	}
+
+	uint32_t var()
+	{
+		uint64_t v = 0;
+
+		for (uint32_t shift = 0; shift < 64; shift += 7)
+		{
+			auto const b = u8();
+
+			v |= (uint64_t)(b & 0x7F) << shift;
+
+			if ((b & 0x80) == 0)
+			{
+				break;
+			}
+
+		}
+
+		//Everything in the format fits in 32 bits
+		if (v > UINT32_MAX)
+		{
+			failed = true;
+			return 0;
+		}
+
+		return (uint32_t)v;
+	}
+
+	std::string str()
+	{
+		auto const len = var();
+
+		if (failed || len > bytes.size() - off)
+		{
+			failed = true;
+			return "";
+		}
+
+		auto const start = RCAST<const char*>(bytes.data() + off);
+		off += len;
+
+		return std::string(start, len);
+	}
+
+};
+
+void Assembler::save(out<std::vector<uint8_t>> bytes) const
+{
+	bytes.clear();
+
+	writeU32(bytes, CLLR_MAGIC);
+	writeU32(bytes, CLLR_FORMAT);
+	writeVar(bytes, (uint64_t)Opcode::CLLR_OP_COUNT);
+	writeVar(bytes, (uint64_t)type);
+
+	//Flattening can leave SSAs above the count behind, so go by what the code actually uses
+	SSA ssaCount = getSSACount();
+
+	for (auto const& ins : allCode)
+	{
+		ssaCount = std::max({ ssaCount, ins.index, ins.outType, *std::max_element(ins.refs.begin(), ins.refs.end()) });
+	}
+
+	writeVar(bytes, ssaCount);
+
+	writeVar(bytes, strs.size());
+
+	for (auto const& str : strs)
+	{
+		writeStr(bytes, str);
+	}
+
+	writeVar(bytes, ioVars.size());
+
+	for (auto const& [name, io] : ioVars)
+	{
+		auto const& id = ioVarIDs.at(name);
+
+		writeStr(bytes, name);
+		bytes.push_back((uint8_t)io.type);
+		writeVar(bytes, io.index);
+		writeVar(bytes, id.value);
+		writeVar(bytes, id.type == nullptr ? 0 : id.type->id);
+
+	}
+
+	writeVar(bytes, allCode.size());
+
+	for (auto const& ins : allCode)
+	{
+		uint8_t mask = 0;
+
+		for (size_t i = 0; i < MAX_OPS; ++i)
+		{
+			if (ins.operands[i] != 0)
+			{
+				mask |= (1 << i);
+			}
+
+		}
+
+		for (size_t i = 0; i < MAX_REFS; ++i)
+		{
+			if (ins.refs[i] != 0)
+			{
+				mask |= (1 << (MAX_OPS + i));
+			}
+
+		}
+
+		writeVar(bytes, (uint64_t)ins.op);
+		bytes.push_back(mask);
+		writeVar(bytes, ins.index);
+		writeVar(bytes, ins.outType);
+
+		for (size_t i = 0; i < MAX_OPS; ++i)
+		{
+			if (ins.operands[i] != 0)
+			{
+				writeVar(bytes, ins.operands[i]);
+			}
+
+		}
+
+		for (size_t i = 0; i < MAX_REFS; ++i)
+		{
+			if (ins.refs[i] != 0)
+			{
+				writeVar(bytes, ins.refs[i]);
+			}
+
+		}
+
+	}
+
+	writeU32(bytes, CLLR_MAGIC);
+
+}
+
+uptr<Assembler> Assembler::load(in<std::vector<uint8_t>> bytes, sptr<const CompilerSettings> cs)
+{
+	auto r = CLLRReader(bytes);
+
+	if (r.u32() != CLLR_MAGIC || r.u32() != CLLR_FORMAT || r.var() != (uint32_t)Opcode::CLLR_OP_COUNT)
+	{
+		return nullptr;
+	}
+
+	auto const shaderType = r.var();
+
+	if (r.failed || shaderType > (uint32_t)ShaderType::MESH)
+	{
+		return nullptr;
+	}
+
+	auto codeAsm = new_uptr<Assembler>((ShaderType)shaderType, cs);
+
+	auto const ssaCount = r.var();
+
+	//Every SSA is declared by at least one byte of instruction, so anything bigger than the data is bogus
+	if (r.failed || ssaCount > bytes.size())
+	{
+		return nullptr;
+	}
+
+	codeAsm->nextSSA = ssaCount + 1;
+	codeAsm->ssaRefs.resize(ssaCount + 1);
+
+	auto const strCount = r.var();
+
+	for (uint32_t i = 0; i < strCount && !r.failed; ++i)
+	{
+		codeAsm->strs.push_back(r.str());
+	}
+
+	struct LoadedIO
+	{
+		std::string_view name;
+		ShaderIOVarType type;
+		uint32_t index;
+		SSA value;
+		SSA dataType;
+	};
+
+	std::vector<LoadedIO> io;
+
+	auto const ioCount = r.var();
+
+	for (uint32_t i = 0; i < ioCount && !r.failed; ++i)
+	{
+		auto const& name = codeAsm->ioNames.emplace_back(r.str());
+		auto const ioType = r.u8();
+		auto const index = r.var();
+		auto const value = r.var();
+		auto const dataType = r.var();
+
+		if (ioType > (uint8_t)ShaderIOVarType::OUTPUT || value > ssaCount || dataType > ssaCount)
+		{
+			return nullptr;
+		}
+
+		io.push_back(LoadedIO{ name, (ShaderIOVarType)ioType, index, value, dataType });
+
+	}
+
+	auto const insCount = r.var();
+
+	if (r.failed || insCount > bytes.size())
+	{
+		return nullptr;
+	}
+
+	codeAsm->allCode.reserve(insCount);
+
+	for (uint32_t n = 0; n < insCount; ++n)
+	{
+		Instruction ins;
+
+		auto const op = r.var();
+		auto const mask = r.u8();
+
+		ins.index = r.var();
+		ins.outType = r.var();
+
+		for (size_t i = 0; i < MAX_OPS; ++i)
+		{
+			if (mask & (1 << i))
+			{
+				ins.operands[i] = r.var();
+			}
+
+		}
+
+		for (size_t i = 0; i < MAX_REFS; ++i)
+		{
+			if (mask & (1 << (MAX_OPS + i)))
+			{
+				ins.refs[i] = r.var();
+			}
+
+		}
+
+		if (r.failed || op >= (uint32_t)Opcode::CLLR_OP_COUNT || ins.index > ssaCount || ins.outType > ssaCount)
+		{
+			return nullptr;
+		}
+
+		for (auto const ref : ins.refs)
+		{
+			if (ref > ssaCount)
+			{
+				return nullptr;
+			}
+
+		}
+
+		ins.op = (Opcode)op;
+
+		//Strings are looked up by index, so one past the end would read out of bounds
+		for (auto const& [strOp, strIdx] : STRING_OPERANDS)
+		{
+			if (ins.op == strOp && ins.operands[strIdx] >= codeAsm->strs.size())
+			{
+				return nullptr;
+			}
+
+		}
+
+		codeAsm->allCode.push_back(ins);
+		codeAsm->doBookkeeping(ins);
+
+		//Every SSA is declared once
+		if (ins.index != 0 && !codeAsm->ssaToIns.emplace(ins.index, ins).second)
+		{
+			return nullptr;
+		}
+
+		//Types come before anything using them, same as when they were first pushed
+		if (ins.index != 0 && isType(ins.op))
+		{
+			//Types built from other types, like vectors, need those to exist already
+			for (auto const ref : ins.refs)
+			{
+				if (ref != 0 && codeAsm->getType(ref) == nullptr)
+				{
+					return nullptr;
+				}
+
+			}
+
+			auto const t = codeAsm->makeType(ins);
+
+			if (t == nullptr)
+			{
+				return nullptr;
+			}
+
+			codeAsm->types.emplace(ins, t);
+			codeAsm->ssaToType.emplace(ins.index, t);
+
+		}
+
+	}
+
+	if (r.u32() != CLLR_MAGIC || r.failed || r.off != bytes.size())
+	{
+		return nullptr;
+	}
+
+	//Refs can point forward, e.g. to the end of a loop, so they're only checked once every SSA is declared
+	for (auto const& ins : codeAsm->allCode)
+	{
+		if (ins.outType != 0 && codeAsm->getType(ins.outType) == nullptr)
+		{
+			return nullptr;
+		}
+
+		for (auto const ref : ins.refs)
+		{
+			if (ref != 0 && codeAsm->ssaToIns.find(ref) == codeAsm->ssaToIns.end())
+			{
+				return nullptr;
+			}
+
+		}
+
+	}
+
+	for (auto const& var : io)
+	{
+		auto const dataType = codeAsm->getType(var.dataType);
+
+		if (dataType == nullptr || var.value == 0 || codeAsm->ssaToIns.find(var.value) == codeAsm->ssaToIns.end())
+		{
+			return nullptr;
+		}
+
+		codeAsm->ioVars.emplace(var.name, IOVar{ var.name, var.type, var.index });
+		codeAsm->ioVarIDs.emplace(var.name, TypedSSA(dataType, var.value));
+
+		auto& next = (var.type == ShaderIOVarType::INPUT) ? codeAsm->nextInput : codeAsm->nextOutput;
+		next = std::max(next, var.index + 1);
+
+	}
+
+	return codeAsm;
+}
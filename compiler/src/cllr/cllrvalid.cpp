@@ -220,7 +220,7 @@ CLLR_VALID_IMPL(OpShaderStage)
 {
 	CLLR_VALID_HAS_ID;
 	CLLR_VALID_NO_OUT;
-	CLLR_VALID_MAX_OPS(1);
+	CLLR_VALID_MAX_OPS(3);
 	CLLR_VALID_MAX_REFS(1);
 
 	CLLR_VALID_TYPE(i.refs[0]);
@@ -659,7 +659,14 @@ CLLR_VALID_IMPL(OpAssign)
 	CLLR_VALID_NO_OPS;
 	CLLR_VALID_MAX_REFS(2);
 
-	CLLR_VALID_LVALUE(i.refs[0]);
+	//Shader outputs, locals, and globals are written to directly; Inputs, descriptors and arguments are read-only
+	auto const dest = codeAsm.getOp(i.refs[0]);
+
+	if (dest != Opcode::VAR_SHADER_OUT && dest != Opcode::VAR_LOCAL && dest != Opcode::VAR_GLOBAL)
+	{
+		CLLR_VALID_LVALUE(i.refs[0]);
+	}
+
 	CLLR_VALID_VALUE(i.refs[1]);
 
 	//no self-assignment
@@ -0,0 +1,506 @@
+
+#include "diskcache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "modfile.h"
+
+using namespace caliburn;
+
+namespace fs = std::filesystem;
+
+//"CBRC" in little-endian
+static constexpr uint32_t CACHE_MAGIC = 0x43524243;
+//Bump whenever the entry layout below changes
+static constexpr uint32_t CACHE_FORMAT = 2;
+
+static void writeU32(out<std::ostream> os, uint32_t v)
+{
+	char bytes[4] = { (char)v, (char)(v >> 8), (char)(v >> 16), (char)(v >> 24) };
+	os.write(bytes, 4);
+}
+
+static void writeStr(out<std::ostream> os, in<std::string> str)
+{
+	writeU32(os, (uint32_t)str.size());
+	os.write(str.data(), str.size());
+}
+
+static bool readU32(out<std::istream> is, out<uint32_t> v)
+{
+	uint8_t bytes[4];
+
+	if (!is.read(RCAST<char*>(bytes), 4))
+	{
+		return false;
+	}
+
+	v = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	return true;
+}
+
+/*
+Checks that there's at least len bytes left in a file of the given size, so that a bad length can't make a huge
+allocation before the read fails.
+*/
+static bool hasRem(out<std::istream> is, uint64_t fileSize, uint64_t len)
+{
+	auto const pos = is.tellg();
+
+	return pos >= 0 && fileSize - (uint64_t)pos >= len;
+}
+
+static bool readStr(out<std::istream> is, uint64_t fileSize, out<std::string> str)
+{
+	uint32_t len = 0;
+
+	if (!readU32(is, len) || !hasRem(is, fileSize, len))
+	{
+		return false;
+	}
+
+	str.resize(len);
+
+	return len == 0 || (bool)is.read(str.data(), len);
+}
+
+/*
+Lists the names of every module file in a directory, sorted, since directory order isn't guaranteed.
+*/
+static std::vector<std::string> listModules(in<std::string> moduleDir)
+{
+	std::vector<std::string> names;
+	std::error_code ec;
+
+	for (auto const& entry : fs::directory_iterator(moduleDir, ec))
+	{
+		if (entry.path().extension() == MODULE_FILE_EXT)
+		{
+			names.push_back(entry.path().filename().string());
+		}
+
+	}
+
+	std::sort(names.begin(), names.end());
+
+	return names;
+}
+
+/*
+Hashes the name, size, and modification time of every listed module file.
+*/
+static Digest stampModules(in<std::string> moduleDir, in<std::vector<std::string>> names)
+{
+	SHA256 hash;
+
+	for (auto const& name : names)
+	{
+		std::error_code ec;
+		auto const path = fs::path(moduleDir) / name;
+
+		//Files which vanished since the listing hash as 0s, which still differs from what they were
+		auto const size = (uint64_t)fs::file_size(path, ec);
+		auto const modified = (uint64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+
+		hash.updateField(name);
+		hash.updateU32((uint32_t)size);
+		hash.updateU32((uint32_t)(size >> 32));
+		hash.updateU32((uint32_t)modified);
+		hash.updateU32((uint32_t)(modified >> 32));
+
+	}
+
+	return hash.finish();
+}
+
+/*
+Coarsest timestamp granularity of any common file system (FAT's); A directory listed within this long of its last
+change might change again without its time moving.
+*/
+static constexpr auto DIR_TIME_TICK = std::chrono::seconds(2);
+
+struct ModuleListing
+{
+	fs::file_time_type dirModified;
+	fs::file_time_type listed;
+	std::vector<std::string> names;
+};
+
+static std::mutex stampLock;
+static std::map<std::string, ModuleListing> listings;
+
+Digest DiskCache::moduleStamp(in<std::string> moduleDir)
+{
+	//Adding or removing a module touches the directory, so its listing is kept until that happens; Rewriting one in
+	//place doesn't, so every listed file is stamped on every call, which is only a stat each
+	std::error_code ec;
+	auto const dirModified = fs::last_write_time(moduleDir, ec);
+
+	if (ec)
+	{
+		return Digest{};
+	}
+
+	std::vector<std::string> names;
+	bool listed = false;
+
+	{
+		std::lock_guard<std::mutex> guard(stampLock);
+
+		auto const found = listings.find(moduleDir);
+
+		if (found != listings.end() && found->second.dirModified == dirModified && found->second.listed - dirModified >= DIR_TIME_TICK)
+		{
+			names = found->second.names;
+			listed = true;
+		}
+
+	}
+
+	if (!listed)
+	{
+		auto const now = fs::file_time_type::clock::now();
+
+		names = listModules(moduleDir);
+
+		std::lock_guard<std::mutex> guard(stampLock);
+
+		listings[moduleDir] = ModuleListing{ dirModified, now, names };
+
+	}
+
+	return stampModules(moduleDir, names);
+}
+
+void DiskCache::forgetModuleStamps()
+{
+	std::lock_guard<std::mutex> guard(stampLock);
+
+	listings.clear();
+
+}
+
+Digest DiskCache::makeSourceKey(std::string_view src, in<CompilerSettings> settings, std::string_view importKey)
+{
+	SHA256 hash;
+
+	hash.updateField(COMPILER_VERSION);
+	hash.updateU32(CACHE_FORMAT);
+
+	//Only settings which change the output go in; errorContextLines only affects errors, which aren't cached
+	hash.updateU32((uint32_t)settings.gpuTarget);
+	hash.updateU32((uint32_t)settings.o);
+	hash.updateU32((uint32_t)settings.vLvl);
+	hash.updateU32((uint32_t)settings.emitCLLR);
+
+	hash.updateU32((uint32_t)settings.dynTypes.size());
+
+	for (auto const& [inner, concrete] : settings.dynTypes)
+	{
+		hash.updateField(inner);
+		hash.updateField(concrete);
+	}
+
+	//Imported modules change the output without changing the source, so the module files are stamped in too
+	hash.updateField(settings.moduleDir);
+
+	if (!settings.moduleDir.empty())
+	{
+		auto const stamp = moduleStamp(settings.moduleDir);
+		hash.update(stamp.data(), stamp.size());
+	}
+
+	hash.updateField(src);
+
+	//Left out entirely for standalone sources, so their keys don't change
+	if (!importKey.empty())
+	{
+		hash.updateField(importKey);
+	}
+
+	return hash.finish();
+}
+
+Digest DiskCache::makeKey(in<Digest> srcKey, std::string_view shaderName)
+{
+	SHA256 hash;
+
+	hash.update(srcKey.data(), srcKey.size());
+	hash.updateField(shaderName);
+
+	return hash.finish();
+}
+
+std::string DiskCache::entryPath(in<Digest> key) const
+{
+	auto const hex = SHA256::toHex(key);
+
+	//Shard by the first byte, so no one directory gets too large
+	return (fs::path(dir) / hex.substr(0, 2) / hex).string();
+}
+
+/*
+Reads a whole entry. Every length is checked against what's left of the file before anything is allocated for it.
+*/
+static bool readEntry(in<fs::path> path, out<ShaderResult> result)
+{
+	std::error_code ec;
+	auto const fileSize = (uint64_t)fs::file_size(path, ec);
+
+	if (ec)
+	{
+		return false;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	uint32_t magic = 0, format = 0, shaderCount = 0;
+
+	if (!readU32(file, magic) || !readU32(file, format) || magic != CACHE_MAGIC || format != CACHE_FORMAT)
+	{
+		return false;
+	}
+
+	if (!readU32(file, shaderCount))
+	{
+		return false;
+	}
+
+	ShaderResult loaded;
+
+	for (uint32_t s = 0; s < shaderCount; ++s)
+	{
+		uint32_t type = 0, codeLen = 0;
+
+		if (!readU32(file, type) || !readU32(file, codeLen) || type > (uint32_t)ShaderType::MESH)
+		{
+			return false;
+		}
+
+		if (!hasRem(file, fileSize, (uint64_t)codeLen * sizeof(uint32_t)))
+		{
+			return false;
+		}
+
+		std::vector<uint32_t> code(codeLen);
+
+		for (auto& word : code)
+		{
+			if (!readU32(file, word))
+			{
+				return false;
+			}
+
+		}
+
+		auto shader = new_uptr<Shader>((ShaderType)type, std::move(code));
+
+		uint32_t inputCount = 0;
+
+		if (!readU32(file, inputCount))
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < inputCount; ++i)
+		{
+			VertexInputAttribute attrib;
+
+			if (!readStr(file, fileSize, attrib.name) || !readU32(file, attrib.location) || !readU32(file, attrib.format))
+			{
+				return false;
+			}
+
+			shader->inputs.push_back(attrib);
+
+		}
+
+		uint32_t setCount = 0;
+
+		if (!readU32(file, setCount))
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < setCount; ++i)
+		{
+			DescriptorSet set;
+
+			if (!readStr(file, fileSize, set.name) || !readU32(file, set.binding) || !readU32(file, set.type))
+			{
+				return false;
+			}
+
+			shader->sets.push_back(set);
+
+		}
+
+		uint32_t cllrLen = 0;
+
+		if (!readU32(file, cllrLen) || !hasRem(file, fileSize, cllrLen))
+		{
+			return false;
+		}
+
+		shader->cllr.resize(cllrLen);
+
+		if (cllrLen > 0 && !file.read(RCAST<char*>(shader->cllr.data()), cllrLen))
+		{
+			return false;
+		}
+
+		loaded.shaders.push_back(std::move(shader));
+
+	}
+
+	//A truncated entry would have failed above; One with trailing data is just as suspect
+	uint32_t end = 0;
+
+	if (!readU32(file, end) || end != CACHE_MAGIC || (uint64_t)file.tellg() != fileSize)
+	{
+		return false;
+	}
+
+	result.shaders = std::move(loaded.shaders);
+
+	return true;
+}
+
+bool DiskCache::load(in<Digest> key, out<ShaderResult> result) const
+{
+	auto const path = fs::path(entryPath(key));
+
+	std::error_code ec;
+
+	if (!fs::exists(path, ec))
+	{
+		return false;
+	}
+
+	bool loaded = false;
+
+	try
+	{
+		loaded = readEntry(path, result);
+	}
+	catch (...)
+	{
+		loaded = false;
+	}
+
+	//Entries are renamed into place whole, so one that can't be read is corrupt; It'd only ever miss again
+	if (!loaded)
+	{
+		fs::remove(path, ec);
+	}
+
+	return loaded;
+}
+
+void DiskCache::store(in<Digest> key, in<ShaderResult> result) const
+{
+	//Errors are only formatted once every shader is compiled, so a failure might only show in its diagnostics so far
+	if (!result.success() || !result.diagnostics.empty() || result.cancelled)
+	{
+		return;
+	}
+
+	auto const path = fs::path(entryPath(key));
+
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+
+	if (ec)
+	{
+		return;
+	}
+
+	//Unique per process and thread, so concurrent writers never share a temporary file
+	std::stringstream tmpName;
+	tmpName << path.filename().string() << ".tmp."
+		<< std::random_device()() << '.'
+		<< std::hash<std::thread::id>()(std::this_thread::get_id()) << '.'
+		<< std::chrono::steady_clock::now().time_since_epoch().count();
+
+	auto const tmpPath = path.parent_path() / tmpName.str();
+
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			return;
+		}
+
+		writeU32(file, CACHE_MAGIC);
+		writeU32(file, CACHE_FORMAT);
+		writeU32(file, (uint32_t)result.shaders.size());
+
+		for (auto const& shader : result.shaders)
+		{
+			writeU32(file, (uint32_t)shader->type);
+			writeU32(file, (uint32_t)shader->code.size());
+
+			for (auto const word : shader->code)
+			{
+				writeU32(file, word);
+			}
+
+			writeU32(file, (uint32_t)shader->inputs.size());
+
+			for (auto const& attrib : shader->inputs)
+			{
+				writeStr(file, attrib.name);
+				writeU32(file, attrib.location);
+				writeU32(file, attrib.format);
+			}
+
+			writeU32(file, (uint32_t)shader->sets.size());
+
+			for (auto const& set : shader->sets)
+			{
+				writeStr(file, set.name);
+				writeU32(file, set.binding);
+				writeU32(file, set.type);
+			}
+
+			writeU32(file, (uint32_t)shader->cllr.size());
+			file.write(RCAST<const char*>(shader->cllr.data()), shader->cllr.size());
+
+		}
+
+		writeU32(file, CACHE_MAGIC);
+
+		file.flush();
+
+		if (!file)
+		{
+			file.close();
+			fs::remove(tmpPath, ec);
+			return;
+		}
+
+	}
+
+	//Atomic on both POSIX and Windows; If another process got here first, its entry is identical anyway
+	fs::rename(tmpPath, path, ec);
+
+	if (ec)
+	{
+		fs::remove(tmpPath, ec);
+	}
+
+}
@@ -1,137 +1,224 @@
 
 #include "error.h"
 
+#include <algorithm>
+
 using namespace caliburn;
 
-std::string Error::print(in<TextDoc> doc, sptr<const CompilerSettings> settings) const
+Diagnostic Error::toDiagnostic(ptr<const TextDoc> doc) const
 {
-	const uint32_t errLineCount = settings->errorContextLines;
+	Diagnostic d;
+
+	d.stage = stage;
+	d.message = message;
+	d.notes = notes;
 
+	auto const posOf = LAMBDA(in<Token> tkn)
+	{
+		return doc ? doc->posOf(tkn.str, tkn.pos) : tkn.pos;
+	};
+
+	if (startTkn.exists())
+	{
+		auto const& last = endTkn.exists() ? endTkn : startTkn;
+		auto const startPos = posOf(startTkn);
+		auto const lastPos = posOf(last);
+
+		d.hasLocation = true;
+		d.startLine = startPos.line;
+		d.startColumn = startPos.column;
+		d.endLine = lastPos.line;
+		d.endColumn = lastPos.column + SCAST<uint32_t>(last.str.length());
+
+	}
+
+	if (contextStart.exists())
+	{
+		d.hasContext = true;
+		d.contextLine = posOf(contextStart).line;
+	}
+
+	return d;
+}
+
+std::string caliburn::formatDiagnostic(in<Diagnostic> d, in<TextDoc> doc, uint32_t contextLines)
+{
 	constexpr std::string_view ERR_TXT_START = "\033[41m";
 	constexpr std::string_view ERR_TXT_END = "\033[0m";
 
-	std::stringstream ss;
+	auto const lineCount = SCAST<uint32_t>(doc.lineCount());
 
-	ss << '[' << COMPILE_STAGES[SCAST<uint32_t>(stage)] << "] ";
-	
-	ss << "Error";
+	//Clamped, since the document might not be the one the diagnostic came from
+	auto const lineAt = LAMBDA(uint32_t line)
+	{
+		return doc.getLine(line);
+	};
 
-	if (startTkn.exists())
+	auto const cut = LAMBDA(std::string_view line, size_t from, size_t to = std::string_view::npos)
+	{
+		from = std::min(from, line.length());
+		return line.substr(from, to == std::string_view::npos ? to : to - std::min(from, to));
+	};
+
+	std::string out;
+
+	out.append("[").append(COMPILE_STAGES[SCAST<uint32_t>(d.stage)]).append("] Error");
+
+	if (d.hasLocation)
 	{
-		if (endTkn.pos.getLine() == startTkn.pos.getLine())
+		if (d.startLine == d.endLine)
 		{
-			ss << " on line " << startTkn.pos.getLine();
+			out.append(" on line ").append(std::to_string(d.startLine + 1));
 		}
 		else
 		{
-			ss << " on lines " << startTkn.pos.getLine() << '-' << endTkn.pos.getLine();
+			out.append(" on lines ").append(std::to_string(d.startLine + 1)).append("-").append(std::to_string(d.endLine + 1));
 		}
 
 	}
-	
-	ss << ": " << message << '\n';
 
-	if (contextStart.exists())
+	out.append(": ").append(d.message).append("\n");
+
+	if (d.hasContext)
 	{
-		auto const& cxtLine = doc.getLine(contextStart.pos);
+		auto const cxtLine = lineAt(d.contextLine);
 
-		ss << "Context: \n";
-		ss << contextStart.pos.getLine() << '\t' << cxtLine << '\n';
-		ss << std::string(cxtLine.length(), '-');
-		ss << '\n';
+		out.append("Context: \n");
+		out.append(std::to_string(d.contextLine + 1)).append("\t").append(cxtLine).append("\n");
+		out.append(cxtLine.length(), '-');
+		out.append("\n");
 	}
-	else
+	else if (d.hasLocation)
 	{
-		for (auto line = startTkn.pos.line - std::min(errLineCount, startTkn.pos.line); line < startTkn.pos.line; ++line)
+		for (auto line = d.startLine - std::min(contextLines, d.startLine); line < d.startLine && line < lineCount; ++line)
 		{
-			ss << (line + 1) << '\t' << doc.lines[line] << '\n';
+			out.append(std::to_string(line + 1)).append("\t").append(doc.getLine(line)).append("\n");
 		}
+
 	}
-	
-	if (startTkn.exists() && endTkn.exists())
+
+	if (d.hasLocation)
 	{
-		if (startTkn.pos.line == endTkn.pos.line)
+		auto const startLine = lineAt(d.startLine);
+		auto const endLine = lineAt(d.endLine);
+
+		out.append(ERR_TXT_START).append(std::to_string(d.startLine + 1)).append(ERR_TXT_END).append("\t");
+		out.append(cut(startLine, 0, d.startColumn));
+		out.append(ERR_TXT_START);
+
+		if (d.startLine == d.endLine)
 		{
-			auto const lineStr = doc.getLine(startTkn.pos);
-
-			ss << ERR_TXT_START;
-			ss << startTkn.pos.getLine();
-			ss << ERR_TXT_END;
-			ss << '\t';
-			ss << lineStr.substr(0, startTkn.pos.column);
-			ss << ERR_TXT_START;
-			ss << lineStr.substr(startTkn.pos.column, endTkn.pos.column + endTkn.str.length() - startTkn.pos.column);
-			ss << ERR_TXT_END;
-			ss << lineStr.substr(endTkn.pos.column + endTkn.str.length());
+			out.append(cut(startLine, d.startColumn, d.endColumn));
+			out.append(ERR_TXT_END);
+			out.append(cut(startLine, d.endColumn));
 
 		}
 		else
 		{
-			auto startLine = doc.getLine(startTkn.pos);
-			auto endLine = doc.getLine(endTkn.pos);
-
-			ss << ERR_TXT_START;
-			ss << startTkn.pos.getLine();
-			ss << ERR_TXT_END;
-			ss << '\t';
-			ss << startLine.substr(0, startTkn.pos.column);
-			ss << ERR_TXT_START;
-			ss << startTkn.str;
-			ss << '\n';
-			
-			for (uint32_t line = startTkn.pos.line + 1; line < endTkn.pos.line; ++line)
+			out.append(cut(startLine, d.startColumn));
+			out.append("\n");
+
+			for (auto line = d.startLine + 1; line < d.endLine && line < lineCount; ++line)
 			{
-				ss << (line + 1) << '\t' << doc.lines[line] << '\n';
+				out.append(std::to_string(line + 1)).append("\t").append(doc.getLine(line)).append("\n");
 			}
 
-			ss << endTkn.pos.getLine() << '\t' << endLine.substr(0, endTkn.pos.column + endTkn.str.length());
-			ss << ERR_TXT_END;
-			ss << endLine.substr(endTkn.pos.column + endTkn.str.length());
-			
+			out.append(std::to_string(d.endLine + 1)).append("\t").append(cut(endLine, 0, d.endColumn));
+			out.append(ERR_TXT_END);
+			out.append(cut(endLine, d.endColumn));
+
 		}
 
-		ss << '\n';
+		out.append("\n");
 
-		for (uint32_t i = 1; i <= errLineCount; ++i)
+		for (uint32_t i = 1; i <= contextLines; ++i)
 		{
-			auto line = endTkn.pos.line + i;
+			auto const line = d.endLine + i;
 
-			if (line >= doc.lines.size())
+			if (line >= lineCount)
 			{
 				break;
 			}
 
-			ss << (line + 1) << '\t' << doc.lines[line] << '\n';
+			out.append(std::to_string(line + 1)).append("\t").append(doc.getLine(line)).append("\n");
+
+		}
+
+	}
 
+	if (d.notes.size() == 1)
+	{
+		out.append("Note: ").append(d.notes.front());
+	}
+	else if (!d.notes.empty())
+	{
+		out.append("Notes:");
+
+		for (size_t i = 0; i < d.notes.size(); ++i)
+		{
+			out.append("\n\t").append(std::to_string(i + 1)).append(". ").append(d.notes[i]);
 		}
-		
+
 	}
 
-	if (!notes.empty())
+	return out;
+}
+
+void caliburn::formatDiagnostics(in<std::vector<Diagnostic>> diags, in<TextDoc> doc, in<CompilerSettings> settings, out<std::vector<std::string>> out)
+{
+	for (auto const& d : diags)
 	{
-		if (notes.size() == 1)
+		if (!settings.formatErrors)
 		{
-			ss << "Note: " << notes.front();
+			out.push_back(d.message);
+			continue;
 		}
-		else
+
+		//Errors without a location are already as formatted as they're going to get
+		if (!d.hasLocation && !d.hasContext && d.notes.empty() && d.stage == CompileStage::UNKNOWN)
 		{
-			ss << "Notes:";
+			out.push_back(d.message);
+			continue;
+		}
 
-			for (size_t i = 0; i < notes.size(); ++i)
-			{
-				ss << "\n\t" << (i + 1) << ". " << notes.at(i);
+		out.push_back(formatDiagnostic(d, doc, settings.errorContextLines));
 
-			}
+	}
 
-		}
+}
+
+std::string Diagnostic::format(const std::string& src, uint32_t contextLines) const
+{
+	return formatDiagnostic(*this, TextDoc(src), contextLines);
+}
+
+void ErrorHandler::report(out<std::vector<Diagnostic>> out, ptr<const TextDoc> doc) const
+{
+	for (auto const& e : errors)
+	{
+		out.push_back(e->toDiagnostic(doc));
+	}
+
+	if (dropped > 0)
+	{
+		Diagnostic d;
+
+		d.stage = stage;
+		d.message = "Too many errors; Stopped after " + std::to_string(errors.size()) + ", and " + std::to_string(dropped) + " more were dropped";
+
+		out.push_back(d);
 
 	}
 
-	return ss.str();
 }
 
 sptr<Error> ErrorHandler::err(in<std::string> msg, in<Token> tknStart, in<Token> tknEnd)
 {
+	if (isFull())
+	{
+		return drop();
+	}
+
 	auto e = new_sptr<Error>();
 
 	e->stage = stage;
@@ -0,0 +1,1509 @@
+
+#include "modfile.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "program.h"
+
+#include "ast/basetypes.h"
+#include "ast/ctrlstmt.h"
+#include "ast/fnstmt.h"
+#include "ast/modstmts.h"
+#include "ast/scopestmt.h"
+#include "ast/setstmt.h"
+#include "ast/structstmt.h"
+#include "ast/typestmt.h"
+#include "ast/values.h"
+#include "ast/varstmt.h"
+
+using namespace caliburn;
+
+namespace fs = std::filesystem;
+
+//"CBRM" in little-endian
+static constexpr uint32_t MODULE_MAGIC = 0x4D524243;
+//Bump whenever the layout below changes
+static constexpr uint32_t MODULE_FORMAT = 1;
+
+//Nesting past this is assumed to be a corrupt file, rather than a real program
+static constexpr uint32_t MAX_NODE_DEPTH = 1024;
+
+/*
+Every kind of AST node that can be saved. Only ever append to this.
+*/
+enum class NodeKind : uint8_t
+{
+	NONE,
+
+	INT_LIT, FLOAT_LIT, STR_LIT, BOOL_LIT, NULL_LIT, ARRAY_LIT, ZERO,
+	EXPRESSION, UNARY, SIGN, UNSIGN, CAST, SUB_ARRAY,
+	VAR_READ, MEMBER_DIRECT, MEMBER_CHAIN, FN_CALL, METHOD_CALL,
+
+	SCOPE, BREAK, CONTINUE, DISCARD, PASS_STMT, UNREACHABLE, RETURN,
+	SET, IF, WHILE, VAR,
+
+	FUNCTION, STRUCT, TYPEDEF, IMPORT, MODULE
+
+};
+
+enum class VarKind : uint8_t
+{
+	LOCAL, GLOBAL
+};
+
+enum class GenericKind : uint8_t
+{
+	NONE, TYPE, CONST
+};
+
+/*
+Writes the AST out in pre-order. Strings which point into the source text are written as a range within it, so tokens
+don't each carry a copy of their text.
+
+All numbers are little-endian.
+*/
+struct ModuleWriter
+{
+	std::string_view text;
+	std::string bytes;
+	std::vector<std::string> errors;
+
+	ModuleWriter(std::string_view t) : text(t) {}
+
+	void u8(uint8_t v)
+	{
+		bytes.push_back((char)v);
+	}
+
+	void u32(uint32_t v)
+	{
+		char le[4] = { (char)v, (char)(v >> 8), (char)(v >> 16), (char)(v >> 24) };
+		bytes.append(le, 4);
+	}
+
+	void kind(NodeKind k)
+	{
+		u8((uint8_t)k);
+	}
+
+	void str(std::string_view s)
+	{
+		u32((uint32_t)s.size());
+		bytes.append(s.data(), s.size());
+	}
+
+	void view(std::string_view s)
+	{
+		auto const begin = text.data();
+		auto const end = begin + text.size();
+
+		//Compare as integers, since comparing pointers into different objects is undefined
+		auto const sBegin = RCAST<uintptr_t>(s.data());
+		auto const sEnd = sBegin + s.size();
+
+		if (!s.empty() && sBegin >= RCAST<uintptr_t>(begin) && sEnd <= RCAST<uintptr_t>(end))
+		{
+			u8(0);
+			u32((uint32_t)(sBegin - RCAST<uintptr_t>(begin)));
+			u32((uint32_t)s.size());
+		}
+		else
+		{
+			u8(1);
+			str(s);
+		}
+
+	}
+
+	void token(in<Token> t)
+	{
+		u8((uint8_t)t.type);
+
+		if (t.type == TokenType::UNKNOWN)
+		{
+			return;
+		}
+
+		view(t.str);
+		u32(t.pos.line);
+		u32(t.pos.column);
+
+	}
+
+	void tokens(in<std::vector<Token>> ts)
+	{
+		u32((uint32_t)ts.size());
+
+		for (auto const& t : ts)
+		{
+			token(t);
+		}
+
+	}
+
+	void type(ptr<const ParsedType> t)
+	{
+		if (t == nullptr)
+		{
+			u8(0);
+			return;
+		}
+
+		if (t->nameTkn.exists())
+		{
+			u8(1);
+			token(t->nameTkn);
+		}
+		else
+		{
+			u8(2);
+			view(t->name);
+		}
+
+		genArgs(t->genericArgs.get());
+		token(t->lastToken);
+		exprs(t->arrayDims);
+
+	}
+
+	void genResult(in<GenericResult> res)
+	{
+		MATCH(res, sptr<ParsedType>, t)
+		{
+			u8((uint8_t)GenericKind::TYPE);
+			type(t->get());
+			return;
+		}
+
+		MATCH(res, sptr<Expr>, v)
+		{
+			u8((uint8_t)GenericKind::CONST);
+			expr(v->get());
+			return;
+		}
+
+		u8((uint8_t)GenericKind::NONE);
+
+	}
+
+	void genArgs(ptr<const GenericArguments> args)
+	{
+		if (args == nullptr)
+		{
+			u8(0);
+			return;
+		}
+
+		u8(1);
+		token(args->first);
+		token(args->last);
+		u32((uint32_t)args->args.size());
+
+		for (auto const& a : args->args)
+		{
+			genResult(a);
+		}
+
+	}
+
+	void genSig(ptr<const GenericSignature> sig)
+	{
+		if (sig == nullptr)
+		{
+			u8(0);
+			return;
+		}
+
+		u8(1);
+		token(sig->first);
+		token(sig->last);
+		u32((uint32_t)sig->names.size());
+
+		for (auto const& n : sig->names)
+		{
+			u8((uint8_t)n.type);
+			str(n.name);
+			genResult(n.defaultResult);
+		}
+
+	}
+
+	void parsedVar(in<ParsedVar> v)
+	{
+		u32(v.mods);
+		token(v.first);
+		u8(v.isConst);
+		type(v.typeHint.get());
+		token(v.name);
+		expr(v.initValue.get());
+
+	}
+
+	void fn(FnType fnType, in<Token> first, in<Token> name, in<std::vector<Token>> invokeDims, in<std::vector<FnArg>> args, ptr<const ParsedType> retType, ptr<const GenericSignature> sig, ptr<const ScopeStmt> code)
+	{
+		u32((uint32_t)fnType);
+		token(first);
+		token(name);
+		tokens(invokeDims);
+		u32((uint32_t)args.size());
+
+		for (auto const& a : args)
+		{
+			type(a.typeHint.get());
+			view(a.name);
+		}
+
+		type(retType);
+		genSig(sig);
+		expr(code);
+
+	}
+
+	void exprs(in<std::vector<sptr<Expr>>> es)
+	{
+		u32((uint32_t)es.size());
+
+		for (auto const& e : es)
+		{
+			expr(e.get());
+		}
+
+	}
+
+	void expr(ptr<const Expr> e);
+
+};
+
+void ModuleWriter::expr(ptr<const Expr> e)
+{
+	if (e == nullptr)
+	{
+		kind(NodeKind::NONE);
+		return;
+	}
+
+	if (auto v = dynamic_cast<ptr<const IntLiteralValue>>(e))
+	{
+		kind(NodeKind::INT_LIT);
+		token(v->lit);
+	}
+	else if (auto v = dynamic_cast<ptr<const FloatLiteralValue>>(e))
+	{
+		kind(NodeKind::FLOAT_LIT);
+		token(v->lit);
+	}
+	else if (auto v = dynamic_cast<ptr<const StringLitValue>>(e))
+	{
+		kind(NodeKind::STR_LIT);
+		token(v->lit);
+	}
+	else if (auto v = dynamic_cast<ptr<const BoolLitValue>>(e))
+	{
+		kind(NodeKind::BOOL_LIT);
+		token(v->lit);
+	}
+	else if (auto v = dynamic_cast<ptr<const NullValue>>(e))
+	{
+		kind(NodeKind::NULL_LIT);
+		token(v->lit);
+	}
+	else if (auto v = dynamic_cast<ptr<const ArrayLitValue>>(e))
+	{
+		kind(NodeKind::ARRAY_LIT);
+		token(v->start);
+		exprs(v->values);
+		token(v->end);
+	}
+	else if (dynamic_cast<ptr<const ZeroValue>>(e))
+	{
+		kind(NodeKind::ZERO);
+	}
+	else if (auto v = dynamic_cast<ptr<const ExpressionValue>>(e))
+	{
+		kind(NodeKind::EXPRESSION);
+		expr(v->lValue.get());
+		u32((uint32_t)v->op);
+		expr(v->rValue.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const UnaryValue>>(e))
+	{
+		kind(NodeKind::UNARY);
+		u32((uint32_t)v->op);
+		token(v->start);
+		expr(v->val.get());
+		token(v->end);
+	}
+	else if (auto v = dynamic_cast<ptr<const SignValue>>(e))
+	{
+		kind(NodeKind::SIGN);
+		token(v->first);
+		expr(v->target.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const UnsignValue>>(e))
+	{
+		kind(NodeKind::UNSIGN);
+		token(v->first);
+		expr(v->target.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const CastValue>>(e))
+	{
+		kind(NodeKind::CAST);
+		expr(v->lhs.get());
+		type(v->castTarget.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const SubArrayValue>>(e))
+	{
+		kind(NodeKind::SUB_ARRAY);
+		expr(v->array.get());
+		expr(v->index.get());
+		token(v->last);
+	}
+	else if (auto v = dynamic_cast<ptr<const VarReadValue>>(e))
+	{
+		kind(NodeKind::VAR_READ);
+		token(v->varTkn);
+		str(v->varStr);
+	}
+	else if (auto v = dynamic_cast<ptr<const MemberReadDirectValue>>(e))
+	{
+		kind(NodeKind::MEMBER_DIRECT);
+		expr(v->target.get());
+		str(v->mem);
+	}
+	else if (auto v = dynamic_cast<ptr<const MemberReadChainValue>>(e))
+	{
+		kind(NodeKind::MEMBER_CHAIN);
+		expr(v->target.get());
+		tokens(v->mems);
+	}
+	else if (auto v = dynamic_cast<ptr<const FnCallValue>>(e))
+	{
+		kind(NodeKind::FN_CALL);
+		expr(v->name.get());
+		genArgs(v->genArgs.get());
+		exprs(v->args);
+		token(v->end);
+	}
+	else if (auto v = dynamic_cast<ptr<const MethodCallValue>>(e))
+	{
+		kind(NodeKind::METHOD_CALL);
+		expr(v->target.get());
+		token(v->name);
+		genArgs(v->genArgs.get());
+		exprs(v->args);
+		token(v->end);
+	}
+	else if (auto v = dynamic_cast<ptr<const ScopeStmt>>(e))
+	{
+		kind(NodeKind::SCOPE);
+		token(v->first);
+		token(v->last);
+		exprs(v->stmts);
+	}
+	else if (auto v = dynamic_cast<ptr<const BreakStmt>>(e))
+	{
+		kind(NodeKind::BREAK);
+		token(v->tkn);
+	}
+	else if (auto v = dynamic_cast<ptr<const ContinueStmt>>(e))
+	{
+		kind(NodeKind::CONTINUE);
+		token(v->tkn);
+	}
+	else if (auto v = dynamic_cast<ptr<const DiscardStmt>>(e))
+	{
+		kind(NodeKind::DISCARD);
+		token(v->tkn);
+	}
+	else if (auto v = dynamic_cast<ptr<const PassStmt>>(e))
+	{
+		kind(NodeKind::PASS_STMT);
+		token(v->tkn);
+	}
+	else if (auto v = dynamic_cast<ptr<const UnreachableStmt>>(e))
+	{
+		kind(NodeKind::UNREACHABLE);
+		token(v->tkn);
+	}
+	else if (auto v = dynamic_cast<ptr<const ReturnStmt>>(e))
+	{
+		kind(NodeKind::RETURN);
+		token(v->first);
+		expr(v->retValue.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const SetStmt>>(e))
+	{
+		kind(NodeKind::SET);
+		expr(v->lhs.get());
+		expr(v->rhs.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const IfStatement>>(e))
+	{
+		kind(NodeKind::IF);
+		token(v->first);
+		expr(v->condition.get());
+		expr(v->innerIf.get());
+		expr(v->innerElse.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const WhileStatement>>(e))
+	{
+		kind(NodeKind::WHILE);
+		token(v->first);
+		expr(v->condition.get());
+		expr(v->loop.get());
+		u8(v->doWhile);
+	}
+	else if (auto v = dynamic_cast<ptr<const VarStmt>>(e))
+	{
+		kind(NodeKind::VAR);
+		token(v->first);
+		u32((uint32_t)v->vars.size());
+
+		for (auto const& var : v->vars)
+		{
+			if (dynamic_cast<ptr<const GlobalVariable>>(var.get()))
+			{
+				u8((uint8_t)VarKind::GLOBAL);
+			}
+			else
+			{
+				u8((uint8_t)VarKind::LOCAL);
+			}
+
+			view(var->name);
+			u32(var->mods);
+			token(var->first);
+			token(var->nameTkn);
+			type(var->typeHint.get());
+			expr(var->initValue.get());
+			u8(var->isConst);
+
+		}
+
+	}
+	else if (auto v = dynamic_cast<ptr<const FnStmt>>(e))
+	{
+		auto const& f = *v->fn;
+
+		kind(NodeKind::FUNCTION);
+		fn(FnType::FUNCTION, v->first, v->name, f.invokeDims, *f.args, f.retType.get(), f.genSig.get(), f.code.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const StructStmt>>(e))
+	{
+		//The parser hands the signature and member functions over to the type, so they're saved from there
+		auto const& t = *v->innerType;
+
+		kind(NodeKind::STRUCT);
+		u32((uint32_t)v->type);
+		token(v->first);
+		token(v->name);
+		token(v->last);
+		genSig(t.genSig.get());
+
+		u32((uint32_t)t.members.size());
+
+		for (auto const& [_, mem] : t.members)
+		{
+			parsedVar(*mem);
+		}
+
+		u32((uint32_t)t.memberFns.size());
+
+		for (auto const& mf : t.memberFns)
+		{
+			fn(mf->type, mf->first, mf->name, mf->invokeDims, mf->args, mf->returnType.get(), mf->genSig.get(), mf->code.get());
+		}
+
+	}
+	else if (auto v = dynamic_cast<ptr<const TypedefStmt>>(e))
+	{
+		kind(NodeKind::TYPEDEF);
+		token(v->first);
+		token(v->name);
+		type(v->alias.get());
+	}
+	else if (auto v = dynamic_cast<ptr<const ImportStmt>>(e))
+	{
+		kind(NodeKind::IMPORT);
+		token(v->first);
+		token(v->name);
+		token(v->alias);
+	}
+	else if (auto v = dynamic_cast<ptr<const ModuleStmt>>(e))
+	{
+		kind(NodeKind::MODULE);
+		token(v->first);
+		token(v->name);
+	}
+	else
+	{
+		errors.push_back("Cannot save statement to a module: " + e->prettyStr());
+		kind(NodeKind::NONE);
+		return;
+	}
+
+	//Common to every node
+	u32(e->mods);
+	u32((uint32_t)e->annotations.size());
+
+	for (auto const& [name, a] : e->annotations)
+	{
+		str(name);
+		token(a->first);
+		token(a->name);
+		tokens(a->contents);
+		token(a->last);
+	}
+
+}
+
+/*
+The reverse of ModuleWriter. Malformed input doesn't throw; Reads past the end return defaults and clear ok, so
+callers only need to check it once everything is read.
+*/
+struct ModuleReader
+{
+	std::string_view data;
+	std::string_view text;
+	out<std::deque<std::string>> strings;
+
+	size_t pos = 0;
+	uint32_t depth = 0;
+	bool ok = true;
+
+	ModuleReader(std::string_view d, out<std::deque<std::string>> strs) : data(d), strings(strs) {}
+
+	bool fail()
+	{
+		ok = false;
+		return false;
+	}
+
+	bool has(size_t len)
+	{
+		if (ok && data.size() - pos >= len)
+		{
+			return true;
+		}
+
+		return fail();
+	}
+
+	uint8_t u8()
+	{
+		if (!has(1))
+		{
+			return 0;
+		}
+
+		return (uint8_t)data[pos++];
+	}
+
+	uint32_t u32()
+	{
+		if (!has(4))
+		{
+			return 0;
+		}
+
+		auto const b = RCAST<const uint8_t*>(data.data() + pos);
+		pos += 4;
+
+		return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+	}
+
+	/*
+	Reads an element count. Every element takes at least a byte, so anything past the remaining data is corrupt; This
+	keeps a bad count from allocating huge vectors.
+	*/
+	uint32_t count()
+	{
+		auto const n = u32();
+
+		if (ok && n > data.size() - pos)
+		{
+			fail();
+			return 0;
+		}
+
+		return n;
+	}
+
+	std::string_view bytes(size_t len)
+	{
+		if (!has(len))
+		{
+			return std::string_view();
+		}
+
+		auto const s = data.substr(pos, len);
+		pos += len;
+
+		return s;
+	}
+
+	std::string str()
+	{
+		auto const len = u32();
+		return std::string(bytes(len));
+	}
+
+	std::string_view view()
+	{
+		if (u8() == 0)
+		{
+			auto const offset = u32();
+			auto const len = u32();
+
+			if (!ok || offset > text.size() || len > text.size() - offset)
+			{
+				fail();
+				return std::string_view();
+			}
+
+			return text.substr(offset, len);
+		}
+
+		auto const len = u32();
+		auto const s = bytes(len);
+
+		if (s.empty())
+		{
+			return std::string_view();
+		}
+
+		return strings.emplace_back(s);
+	}
+
+	Token token()
+	{
+		Token t;
+
+		t.type = (TokenType)u8();
+
+		if (t.type == TokenType::UNKNOWN)
+		{
+			return t;
+		}
+
+		t.str = view();
+		t.pos.line = u32();
+		t.pos.column = u32();
+
+		return t;
+	}
+
+	std::vector<Token> tokens()
+	{
+		std::vector<Token> ts(count());
+
+		for (auto& t : ts)
+		{
+			t = token();
+		}
+
+		return ts;
+	}
+
+	ExprModifiers mods()
+	{
+		auto const bits = u32();
+		ExprModifiers m{};
+
+		std::memcpy(&m, &bits, sizeof(m));
+
+		return m;
+	}
+
+	sptr<ParsedType> type()
+	{
+		auto const form = u8();
+
+		if (form == 0)
+		{
+			return nullptr;
+		}
+
+		sptr<ParsedType> t = nullptr;
+
+		if (form == 1)
+		{
+			auto const nameTkn = token();
+			auto const args = genArgs();
+
+			t = args ? new_sptr<ParsedType>(nameTkn, args) : new_sptr<ParsedType>(nameTkn);
+		}
+		else
+		{
+			auto const name = view();
+			auto const args = genArgs();
+
+			t = args ? new_sptr<ParsedType>(name, args) : new_sptr<ParsedType>(name);
+		}
+
+		t->lastToken = token();
+		t->arrayDims = exprs();
+
+		return t;
+	}
+
+	GenericResult genResult()
+	{
+		switch ((GenericKind)u8())
+		{
+			case GenericKind::NONE: return GenericResult();
+			case GenericKind::TYPE: return type();
+			case GenericKind::CONST: return expr();
+			default: fail(); return GenericResult();
+		}
+
+	}
+
+	sptr<GenericArguments> genArgs()
+	{
+		if (u8() == 0)
+		{
+			return nullptr;
+		}
+
+		auto args = new_sptr<GenericArguments>();
+
+		args->first = token();
+		args->last = token();
+		args->args.resize(count());
+
+		for (auto& a : args->args)
+		{
+			a = genResult();
+		}
+
+		return args;
+	}
+
+	uptr<GenericSignature> genSig()
+	{
+		if (u8() == 0)
+		{
+			return nullptr;
+		}
+
+		auto const first = token();
+		auto const last = token();
+		auto const n = count();
+
+		std::vector<GenericName> names;
+
+		for (uint32_t i = 0; i < n && ok; ++i)
+		{
+			auto const type = (GenericSymType)u8();
+			auto const name = str();
+			auto const def = genResult();
+
+			names.emplace_back(type, name, def);
+
+		}
+
+		auto sig = new_uptr<GenericSignature>(names);
+
+		sig->first = first;
+		sig->last = last;
+
+		return sig;
+	}
+
+	sptr<ParsedVar> parsedVar()
+	{
+		auto v = new_sptr<ParsedVar>();
+
+		v->mods = mods();
+		v->first = token();
+		v->isConst = u8() != 0;
+		v->typeHint = type();
+		v->name = token();
+		v->initValue = expr();
+
+		return v;
+	}
+
+	uptr<ParsedFn> parsedFn()
+	{
+		auto f = new_uptr<ParsedFn>();
+
+		f->type = (FnType)u32();
+		f->first = token();
+		f->name = token();
+		f->invokeDims = tokens();
+		f->args.resize(count());
+
+		for (auto& a : f->args)
+		{
+			a.typeHint = type();
+			a.name = view();
+		}
+
+		f->returnType = type();
+		f->genSig = genSig();
+		f->code = scope();
+
+		return f;
+	}
+
+	std::vector<sptr<Expr>> exprs()
+	{
+		std::vector<sptr<Expr>> es(count());
+
+		for (auto& e : es)
+		{
+			e = expr();
+		}
+
+		return es;
+	}
+
+	/*
+	Reads a node which has to be a scope, e.g. a function body. Returns null if it isn't.
+
+	Unlike expr(), this makes the scope directly, since its owners want sole ownership of it.
+	*/
+	uptr<ScopeStmt> scope()
+	{
+		auto const k = (NodeKind)u8();
+
+		if (!ok || k == NodeKind::NONE)
+		{
+			return nullptr;
+		}
+
+		if (k != NodeKind::SCOPE || ++depth > MAX_NODE_DEPTH)
+		{
+			fail();
+			return nullptr;
+		}
+
+		auto s = new_uptr<ScopeStmt>();
+
+		scopeBody(*s);
+		common(*s);
+
+		--depth;
+
+		return s;
+	}
+
+	void scopeBody(out<ScopeStmt> s)
+	{
+		s.first = token();
+		s.last = token();
+		s.stmts = exprs();
+
+	}
+
+	void common(out<Expr> e);
+
+	sptr<Expr> expr();
+
+	sptr<Expr> node(NodeKind k);
+
+};
+
+sptr<Expr> ModuleReader::expr()
+{
+	auto const k = (NodeKind)u8();
+
+	if (!ok || k == NodeKind::NONE)
+	{
+		return nullptr;
+	}
+
+	if (++depth > MAX_NODE_DEPTH)
+	{
+		fail();
+		return nullptr;
+	}
+
+	auto e = node(k);
+
+	--depth;
+
+	if (e == nullptr)
+	{
+		fail();
+		return nullptr;
+	}
+
+	common(*e);
+
+	return e;
+}
+
+void ModuleReader::common(out<Expr> e)
+{
+	e.mods = mods();
+
+	auto const annotationCount = count();
+
+	for (uint32_t i = 0; i < annotationCount && ok; ++i)
+	{
+		auto const key = str();
+		auto const first = token();
+		auto const name = token();
+		auto const contents = tokens();
+		auto const last = token();
+
+		e.annotations[key] = new_uptr<Annotation>(first, name, contents, last);
+
+	}
+
+}
+
+sptr<Expr> ModuleReader::node(NodeKind k)
+{
+	switch (k)
+	{
+		case NodeKind::INT_LIT: return new_sptr<IntLiteralValue>(token());
+		case NodeKind::FLOAT_LIT: return new_sptr<FloatLiteralValue>(token());
+		case NodeKind::STR_LIT: return new_sptr<StringLitValue>(token());
+		case NodeKind::BOOL_LIT: return new_sptr<BoolLitValue>(token());
+		case NodeKind::NULL_LIT: return new_sptr<NullValue>(token());
+		case NodeKind::ZERO: return new_sptr<ZeroValue>();
+		case NodeKind::ARRAY_LIT:
+		{
+			auto v = new_sptr<ArrayLitValue>();
+
+			v->start = token();
+			v->values = exprs();
+			v->end = token();
+
+			return v;
+		}
+		case NodeKind::EXPRESSION:
+		{
+			auto const lhs = expr();
+			auto const op = (Operator)u32();
+			auto const rhs = expr();
+
+			return new_sptr<ExpressionValue>(lhs, op, rhs);
+		}
+		case NodeKind::UNARY:
+		{
+			auto v = new_sptr<UnaryValue>();
+
+			v->op = (Operator)u32();
+			v->start = token();
+			v->val = expr();
+			v->end = token();
+
+			return v;
+		}
+		case NodeKind::SIGN:
+		{
+			auto const first = token();
+			return new_sptr<SignValue>(first, expr());
+		}
+		case NodeKind::UNSIGN:
+		{
+			auto const first = token();
+			return new_sptr<UnsignValue>(first, expr());
+		}
+		case NodeKind::CAST:
+		{
+			auto v = new_sptr<CastValue>();
+
+			v->lhs = expr();
+			v->castTarget = type();
+
+			return v;
+		}
+		case NodeKind::SUB_ARRAY:
+		{
+			auto const array = expr();
+			auto const index = expr();
+
+			return new_sptr<SubArrayValue>(array, index, token());
+		}
+		case NodeKind::VAR_READ:
+		{
+			auto const tkn = token();
+			auto const name = str();
+
+			return tkn.exists() ? new_sptr<VarReadValue>(tkn) : new_sptr<VarReadValue>(name);
+		}
+		case NodeKind::MEMBER_DIRECT:
+		{
+			auto const target = expr();
+			return new_sptr<MemberReadDirectValue>(target, str());
+		}
+		case NodeKind::MEMBER_CHAIN:
+		{
+			auto v = new_sptr<MemberReadChainValue>(expr());
+
+			v->mems = tokens();
+
+			return v;
+		}
+		case NodeKind::FN_CALL:
+		{
+			auto v = new_sptr<FnCallValue>(expr());
+
+			v->genArgs = genArgs();
+			v->args = exprs();
+			v->end = token();
+
+			return v;
+		}
+		case NodeKind::METHOD_CALL:
+		{
+			auto const target = expr();
+			auto v = new_sptr<MethodCallValue>(target, token());
+
+			v->genArgs = genArgs();
+			v->args = exprs();
+			v->end = token();
+
+			return v;
+		}
+		case NodeKind::SCOPE:
+		{
+			auto v = new_sptr<ScopeStmt>();
+
+			scopeBody(*v);
+
+			return v;
+		}
+		case NodeKind::BREAK: return new_sptr<BreakStmt>(token());
+		case NodeKind::CONTINUE: return new_sptr<ContinueStmt>(token());
+		case NodeKind::DISCARD: return new_sptr<DiscardStmt>(token());
+		case NodeKind::PASS_STMT: return new_sptr<PassStmt>(token());
+		case NodeKind::UNREACHABLE: return new_sptr<UnreachableStmt>(token());
+		case NodeKind::RETURN:
+		{
+			auto v = new_sptr<ReturnStmt>(token());
+
+			v->retValue = expr();
+
+			return v;
+		}
+		case NodeKind::SET:
+		{
+			auto const lhs = expr();
+			return new_sptr<SetStmt>(lhs, expr());
+		}
+		case NodeKind::IF:
+		{
+			auto v = new_sptr<IfStatement>();
+
+			v->first = token();
+			v->condition = expr();
+			v->innerIf = expr();
+			v->innerElse = expr();
+
+			return v;
+		}
+		case NodeKind::WHILE:
+		{
+			auto v = new_sptr<WhileStatement>();
+
+			v->first = token();
+			v->condition = expr();
+			v->loop = scope();
+			v->doWhile = u8() != 0;
+
+			return v;
+		}
+		case NodeKind::VAR:
+		{
+			auto v = new_sptr<VarStmt>();
+
+			v->first = token();
+
+			auto const n = count();
+
+			for (uint32_t i = 0; i < n && ok; ++i)
+			{
+				auto const varKind = (VarKind)u8();
+				auto const name = view();
+
+				sptr<Variable> var = nullptr;
+
+				if (varKind == VarKind::GLOBAL)
+				{
+					var = new_sptr<GlobalVariable>(name);
+				}
+				else
+				{
+					var = new_sptr<LocalVariable>(name);
+				}
+
+				var->mods = mods();
+				var->first = token();
+				var->nameTkn = token();
+				var->typeHint = type();
+				var->initValue = expr();
+				var->isConst = u8() != 0;
+
+				v->vars.push_back(var);
+
+			}
+
+			return v;
+		}
+		case NodeKind::FUNCTION:
+		{
+			auto const pfn = parsedFn();
+			return new_sptr<FnStmt>(*pfn);
+		}
+		case NodeKind::STRUCT:
+		{
+			auto const stmtType = (ExprType)u32();
+			auto const first = token();
+			auto const name = token();
+
+			auto v = new_sptr<StructStmt>(stmtType, first, name);
+
+			v->last = token();
+
+			auto sig = genSig();
+
+			std::map<std::string_view, sptr<ParsedVar>> members;
+			auto const memCount = count();
+
+			for (uint32_t i = 0; i < memCount && ok; ++i)
+			{
+				auto const mem = parsedVar();
+				members.emplace(mem->name.str, mem);
+			}
+
+			std::vector<uptr<ParsedFn>> fns;
+			auto const fnCount = count();
+
+			for (uint32_t i = 0; i < fnCount && ok; ++i)
+			{
+				fns.push_back(parsedFn());
+			}
+
+			//Same as the parser does once a struct is finished
+			v->innerType = new_sptr<TypeStruct>(name.str, sig, members, fns);
+
+			return v;
+		}
+		case NodeKind::TYPEDEF:
+		{
+			auto const first = token();
+			auto const name = token();
+			auto const alias = type();
+
+			if (alias == nullptr)
+			{
+				return nullptr;
+			}
+
+			return new_sptr<TypedefStmt>(first, name, alias);
+		}
+		case NodeKind::IMPORT:
+		{
+			auto const first = token();
+			auto const name = token();
+
+			return new_sptr<ImportStmt>(first, name, token());
+		}
+		case NodeKind::MODULE:
+		{
+			auto const first = token();
+			return new_sptr<ModuleStmt>(first, token());
+		}
+		default: return nullptr;
+	}
+
+}
+
+std::string caliburn::moduleFilePath(in<std::string> dir, std::string_view name)
+{
+	return (fs::path(dir) / (std::string(name) + std::string(MODULE_FILE_EXT))).string();
+}
+
+bool caliburn::writeModule(in<PreparedProgram> prog, out<std::string> bytes, out<std::vector<std::string>> errors)
+{
+	if (!prog.success())
+	{
+		errors.push_back("Cannot make a module out of a source with errors");
+		return false;
+	}
+
+	ptr<const ModuleStmt> modStmt = nullptr;
+
+	for (auto const& stmt : prog.ast)
+	{
+		if (stmt->type == ExprType::MODULE)
+		{
+			modStmt = RCAST<ptr<const ModuleStmt>>(stmt.get());
+			break;
+		}
+
+	}
+
+	if (modStmt == nullptr)
+	{
+		errors.push_back("Modules need a module statement to name them, e.g. \"module lighting;\"");
+		return false;
+	}
+
+	auto const text = prog.src->text();
+
+	ModuleWriter w(text);
+
+	w.u32(MODULE_MAGIC);
+	w.u32(MODULE_FORMAT);
+	w.str(COMPILER_VERSION);
+	w.str(modStmt->name.str);
+	w.str(text);
+
+	uint32_t stmtCount = 0;
+
+	for (auto const& stmt : prog.ast)
+	{
+		if (stmt->type != ExprType::SHADER)
+		{
+			++stmtCount;
+		}
+
+	}
+
+	w.u32(stmtCount);
+
+	for (auto const& stmt : prog.ast)
+	{
+		if (stmt->type != ExprType::SHADER)
+		{
+			w.expr(stmt.get());
+		}
+
+	}
+
+	if (!w.errors.empty())
+	{
+		errors.insert(errors.end(), w.errors.begin(), w.errors.end());
+		return false;
+	}
+
+	bytes = std::move(w.bytes);
+
+	return true;
+}
+
+bool caliburn::storeModuleFile(in<std::string> path, in<std::string> bytes)
+{
+	auto const target = fs::path(path);
+
+	//Unique per process and thread, same as the disk cache
+	std::stringstream tmpName;
+	tmpName << target.filename().string() << ".tmp."
+		<< std::random_device()() << '.'
+		<< std::hash<std::thread::id>()(std::this_thread::get_id()) << '.'
+		<< std::chrono::steady_clock::now().time_since_epoch().count();
+
+	auto const tmpPath = target.parent_path() / tmpName.str();
+
+	std::error_code ec;
+
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		file.write(bytes.data(), bytes.size());
+		file.flush();
+
+		if (!file)
+		{
+			file.close();
+			fs::remove(tmpPath, ec);
+			return false;
+		}
+
+	}
+
+	fs::rename(tmpPath, target, ec);
+
+	if (ec)
+	{
+		fs::remove(tmpPath, ec);
+		return false;
+	}
+
+	return true;
+}
+
+sptr<const ModuleInterface> ModuleInterface::read(sptr<const SourceText> file)
+{
+	auto mod = new_sptr<ModuleInterface>();
+
+	mod->file = file;
+
+	ModuleReader r(file->text(), mod->strings);
+
+	if (r.u32() != MODULE_MAGIC || r.u32() != MODULE_FORMAT || r.str() != COMPILER_VERSION)
+	{
+		return nullptr;
+	}
+
+	mod->name = r.str();
+
+	auto const textLen = r.u32();
+
+	//The text stays inside the file; Nothing is copied
+	r.text = r.bytes(textLen);
+	mod->text = r.text;
+
+	auto const stmtCount = r.count();
+
+	for (uint32_t i = 0; i < stmtCount && r.ok; ++i)
+	{
+		if (auto stmt = r.expr())
+		{
+			mod->ast.push_back(stmt);
+		}
+		else
+		{
+			r.fail();
+		}
+
+	}
+
+	if (!r.ok || r.pos != r.data.size())
+	{
+		return nullptr;
+	}
+
+	return mod;
+}
+
+#ifdef _WIN32
+/*
+Reads an entire file onto the heap. Returns null if it couldn't be read.
+*/
+static sptr<const SourceText> readWholeFile(in<std::string> path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open())
+	{
+		return nullptr;
+	}
+
+	std::stringstream ss;
+	ss << file.rdbuf();
+
+	if (file.bad())
+	{
+		return nullptr;
+	}
+
+	return new_sptr<OwnedSource>(ss.str());
+}
+#endif
+
+sptr<const ModuleHeaders> ModuleInterface::headers(sptr<const CompilerSettings> settings) const
+{
+	{
+		std::lock_guard<std::mutex> guard(headerLock);
+
+		auto const found = declared.find(settings->dynTypes);
+
+		if (found != declared.end())
+		{
+			return found->second;
+		}
+
+	}
+
+	//Declared outside the lock, since imports within the module declare their own; Two threads might both declare the
+	//same headers, but only the first one is kept
+	auto modErr = ErrorHandler(CompileStage::SYMBOL_GENERATION, settings);
+	auto result = new_sptr<ModuleHeaders>();
+
+	result->table = declareModuleHeaders(ast, settings, modErr);
+	modErr.report(result->errors);
+
+	std::lock_guard<std::mutex> guard(headerLock);
+
+	return declared.emplace(settings->dynTypes, result).first->second;
+}
+
+sptr<const ModuleInterface> ModuleInterface::find(in<std::string> dir, in<std::string> name)
+{
+	struct LoadedFile
+	{
+		fs::file_time_type modified;
+		uintmax_t size = 0;
+		sptr<const ModuleInterface> mod;
+	};
+
+	static std::mutex lock;
+	static std::map<std::string, LoadedFile> loaded;
+
+	auto const path = moduleFilePath(dir, name);
+
+	std::error_code ec;
+	auto const modified = fs::last_write_time(path, ec);
+
+	if (ec)
+	{
+		return nullptr;
+	}
+
+	auto const size = fs::file_size(path, ec);
+
+	if (ec)
+	{
+		return nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		auto const found = loaded.find(path);
+
+		if (found != loaded.end() && found->second.modified == modified && found->second.size == size)
+		{
+			return found->second.mod;
+		}
+
+	}
+
+	//Loaded outside the lock; Two threads might both load the same module, but only once, and only after it changes
+#ifdef _WIN32
+	//Windows can't rename over a file which is mapped, and loaded modules are kept for good, so it's read instead
+	auto const file = readWholeFile(path);
+#else
+	auto const file = MappedFile::open(path);
+#endif
+
+	if (file == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto mod = read(file);
+
+	if (mod == nullptr || mod->name != name)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	loaded[path] = LoadedFile{ modified, size, mod };
+
+	return mod;
+}
@@ -50,14 +50,18 @@ void Parser::skipStmt()
 std::vector<sptr<Expr>> Parser::parse()
 {
 	std::vector<sptr<Expr>> ast;
+	auto const madeBefore = Expr::made;
 
-	while (tkns.hasCur())
+	while (tkns.hasCur() && !cancel.isCancelled() && !errors->isFull())
 	{
 		auto const start = tkns.cur();
+		auto const startIdx = tkns.offset();
 
 		if (auto finished = parseDecl())
 		{
 			ast.push_back(std::move(finished));
+			declStarts.push_back(startIdx);
+			declFirstTkns.push_back(start);
 		}
 		else
 		{
@@ -67,13 +71,15 @@ std::vector<sptr<Expr>> Parser::parse()
 
 	}
 
+	nodeCount = Expr::made - madeBefore;
+
 	return ast;
 }
 
 template<typename T>
 T Parser::parseAny(in<std::vector<ParseMethod<T>>> fns)
 {
-	size_t const current = tkns.offset();
+	auto const current = tkns.mark();
 
 	for (auto& fn : fns)
 	{
@@ -159,7 +165,7 @@ std::vector<Token> Parser::parseIdentifierList()
 uptr<GenericSignature> Parser::parseGenericSig()
 {
 	auto const first = tkns.cur();
-	size_t const start = tkns.offset();
+	auto const start = tkns.mark();
 	
 	if (first.str != GENERIC_START)
 	{
@@ -256,7 +262,7 @@ sptr<GenericArguments> Parser::parseGenericArgs()
 	}
 
 	auto const first = tkns.cur();
-	size_t const start = tkns.offset();
+	auto const start = tkns.mark();
 	
 	if (first.str != GENERIC_START)
 	{
@@ -418,7 +424,7 @@ uptr<ScopeStmt> Parser::parseScope(in<std::vector<ParseMethod<sptr<Expr>>>> pms,
 
 		for (auto const& pm : pms)
 		{
-			auto const off = tkns.offset();
+			auto const off = tkns.mark();
 
 			if (auto stmt = pm(*this))
 			{
@@ -688,7 +694,7 @@ sptr<Expr> Parser::parseTypedef()
 
 	if (sptr<ParsedType> aliasedType = parseTypeName())
 	{
-		return new_uptr<TypedefStmt>(settings, start, name, aliasedType);
+		return new_uptr<TypedefStmt>(start, name, aliasedType);
 	}
 	else
 	{
@@ -941,6 +947,8 @@ sptr<Expr> Parser::parseStruct()
 		auto e = errors->err("Failed to properly parse struct contents", first);
 	}
 
+	stmt->innerType = new_sptr<TypeStruct>(name.str, stmt->genSig, stmt->members, stmt->memberFns);
+
 	return stmt;
 }
 
@@ -1172,7 +1180,7 @@ sptr<Expr> Parser::parseSetter()
 
 sptr<Expr> Parser::parseControl()
 {
-	size_t const start = tkns.offset();
+	auto const start = tkns.mark();
 
 	auto as = parseAllAnnotations();
 
@@ -1547,7 +1555,7 @@ sptr<Expr> Parser::parseTerm()
 
 	while (tkns.hasRem(2))
 	{
-		auto& keywd = tkns.cur();
+		auto const keywd = tkns.cur();
 
 		if (keywd.type != TokenType::KEYWORD)
 		{
@@ -1728,7 +1736,7 @@ sptr<Expr> Parser::parseUnaryValue()
 
 sptr<Expr> Parser::parseParenValue()
 {
-	size_t const start = tkns.offset();
+	auto const start = tkns.mark();
 
 	auto const first = tkns.cur();
 
@@ -1801,7 +1809,7 @@ sptr<Expr> Parser::parseMemberAccess(sptr<Expr> target)
 
 		if (tkns.hasRem(3))
 		{
-			auto& fnStart = tkns.peek(1);
+			auto const fnStart = tkns.peek(1);
 
 			if (fnStart.type == TokenType::START_PAREN || fnStart.str == GENERIC_START)
 			{
@@ -1845,7 +1853,7 @@ sptr<Expr> Parser::parseFnCall(sptr<Expr> name)
 		return nullptr;
 	}
 
-	size_t const tknStart = tkns.offset();
+	auto const tknStart = tkns.mark();
 
 	auto fnCall = new_sptr<FnCallValue>(name);
 
@@ -1880,7 +1888,7 @@ sptr<Expr> Parser::parseMethodCall(sptr<Expr> target)
 		return nullptr;
 	}
 
-	size_t const tknStart = tkns.offset();
+	auto const tknStart = tkns.mark();
 
 	if (!tkns.hasRem(3))
 	{
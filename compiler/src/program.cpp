@@ -0,0 +1,412 @@
+
+#include "program.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "parser.h"
+#include "stats.h"
+#include "tokenizer.h"
+
+#include "ast/stdlib.h"
+
+using namespace caliburn;
+
+//The program whose headers are being declared on this thread, so that its import statements can find its imports
+static thread_local ptr<const PreparedProgram> declaring = nullptr;
+
+/*
+Every reused declaration keeps one more old source alive. Past this many, a full re-parse is cheaper than the memory.
+*/
+static constexpr size_t MAX_RETAINED_SRCS = 32;
+
+/*
+Finds the shader objects within a freshly-parsed program.
+*/
+static void findShaders(out<PreparedProgram> prog, sptr<const CompilerSettings> settings)
+{
+	//TODO AST validation and conditional compilation go here
+
+	for (auto const& stmt : prog.ast)
+	{
+		if (stmt->type == ExprType::SHADER)
+		{
+			auto shadDecl = RCAST<ptr<const ShaderStmt>>(stmt.get());
+
+			//First one wins
+			prog.shaders.emplace(shadDecl->name.str, shadDecl);
+
+		}
+
+	}
+
+	//Streamed programs don't keep their tokens, and count them while parsing instead
+	if (settings->collectStats && !prog.tokens.empty())
+	{
+		prog.stats.tokens = prog.tokens.size();
+	}
+
+}
+
+/*
+Adds freshly-parsed declarations, along with their tokens, to the end of a program.
+
+regionStart is where tokenization started; The first new declaration starts there, so that the program's declarations
+keep covering the whole source.
+*/
+static void appendFresh(out<PreparedProgram> prog, in<TokenStream> fresh, in<std::vector<sptr<Expr>>> ast, in<Parser> p, size_t regionStart)
+{
+	auto const tokenBase = prog.tokens.size();
+	auto const text = prog.doc->text.data();
+
+	for (size_t i = 0; i < ast.size(); ++i)
+	{
+		DeclSpan span;
+
+		span.firstToken = tokenBase + p.declStarts[i];
+
+		if (i == 0)
+		{
+			span.startByte = regionStart;
+		}
+		else
+		{
+			span.startByte = SCAST<size_t>(p.declFirstTkns[i].str.data() - text);
+		}
+
+		prog.ast.push_back(ast[i]);
+		prog.decls.push_back(span);
+
+	}
+
+	prog.tokens.append(fresh);
+
+}
+
+sptr<SymbolTable> caliburn::declareHeaders(in<PreparedProgram> prog, sptr<const CompilerSettings> settings, out<std::vector<Diagnostic>> errors)
+{
+	//The built-in symbols are shared, so everything goes in a child table
+	auto table = new_sptr<SymbolTable>(sharedStdLib());
+
+	auto symErr = ErrorHandler(CompileStage::SYMBOL_GENERATION, settings);
+
+	//Imports may declare their own headers again, so put back whichever program was being declared before
+	auto const outer = declaring;
+	declaring = &prog;
+
+	//Declare headers
+	for (auto const& stmt : prog.ast)
+	{
+		if (symErr.isFull())
+		{
+			break;
+		}
+
+		stmt->declareHeader(table, settings, symErr);
+
+	}
+
+	declaring = outer;
+
+	symErr.report(errors, prog.doc.get());
+
+	return table;
+}
+
+sptr<SymbolTable> caliburn::declareModuleHeaders(in<std::vector<sptr<Expr>>> ast, sptr<const CompilerSettings> settings, out<ErrorHandler> err)
+{
+	auto table = new_sptr<SymbolTable>(sharedStdLib());
+
+	//The importing program's imports mean nothing inside the module
+	auto const outer = declaring;
+	declaring = nullptr;
+
+	for (auto const& stmt : ast)
+	{
+		if (err.isFull())
+		{
+			break;
+		}
+
+		stmt->declareHeader(table, settings, err);
+
+	}
+
+	declaring = outer;
+
+	return table;
+}
+
+sptr<const PreparedProgram> caliburn::findImport(std::string_view name)
+{
+	if (declaring == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto const found = declaring->imports.find(name);
+
+	if (found == declaring->imports.end())
+	{
+		return nullptr;
+	}
+
+	return found->second;
+}
+
+sptr<SymbolTable> caliburn::importedHeaders(in<PreparedProgram> prog, sptr<const CompilerSettings> settings)
+{
+	if (prog.headers != nullptr && settings->dynTypes == prog.headerDynTypes)
+	{
+		return prog.headers;
+	}
+
+	std::vector<Diagnostic> ignored;
+
+	return declareHeaders(prog, settings, ignored);
+}
+
+void caliburn::declareProgram(out<PreparedProgram> prog, sptr<const CompilerSettings> settings)
+{
+	auto timer = StageTimer(settings->collectStats ? &prog.stats.symbolGenNs : nullptr, TraceWriter::forSettings(*settings), "Symbol generation");
+
+	prog.headerDynTypes = settings->dynTypes;
+	prog.headers = declareHeaders(prog, settings, prog.headerErrors);
+
+}
+
+sptr<PreparedProgram> caliburn::prepareProgram(in<std::string> src, sptr<const CompilerSettings> settings, in<CancelToken> cancel)
+{
+	return prepareProgram(new_sptr<OwnedSource>(src), settings, cancel);
+}
+
+sptr<PreparedProgram> caliburn::prepareProgram(sptr<const SourceText> src, sptr<const CompilerSettings> settings, in<CancelToken> cancel)
+{
+	auto prog = parseProgram(src, settings, cancel);
+
+	if (prog->success())
+	{
+		declareProgram(*prog, settings);
+	}
+
+	return prog;
+}
+
+sptr<PreparedProgram> caliburn::parseProgram(sptr<const SourceText> src, sptr<const CompilerSettings> settings, in<CancelToken> cancel)
+{
+	auto prog = new_sptr<PreparedProgram>(src);
+	auto const stats = settings->collectStats ? &prog->stats : nullptr;
+	auto const trace = TraceWriter::forSettings(*settings);
+
+	auto t = Tokenizer(prog->doc);
+	t.cancel = cancel;
+	TokenStream tokens(prog->doc);
+
+	//Tokenizing everything first is faster, but streaming only ever holds a few tokens at a time
+	if (!settings->streamTokens)
+	{
+		auto tknTimer = StageTimer(stats ? &stats->tokenizerNs : nullptr, trace, "Tokenize");
+
+		tokens = t.tokenize();
+
+	}
+
+	auto parseTimer = StageTimer(stats ? &stats->parserNs : nullptr, trace, settings->streamTokens ? "Tokenize and parse" : "Parse");
+
+	auto p = settings->streamTokens ? Parser(settings, t) : Parser(settings, tokens);
+	p.cancel = cancel;
+	auto ast = p.parse();
+
+	parseTimer.stop();
+
+	if (stats)
+	{
+		stats->astNodes = p.nodeCount;
+
+		if (settings->streamTokens)
+		{
+			stats->tokens = p.tokenCount();
+		}
+
+	}
+
+	if (cancel.isCancelled())
+	{
+		prog->errors.push_back(Diagnostic{ CompileStage::UNKNOWN, "Compilation cancelled" });
+		return prog;
+	}
+
+	if (!p.errors->empty())
+	{
+		p.errors->report(prog->errors);
+		return prog;
+	}
+
+	appendFresh(*prog, tokens, ast, p, 0);
+
+	findShaders(*prog, settings);
+
+	return prog;
+}
+
+sptr<PreparedProgram> caliburn::reprepareProgram(sptr<const PreparedProgram> prev, in<std::string> src, in<TextEdit> edit, sptr<const CompilerSettings> settings)
+{
+	auto const oldSrc = prev->src->text();
+	auto const editEnd = edit.offset + edit.removed;
+
+	//Make sure the edit actually describes the difference between the two sources
+	bool const validEdit = editEnd <= oldSrc.size()
+		&& oldSrc.size() - edit.removed + edit.inserted == src.size()
+		&& std::memcmp(oldSrc.data(), src.data(), edit.offset) == 0
+		&& std::memcmp(oldSrc.data() + editEnd, src.data() + edit.offset + edit.inserted, oldSrc.size() - editEnd) == 0;
+
+	//Streamed programs have no tokens to reuse
+	if (!validEdit || !prev->success() || prev->decls.empty() || prev->tokens.empty() || prev->retained.size() >= MAX_RETAINED_SRCS)
+	{
+		auto prog = prepareProgram(src, settings);
+
+		prog->path = prev->path;
+
+		return prog;
+	}
+
+	auto const& decls = prev->decls;
+
+	//Index of the last declaration starting at or before the byte
+	auto const containing = LAMBDA(size_t byte)
+	{
+		auto found = std::upper_bound(decls.begin(), decls.end(), byte, LAMBDA(size_t b, in<DeclSpan> d)
+		{
+			return b < d.startByte;
+		});
+
+		return found == decls.begin() ? 0 : SCAST<size_t>(found - decls.begin()) - 1;
+	};
+
+	//Include the char right before the edit, in case the edit joins onto the token before it
+	auto const first = containing(edit.offset == 0 ? 0 : edit.offset - 1);
+	auto const last = containing(std::min(editEnd, oldSrc.size() - 1));
+
+	auto prog = new_sptr<PreparedProgram>(new_sptr<OwnedSource>(src));
+
+	prog->path = prev->path;
+	prog->retained = prev->retained;
+	prog->retained.push_back(prev->src);
+
+	//Only imports the previous version already had can be found; Those are the ones the project was scheduled around
+	prog->imports = prev->imports;
+	prog->importKey = prev->importKey;
+
+	auto const delta = SCAST<int64_t>(edit.inserted) - SCAST<int64_t>(edit.removed);
+
+	//Where the unaffected declarations after the edit now start
+	std::vector<size_t> syncPoints;
+
+	for (auto i = last + 1; i < decls.size(); ++i)
+	{
+		syncPoints.push_back(SCAST<size_t>(SCAST<int64_t>(decls[i].startByte) + delta));
+	}
+
+	auto const regionStart = (first == 0) ? 0 : decls[first].startByte;
+	auto const regionToken = (first == 0) ? 0 : decls[first].firstToken;
+
+	auto const stats = settings->collectStats ? &prog->stats : nullptr;
+	auto const trace = TraceWriter::forSettings(*settings);
+
+	auto tknTimer = StageTimer(stats ? &stats->tokenizerNs : nullptr, trace, "Tokenize (incremental)");
+
+	auto t = Tokenizer(prog->doc, regionStart);
+	TokenStream fresh(prog->doc);
+
+	//Index of the first declaration after the edit which can be reused; Tokenizing only depends on the text, so once
+	//the tokenizer lands on the start of one, everything after it is the same as before, just moved
+	auto resume = decls.size();
+
+	if (t.tokenizeUntil(syncPoints, fresh))
+	{
+		resume = last + 1 + SCAST<size_t>(std::lower_bound(syncPoints.begin(), syncPoints.end(), t.offset()) - syncPoints.begin());
+	}
+
+	tknTimer.stop();
+
+	auto parseTimer = StageTimer(stats ? &stats->parserNs : nullptr, trace, "Parse (incremental)");
+
+	auto p = Parser(settings, fresh);
+	auto freshAst = p.parse();
+
+	parseTimer.stop();
+
+	if (stats)
+	{
+		stats->astNodes = p.nodeCount;
+	}
+
+	if (!p.errors->empty())
+	{
+		p.errors->report(prog->errors);
+		return prog;
+	}
+
+	//Everything before the edit is unchanged
+	prog->tokens.append(prev->tokens, 0, regionToken);
+
+	for (size_t i = 0; i < first; ++i)
+	{
+		prog->ast.push_back(prev->ast[i]);
+		prog->decls.push_back(decls[i]);
+	}
+
+	appendFresh(*prog, fresh, freshAst, p, regionStart);
+
+	//Everything after the edit only moved within the source
+	if (resume < decls.size())
+	{
+		auto const oldTokenBase = decls[resume].firstToken;
+		auto const newTokenBase = prog->tokens.size();
+
+		for (auto i = resume; i < decls.size(); ++i)
+		{
+			auto span = decls[i];
+
+			span.firstToken = span.firstToken - oldTokenBase + newTokenBase;
+			span.startByte = SCAST<size_t>(SCAST<int64_t>(span.startByte) + delta);
+
+			prog->ast.push_back(prev->ast[i]);
+			prog->decls.push_back(span);
+
+		}
+
+		prog->tokens.append(prev->tokens, oldTokenBase, prev->tokens.size(), delta);
+
+	}
+
+	//Reused declarations point into older sources, so the document has to know where that text sits now
+	auto const suffixStart = (resume < decls.size()) ? decls[resume].startByte : oldSrc.size();
+	auto olderText = prev->doc->moved;
+
+	olderText.push_back(TextDoc::MovedText{ oldSrc, 0 });
+
+	for (auto const& m : olderText)
+	{
+		auto const end = m.offset + m.old.size();
+
+		//Before the edit, so it didn't move
+		if (m.offset < regionStart)
+		{
+			prog->doc->moved.push_back(TextDoc::MovedText{ m.old.substr(0, std::min(end, regionStart) - m.offset), m.offset });
+		}
+
+		if (end > suffixStart)
+		{
+			auto const skip = (m.offset < suffixStart) ? suffixStart - m.offset : 0;
+
+			prog->doc->moved.push_back(TextDoc::MovedText{ m.old.substr(skip), SCAST<size_t>(SCAST<int64_t>(m.offset + skip) + delta) });
+		}
+
+	}
+
+	findShaders(*prog, settings);
+	declareProgram(*prog, settings);
+
+	return prog;
+}
@@ -0,0 +1,307 @@
+
+#include "project.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+
+#include "sha256.h"
+#include "trace.h"
+
+#include "ast/modstmts.h"
+
+using namespace caliburn;
+
+/*
+Runs work(i) for every node, spread over the pool, but only once work(d) has finished for every d within deps[i].
+
+The calling thread works too, so this can't deadlock even when called from within the pool. If any work throws, the
+first exception is rethrown once everything else is finished.
+
+Returns which nodes ran; Nodes on, or depending on, a cycle never do.
+*/
+template<typename Fn>
+static std::vector<bool> runGraph(out<ThreadPool> pool, in<std::vector<std::vector<size_t>>> deps, Fn work)
+{
+	/*
+	Shared with the pool's workers, since a worker may only get to its task after everything is done.
+	*/
+	struct GraphJob
+	{
+		Fn work;
+
+		std::vector<std::vector<size_t>> dependents;
+		std::vector<size_t> waiting;
+		std::vector<bool> ran;
+		std::exception_ptr failure;
+
+		std::deque<size_t> ready;
+		size_t running = 0;
+		std::mutex lock;
+		std::condition_variable changed;
+
+		GraphJob(Fn fn, size_t count) : work(fn), dependents(count), waiting(count), ran(count) {}
+
+	};
+
+	auto const count = deps.size();
+	auto job = new_sptr<GraphJob>(work, count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (auto const d : deps[i])
+		{
+			job->dependents[d].push_back(i);
+		}
+
+		job->waiting[i] = deps[i].size();
+
+		if (deps[i].empty())
+		{
+			job->ready.push_back(i);
+		}
+
+	}
+
+	//Workers take whatever's ready, until nothing is ready and nothing is running that could make more ready
+	auto worker = [job]()
+	{
+		std::unique_lock<std::mutex> guard(job->lock);
+
+		while (true)
+		{
+			job->changed.wait(guard, LAMBDA() { return !job->ready.empty() || job->running == 0; });
+
+			if (job->ready.empty())
+			{
+				break;
+			}
+
+			auto const i = job->ready.front();
+			job->ready.pop_front();
+			++job->running;
+
+			guard.unlock();
+
+			std::exception_ptr failure;
+
+			try
+			{
+				job->work(i);
+			}
+			catch (...)
+			{
+				failure = std::current_exception();
+			}
+
+			guard.lock();
+
+			--job->running;
+			job->ran[i] = true;
+
+			if (failure != nullptr && job->failure == nullptr)
+			{
+				job->failure = failure;
+			}
+
+			for (auto const d : job->dependents[i])
+			{
+				if (--job->waiting[d] == 0)
+				{
+					job->ready.push_back(d);
+				}
+
+			}
+
+			job->changed.notify_all();
+
+		}
+
+	};
+
+	auto const helpers = std::min<size_t>(pool.size(), count);
+
+	for (size_t t = 1; t < helpers; ++t)
+	{
+		pool.submit(worker);
+	}
+
+	worker();
+
+	//The caller only stops once nothing is running, so every result is in by now
+	std::lock_guard<std::mutex> guard(job->lock);
+
+	if (job->failure != nullptr)
+	{
+		std::rethrow_exception(job->failure);
+	}
+
+	return job->ran;
+}
+
+/*
+Hashes every source a program imports, transitively, by way of each import's own key.
+*/
+static std::string makeImportKey(in<PreparedProgram> prog)
+{
+	if (prog.imports.empty())
+	{
+		return "";
+	}
+
+	SHA256 hash;
+
+	for (auto const& [name, imported] : prog.imports)
+	{
+		hash.updateField(name);
+		hash.updateField(imported->src->text());
+		hash.updateField(imported->importKey);
+	}
+
+	return SHA256::toHex(hash.finish());
+}
+
+std::vector<sptr<PreparedProgram>> caliburn::prepareProject(in<std::vector<std::string>> paths, sptr<const CompilerSettings> settings, out<ThreadPool> pool)
+{
+	auto const count = paths.size();
+	auto const trace = TraceWriter::forSettings(*settings);
+
+	std::vector<sptr<PreparedProgram>> progs(count);
+
+	//Nothing depends on anything yet, so every file is parsed at once
+	{
+		auto span = TraceSpan(trace, "Parse project");
+
+		runGraph(pool, std::vector<std::vector<size_t>>(count), [&paths, &progs, settings](size_t i)
+		{
+			auto const file = MappedFile::open(paths[i]);
+
+			if (file == nullptr)
+			{
+				progs[i] = new_sptr<PreparedProgram>(new_sptr<OwnedSource>(""));
+				progs[i]->errors.push_back(Diagnostic{ CompileStage::UNKNOWN, "Could not read file: " + paths[i] });
+				return;
+			}
+
+			progs[i] = parseProgram(file, settings);
+			progs[i]->path = paths[i];
+
+		});
+
+	}
+
+	//Build the import graph. Files are visited in order, so the first file to claim a module name keeps it.
+	std::map<std::string_view, size_t> owners;
+	std::vector<std::vector<std::string_view>> importNames(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto& prog = *progs[i];
+
+		if (!prog.success())
+		{
+			continue;
+		}
+
+		bool named = false;
+
+		for (auto const& stmt : prog.ast)
+		{
+			if (stmt->type == ExprType::IMPORT)
+			{
+				importNames[i].push_back(RCAST<ptr<const ImportStmt>>(stmt.get())->name.str);
+			}
+			else if (stmt->type == ExprType::MODULE && !named)
+			{
+				auto const modName = RCAST<ptr<const ModuleStmt>>(stmt.get())->name.str;
+
+				named = true;
+
+				auto const [found, added] = owners.emplace(modName, i);
+
+				if (!added)
+				{
+					prog.errors.push_back(Diagnostic{ CompileStage::UNKNOWN, "Module " + std::string(modName) + " is already declared by " + paths[found->second] });
+				}
+
+			}
+
+		}
+
+	}
+
+	std::vector<std::vector<size_t>> deps(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (auto const name : importNames[i])
+		{
+			auto const found = owners.find(name);
+
+			//Not in the project, so it's left to the module directory
+			if (found == owners.end())
+			{
+				continue;
+			}
+
+			if (progs[i]->imports.emplace(std::string(name), progs[found->second]).second)
+			{
+				deps[i].push_back(found->second);
+			}
+
+		}
+
+	}
+
+	std::vector<bool> declared;
+
+	{
+		auto span = TraceSpan(trace, "Declare project");
+
+		declared = runGraph(pool, deps, [&progs, settings](size_t i)
+		{
+			auto& prog = *progs[i];
+
+			if (!prog.success())
+			{
+				return;
+			}
+
+			prog.importKey = makeImportKey(prog);
+
+			declareProgram(prog, settings);
+
+		});
+
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (declared[i])
+		{
+			continue;
+		}
+
+		//Blame the first import which is stuck too; Every file on a cycle has one, as does everything importing one
+		for (auto const d : deps[i])
+		{
+			if (!declared[d])
+			{
+				auto const& [name, _] = *std::find_if(progs[i]->imports.begin(), progs[i]->imports.end(), LAMBDA(auto const& imp)
+				{
+					return imp.second == progs[d];
+				});
+
+				progs[i]->errors.push_back(Diagnostic{ CompileStage::UNKNOWN, "Cannot import module " + name + " due to a circular import" });
+				break;
+			}
+
+		}
+
+	}
+
+	return progs;
+}
@@ -0,0 +1,138 @@
+
+#include "resultcache.h"
+
+#include "diskcache.h"
+
+using namespace caliburn;
+
+std::shared_ptr<const ShaderResult> ResultCache::find(in<Digest> key)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto found = entries.find(key);
+
+	if (found == entries.end())
+	{
+		++stats.misses;
+		return nullptr;
+	}
+
+	++stats.hits;
+
+	//Move to the front
+	lru.splice(lru.begin(), lru, found->second);
+
+	return found->second->result;
+}
+
+void ResultCache::add(in<Digest> key, std::shared_ptr<const ShaderResult> result)
+{
+	auto const bytes = sizeOf(*result);
+
+	if (bytes > maxBytes)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	//Another thread may have compiled the same thing in the meantime
+	if (entries.find(key) != entries.end())
+	{
+		return;
+	}
+
+	while (!lru.empty() && stats.bytes + bytes > maxBytes)
+	{
+		auto const& last = lru.back();
+
+		stats.bytes -= last.bytes;
+		--stats.entries;
+		++stats.evictions;
+
+		entries.erase(last.key);
+		lru.pop_back();
+
+	}
+
+	lru.push_front(Entry{ key, result, bytes });
+	entries.emplace(key, lru.begin());
+
+	stats.bytes += bytes;
+	++stats.entries;
+
+}
+
+Digest ResultCache::makeKey(std::string_view src, in<CompilerSettings> settings, std::string_view shaderName, std::string_view importKey)
+{
+	auto const outKey = DiskCache::makeKey(src, settings, shaderName, importKey);
+
+	SHA256 hash;
+
+	hash.update(outKey.data(), outKey.size());
+
+	hash.updateU32((uint32_t)settings.formatErrors);
+	hash.updateU32(settings.errorContextLines);
+	hash.updateU32(settings.maxErrors);
+	hash.updateU32((uint32_t)settings.collectStats);
+
+	return hash.finish();
+}
+
+CacheStats ResultCache::getStats() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	return stats;
+}
+
+void ResultCache::clear()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	lru.clear();
+	entries.clear();
+	stats = CacheStats();
+
+}
+
+uint64_t ResultCache::sizeOf(in<ShaderResult> result)
+{
+	uint64_t bytes = sizeof(ShaderResult) + sizeof(Entry);
+
+	for (auto const& shader : result.shaders)
+	{
+		bytes += sizeof(Shader);
+		bytes += shader->code.size() * sizeof(uint32_t);
+		bytes += shader->cllr.size();
+
+		for (auto const& attrib : shader->inputs)
+		{
+			bytes += sizeof(VertexInputAttribute) + attrib.name.capacity();
+		}
+
+		for (auto const& set : shader->sets)
+		{
+			bytes += sizeof(DescriptorSet) + set.name.capacity();
+		}
+
+	}
+
+	for (auto const& err : result.errors)
+	{
+		bytes += sizeof(std::string) + err.capacity();
+	}
+
+	for (auto const& d : result.diagnostics)
+	{
+		bytes += sizeof(Diagnostic) + d.message.capacity();
+
+		for (auto const& note : d.notes)
+		{
+			bytes += sizeof(std::string) + note.capacity();
+		}
+
+	}
+
+	return bytes;
+}
@@ -0,0 +1,145 @@
+
+#include "sha256.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace caliburn;
+
+static constexpr uint32_t ROUND_CONSTS[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static constexpr uint32_t rotr(uint32_t x, uint32_t n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+void SHA256::update(const void* data, size_t len)
+{
+	auto bytes = RCAST<const uint8_t*>(data);
+
+	totalLen += len;
+
+	while (len > 0)
+	{
+		auto const n = std::min(len, block.size() - blockLen);
+
+		std::memcpy(block.data() + blockLen, bytes, n);
+
+		blockLen += n;
+		bytes += n;
+		len -= n;
+
+		if (blockLen == block.size())
+		{
+			compress(block.data());
+			blockLen = 0;
+		}
+
+	}
+
+}
+
+Digest SHA256::finish()
+{
+	uint64_t const bitLen = totalLen * 8;
+
+	uint8_t const pad = 0x80;
+	update(&pad, 1);
+
+	uint8_t const zero = 0;
+
+	while (blockLen != 56)
+	{
+		update(&zero, 1);
+	}
+
+	uint8_t lenBytes[8];
+
+	for (int i = 0; i < 8; ++i)
+	{
+		lenBytes[i] = (uint8_t)(bitLen >> (56 - i * 8));
+	}
+
+	update(lenBytes, 8);
+
+	Digest out{};
+
+	for (size_t i = 0; i < state.size(); ++i)
+	{
+		out[i * 4 + 0] = (uint8_t)(state[i] >> 24);
+		out[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+		out[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+		out[i * 4 + 3] = (uint8_t)(state[i]);
+	}
+
+	return out;
+}
+
+std::string SHA256::toHex(in<Digest> digest)
+{
+	static constexpr char HEX[] = "0123456789abcdef";
+
+	std::string hex;
+	hex.reserve(digest.size() * 2);
+
+	for (auto const b : digest)
+	{
+		hex.push_back(HEX[b >> 4]);
+		hex.push_back(HEX[b & 0xF]);
+	}
+
+	return hex;
+}
+
+void SHA256::compress(const uint8_t* chunk)
+{
+	uint32_t w[64];
+
+	for (int i = 0; i < 16; ++i)
+	{
+		w[i] = ((uint32_t)chunk[i * 4] << 24) | ((uint32_t)chunk[i * 4 + 1] << 16) | ((uint32_t)chunk[i * 4 + 2] << 8) | (uint32_t)chunk[i * 4 + 3];
+	}
+
+	for (int i = 16; i < 64; ++i)
+	{
+		auto const s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		auto const s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	auto a = state[0], b = state[1], c = state[2], d = state[3];
+	auto e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (int i = 0; i < 64; ++i)
+	{
+		auto const s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+		auto const ch = (e & f) ^ (~e & g);
+		auto const t1 = h + s1 + ch + ROUND_CONSTS[i] + w[i];
+		auto const s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+		auto const maj = (a & b) ^ (a & c) ^ (b & c);
+		auto const t2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+}
@@ -0,0 +1,136 @@
+
+#include "source.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace caliburn;
+
+#ifdef _WIN32
+
+sptr<MappedFile> MappedFile::open(in<std::string> path)
+{
+	auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	//Can't use make_shared; The constructor's private
+	auto mapped = sptr<MappedFile>(new MappedFile());
+	mapped->fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		return nullptr;
+	}
+
+	mapped->size = SCAST<size_t>(fileSize.QuadPart);
+
+	//Empty files can't be mapped, but there's nothing to map anyway
+	if (mapped->size == 0)
+	{
+		return mapped;
+	}
+
+	mapped->mapHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mapped->mapHandle == nullptr)
+	{
+		return nullptr;
+	}
+
+	mapped->data = SCAST<ptr<const char>>(MapViewOfFile(mapped->mapHandle, FILE_MAP_READ, 0, 0, 0));
+
+	if (mapped->data == nullptr)
+	{
+		return nullptr;
+	}
+
+	return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+
+	if (mapHandle != nullptr)
+	{
+		CloseHandle(mapHandle);
+	}
+
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+	}
+
+}
+
+#else
+
+sptr<MappedFile> MappedFile::open(in<std::string> path)
+{
+	int const fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	//Can't use make_shared; The constructor's private
+	auto mapped = sptr<MappedFile>(new MappedFile());
+	mapped->size = SCAST<size_t>(info.st_size);
+
+	//Empty files can't be mapped, but there's nothing to map anyway
+	if (mapped->size > 0)
+	{
+		auto addr = mmap(nullptr, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (addr == MAP_FAILED)
+		{
+			close(fd);
+			return nullptr;
+		}
+
+		mapped->data = SCAST<ptr<const char>>(addr);
+
+	}
+
+	//The mapping keeps the file alive on its own
+	close(fd);
+
+	return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+	{
+		munmap(const_cast<char*>(data), size);
+	}
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "cinq.h"
 #include "langcore.h"
 #include "syntax.h"
+#include "trace.h"
 
 using namespace caliburn;
 
@@ -97,6 +98,8 @@ cllr::SPIRVOutAssembler::SPIRVOutAssembler(sptr<const CompilerSettings> cs) : Ou
 
 std::vector<uint32_t> cllr::SPIRVOutAssembler::translateCLLR(in<cllr::Assembler> cllrAsm)
 {
+	auto span = TraceSpan(TraceWriter::forSettings(*settings), "SPIRVOutAssembler::translateCLLR");
+
 	auto const& code = cllrAsm.getCode();
 
 	for (size_t off = 0; off < code.size(); ++off)
@@ -342,7 +345,7 @@ CLLR_SPIRV_IMPL(cllr::spirv_impl::OpShaderStage)
 
 	outCode.shaderEntries.push_back(spirv::EntryPoint
 		{
-			id, ex, inCode.getString(i.operands[1])
+			id, ex, inCode.getString(i.operands[1]), {}, i.operands[2]
 		});
 
 }
@@ -378,7 +381,7 @@ CLLR_SPIRV_IMPL(cllr::spirv_impl::OpShaderStageEnd)
 	//auto fp = types.findOrMake(spirv::OpTypeFloat(), { 32 });
 
 	spirv::SSA outType = 0;
-	auto outID = outCode.builtins.getOutputFor(entry.type, outType);
+	auto outID = outCode.builtins.getOutputFor(entry.type, outType, entry.outLocation);
 
 	//void main() {
 	auto mainID = outCode.createSSA();
@@ -1,32 +1,101 @@
 
 #include "strhelp.h"
 
+#include <algorithm>
+#include <functional>
+
+#include "charscan.h"
+
 using namespace caliburn;
 
 TextDoc::TextDoc(in<std::string_view> str) : text(str) 
 {
-	size_t pos = 0;
+	//Every line ends in a \n, so they're found with the same scanner the tokenizer uses for comments
+	lineStarts.push_back(0);
 
-	for (size_t off = 0; off < text.size(); ++off)
+	for (size_t off = findLineEnd(text.data(), text.size()); off < text.size(); )
 	{
-		if (text[off] != '\n')
-		{
-			continue;
-		}
+		++off;
+
+		lineStarts.push_back(SCAST<uint32_t>(off));
 
-		size_t len = (off - pos);
+		off += findLineEnd(text.data() + off, text.size() - off);
 
-		lines.push_back(text.substr(pos, len));
+	}
 
-		pos = off + 1;
+}
 
+std::string_view TextDoc::getLine(size_t line) const
+{
+	if (line >= lineStarts.size())
+	{
+		return std::string_view();
 	}
 
-	lines.push_back(text.substr(pos));
+	auto const start = lineStarts[line];
+	auto const end = (line + 1 < lineStarts.size()) ? (lineStarts[line + 1] - 1) : text.size();
 
+	return text.substr(start, end - start);
 }
 
-std::string_view TextDoc::getLine(TextPos pos) const
+TextPos TextDoc::posOf(size_t offset, out<size_t> hint) const
 {
-	return lines[pos.line];
+	auto line = std::min(hint, lineStarts.size() - 1);
+
+	if (offset < lineStarts[line])
+	{
+		//Went backwards; Search everything before the hint
+		line = SCAST<size_t>(std::upper_bound(lineStarts.begin(), lineStarts.begin() + line, offset) - lineStarts.begin()) - 1;
+	}
+	else
+	{
+		//Tokens are mostly looked up in order, so the next line or two is a good bet before searching
+		for (size_t steps = 0; line + 1 < lineStarts.size() && lineStarts[line + 1] <= offset; ++steps)
+		{
+			if (steps == 2)
+			{
+				line = SCAST<size_t>(std::upper_bound(lineStarts.begin() + line, lineStarts.end(), offset) - lineStarts.begin()) - 1;
+				break;
+			}
+
+			++line;
+
+		}
+
+	}
+
+	hint = line;
+
+	TextPos pos;
+	pos.line = SCAST<uint32_t>(line);
+	pos.column = SCAST<uint32_t>(offset - lineStarts[line]);
+
+	return pos;
+}
+
+TextPos TextDoc::posOf(std::string_view str, in<TextPos> fallback) const
+{
+	//std::less, since comparing pointers into different strings is otherwise unspecified
+	auto const within = LAMBDA(std::string_view outer)
+	{
+		auto const less = std::less<ptr<const char>>();
+
+		return !less(str.data(), outer.data()) && !less(outer.data() + outer.size(), str.data());
+	};
+
+	if (within(text))
+	{
+		return posOf(SCAST<size_t>(str.data() - text.data()));
+	}
+
+	for (auto const& m : moved)
+	{
+		if (within(m.old))
+		{
+			return posOf(m.offset + SCAST<size_t>(str.data() - m.old.data()));
+		}
+
+	}
+
+	return fallback;
 }
@@ -0,0 +1,223 @@
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace caliburn;
+
+//Lets submit() tell whether it's being called from one of the pool's own workers
+static thread_local ptr<const ThreadPool> currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+ThreadPool::ThreadPool(uint32_t threads) :
+	threadCount(threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : threads)
+{
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		queues.push_back(new_uptr<WorkQueue>());
+	}
+
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+
+}
+
+void ThreadPool::start()
+{
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back(&ThreadPool::run, this, i);
+	}
+
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	std::call_once(started, &ThreadPool::start, this);
+
+	auto const idx = (currentPool == this) ? currentQueue : (nextQueue++ % threadCount);
+
+	{
+		//Held throughout, so that a worker can't take the task before it's counted
+		std::lock_guard<std::mutex> sleepGuard(sleepLock);
+
+		auto& q = *queues[idx];
+		std::lock_guard<std::mutex> guard(q.lock);
+
+		q.tasks.push_back(std::move(task));
+		++pending;
+
+	}
+
+	wake.notify_one();
+
+}
+
+void ThreadPool::forEach(size_t count, std::function<void(size_t)> work)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	/*
+	Shared with the pool's workers, since a worker may only get to its task after every call has finished.
+	*/
+	struct ForEachJob
+	{
+		const std::function<void(size_t)> work;
+
+		std::vector<std::exception_ptr> failures;
+
+		atom<size_t> next = 0;
+		size_t done = 0;
+		std::mutex lock;
+		std::condition_variable finished;
+
+		ForEachJob(std::function<void(size_t)> fn, size_t count) : work(std::move(fn)), failures(count) {}
+
+	};
+
+	auto job = new_sptr<ForEachJob>(std::move(work), count);
+
+	//Each worker claims the next index until there are none left
+	auto worker = [job, count]()
+	{
+		for (auto i = job->next++; i < count; i = job->next++)
+		{
+			try
+			{
+				job->work(i);
+			}
+			catch (...)
+			{
+				job->failures[i] = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(job->lock);
+				++job->done;
+			}
+
+			job->finished.notify_all();
+
+		}
+
+	};
+
+	auto const helpers = std::min<size_t>(threadCount, count);
+
+	for (size_t t = 1; t < helpers; ++t)
+	{
+		submit(worker);
+	}
+
+	worker();
+
+	{
+		std::unique_lock<std::mutex> guard(job->lock);
+		job->finished.wait(guard, LAMBDA() { return job->done == count; });
+	}
+
+	for (auto const& e : job->failures)
+	{
+		if (e != nullptr)
+		{
+			std::rethrow_exception(e);
+		}
+
+	}
+
+}
+
+void ThreadPool::run(size_t idx)
+{
+	currentPool = this;
+	currentQueue = idx;
+
+	while (true)
+	{
+		std::function<void()> task;
+
+		if (tryTake(idx, task))
+		{
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				//There's no one to hand it to, and letting it escape would terminate the process
+			}
+
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+
+		wake.wait(guard, LAMBDA() { return pending > 0 || stopping; });
+
+		if (stopping && pending == 0)
+		{
+			return;
+		}
+
+	}
+
+}
+
+bool ThreadPool::tryTake(size_t idx, out<std::function<void()>> task)
+{
+	bool found = false;
+
+	//Newest from our own queue first...
+	{
+		auto& own = *queues[idx];
+		std::lock_guard<std::mutex> guard(own.lock);
+
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			found = true;
+		}
+
+	}
+
+	//...then the oldest from everyone else's
+	for (size_t off = 1; !found && off < threadCount; ++off)
+	{
+		auto& other = *queues[(idx + off) % threadCount];
+		std::lock_guard<std::mutex> guard(other.lock);
+
+		if (!other.tasks.empty())
+		{
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			found = true;
+		}
+
+	}
+
+	if (found)
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		--pending;
+	}
+
+	return found;
+}
@@ -0,0 +1,61 @@
+
+#include "tokencursor.h"
+
+#include <algorithm>
+
+using namespace caliburn;
+
+TokenCheckpoint::TokenCheckpoint(ptr<TokenCursor> c, size_t off) : cursor(c), offset(off) {}
+
+TokenCheckpoint::~TokenCheckpoint()
+{
+	cursor->unpin(offset);
+}
+
+void TokenCursor::pull(size_t i)
+{
+	//Let go of whatever no checkpoint or peekBack() can reach anymore
+	auto keepFrom = index;
+
+	for (auto const p : pins)
+	{
+		keepFrom = std::min(keepFrom, p);
+	}
+
+	keepFrom = keepFrom > HISTORY ? keepFrom - HISTORY : 0;
+	keepFrom = std::min(keepFrom, filled);
+
+	auto const drop = keepFrom > windowStart ? keepFrom - windowStart : 0;
+
+	//Only moves the window once enough of it is dead, so that tokens aren't shuffled down on every pull
+	if (drop > 0 && drop * 2 >= window.size())
+	{
+		window.dropFront(drop);
+		windowStart += drop;
+	}
+
+	while (!exhausted && i >= filled)
+	{
+		auto const before = window.size();
+
+		source->tokenizeUntil({}, window, PULL_TOKENS);
+
+		auto const made = window.size() - before;
+
+		filled += made;
+
+		if (made == 0 || source->done())
+		{
+			exhausted = true;
+		}
+
+	}
+
+	peakWindow = std::max(peakWindow, window.size());
+
+	if (exhausted)
+	{
+		pastEnd = makeEndToken(window);
+	}
+
+}
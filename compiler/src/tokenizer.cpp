@@ -3,13 +3,25 @@
 #include <cctype>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 
 #include "tokenizer.h"
 
+#include "charscan.h"
+
 using namespace caliburn;
 
-Tokenizer::Tokenizer(sptr<TextDoc> t) : doc(t), buf(std::vector<char>(t->text.begin(), t->text.end()))
+Tokenizer::Tokenizer(sptr<TextDoc> t) : Tokenizer(t, 0) {}
+
+Tokenizer::Tokenizer(sptr<TextDoc> t, size_t start) :
+	base(start), buf(t->text.data() + start, t->text.size() - start), doc(t)
 {
+	//Token offsets are 32-bit
+	if (t->text.size() > UINT32_MAX)
+	{
+		throw std::length_error("Sources over 4 GiB can't be tokenized");
+	}
+
 	//I'm so sorry for this.
 
 	asciiTypes.fill(CharType::UNKNOWN);
@@ -66,12 +78,15 @@ Tokenizer::Tokenizer(sptr<TextDoc> t) : doc(t), buf(std::vector<char>(t->text.be
 
 CharType Tokenizer::getType(char chr) const
 {
-	if (chr > 127)
+	//char is usually signed, which would make everything past ASCII negative
+	auto const c = SCAST<uint8_t>(chr);
+
+	if (c > 127)
 	{
 		return CharType::IDENTIFIER;
 	}
 
-	return asciiTypes[chr];
+	return asciiTypes[c];
 }
 
 bool Tokenizer::findFloatFrac()
@@ -213,34 +228,47 @@ size_t Tokenizer::findIntLiteral(out<TokenType> type)
 
 size_t Tokenizer::findIdentifierLen() const
 {
-	size_t len = 0;
-
-	for (size_t i = 0; i < buf.remaining(); ++i)
-	{
-		auto const type = getType(buf.peek(i));
+	return scanIdentifier(buf.curPtr(), buf.remaining());
+}
 
-		if (type == CharType::IDENTIFIER || type == CharType::INT)
-		{
-			++len;
-		}
-		else break;
+TokenStream Tokenizer::tokenize()
+{
+	TokenStream tokens(doc);
 
-	}
+	tokenizeUntil({}, tokens);
 
-	return len;
+	return tokens;
 }
 
-std::vector<Token> Tokenizer::tokenize()
+bool Tokenizer::tokenizeUntil(in<std::vector<size_t>> syncPoints, out<TokenStream> tokens, size_t maxTokens)
 {
-	std::vector<Token> tokens;
+	auto nextSync = syncPoints.begin();
+	size_t iterations = 0;
+	auto const stopAt = (maxTokens > SIZE_MAX - tokens.size()) ? SIZE_MAX : tokens.size() + maxTokens;
 
-	while (buf.hasCur())
+	while (buf.hasCur() && tokens.size() < stopAt)
 	{
+		//Not every iteration; It's a shared atomic
+		if ((++iterations & 0xFFF) == 0 && cancel.isCancelled())
+		{
+			return false;
+		}
+
+		//Every iteration starts between tokens
+		while (nextSync != syncPoints.end() && *nextSync < offset())
+		{
+			++nextSync;
+		}
+
+		if (nextSync != syncPoints.end() && *nextSync == offset())
+		{
+			return true;
+		}
+
 		const char current = buf.cur();
 		const CharType type = getType(current);
 
 		const size_t start = buf.offset();
-		const TextPos startPos = pos;
 		auto tknType = TokenType::UNKNOWN;
 		size_t tknLen = 1;
 
@@ -252,19 +280,20 @@ std::vector<Token> Tokenizer::tokenize()
 			Windows \n
 			Linux/MacOS \r\n
 			Result: We don't care about \r. We just don't. We see it, we skip it. That way line counts are kept sane.
+
+			Whitespace comes in runs, so the whole run is skipped at once; Unless there's a sync point within it. Lines
+			aren't counted here; The document already knows where they start.
 			*/
 
-			buf.consume();
+			auto wsLen = scanWhitespace(buf.curPtr(), buf.remaining());
 
-			if (current == '\n')
-			{
-				pos.newline();
-			}
-			else if (current != '\r')
+			if (nextSync != syncPoints.end() && *nextSync < offset() + wsLen)
 			{
-				pos.move();
+				wsLen = *nextSync - offset();
 			}
 
+			buf.consume(wsLen);
+
 			continue;
 		}
 		else if (type == CharType::COMMENT)
@@ -272,21 +301,7 @@ std::vector<Token> Tokenizer::tokenize()
 			buf.consume();
 
 			//skip to the end of the line, which will later invoke the whitespace code
-			while (buf.hasCur())
-			{
-				if (buf.cur() == '\n')
-				{
-					break;
-				}
-
-				if (buf.cur() != '\r')
-				{
-					pos.move();
-				}
-
-				buf.consume();
-
-			}
+			buf.consume(findLineEnd(buf.curPtr(), buf.remaining()));
 
 			//go back to the start
 			continue;
@@ -306,19 +321,14 @@ std::vector<Token> Tokenizer::tokenize()
 
 			if (intLen == 0 && wordLen == 0)
 			{
-				throw std::runtime_error((std::stringstream() << "Zero width identifier found at " << pos.toStr()).str());
+				throw std::runtime_error((std::stringstream() << "Zero width identifier found at " << getPos().toStr()).str());
 			}
 
 			if (wordLen > intLen)
 			{
+				//Keywords are picked out along with every other token word, below
 				tknLen = wordLen;
 				tknType = TokenType::IDENTIFIER;
-
-				if (KEYWORDS.count(doc->text.substr(start, tknLen)))
-				{
-					tknType = TokenType::KEYWORD;
-				}
-
 			}
 			else
 			{
@@ -330,23 +340,33 @@ std::vector<Token> Tokenizer::tokenize()
 		{
 			if (buf.remaining() < 2)
 			{
-				throw std::exception("Not enough chars for a string literal");
+				throw std::runtime_error("Not enough chars for a string literal");
 			}
 
-			auto startPos = pos;
-
 			char delim = current;
 			bool foundDelim = false;
 
+			auto const text = buf.curPtr();
+			auto const textLen = buf.remaining();
+
 			size_t off = 1;
-			for (; off < buf.remaining(); ++off)
+			while (off < textLen)
 			{
-				char strChar = buf.peek(off);
+				//Skip straight to the next char that needs handling
+				auto const plainLen = findStringStop(text + off, textLen - off, delim);
+
+				off += plainLen;
+
+				if (off >= textLen)
+				{
+					break;
+				}
+
+				char strChar = text[off];
 
 				if (strChar == delim)
 				{
 					++off;
-					pos.move();
 					foundDelim = true;
 					break;
 				}
@@ -356,24 +376,18 @@ std::vector<Token> Tokenizer::tokenize()
 					//Escaped character; skip the backslash and whatever comes after
 					//Note: This will be sound when UTF-8 support is added, since UTF literals won't be needed
 
-					++off;
-					pos.move(2);
+					off += 2;
 					continue;
 				}
 
-				if (strChar == '\n')
-				{
-					pos.newline();
-					continue;
-				}
-				
-				pos.move();
+				//Newline
+				++off;
 
 			}
 
 			if (!foundDelim)
 			{
-				throw std::runtime_error((std::stringstream() << "Unescaped string starts at " << startPos.toStr()).str());
+				throw std::runtime_error((std::stringstream() << "Unescaped string starts at " << getPos().toStr()).str());
 			}
 
 			tknType = TokenType::LITERAL_STR;
@@ -410,9 +424,10 @@ std::vector<Token> Tokenizer::tokenize()
 			
 			while (opLen > 1)
 			{
-				auto const op = doc->text.substr(buf.offset(), opLen);
+				auto const op = doc->text.substr(base + buf.offset(), opLen);
 
-				if (LONG_OPS.find(op) != LONG_OPS.end())
+				//Every token word this long that's made of operator chars is an operator
+				if (findTokenWord(op) != nullptr)
 				{
 					break;
 				}
@@ -430,23 +445,21 @@ std::vector<Token> Tokenizer::tokenize()
 		{
 			//if all else fails, skip it.
 			buf.consume();
-			pos.move();
 			continue;
 		}
 
-		auto const content = doc->text.substr(start, tknLen);
+		auto const content = doc->text.substr(base + start, tknLen);
 
-		if (auto typeOverride = TOKEN_TYPE_OVERRIDES.find(content); typeOverride != TOKEN_TYPE_OVERRIDES.end())
+		if (auto const word = findTokenWord(content))
 		{
-			tknType = typeOverride->second;
+			tknType = word->type;
 		}
 
 		buf.consume(tknLen);
-		pos.move(SCAST<uint32_t>(tknLen));
 
-		tokens.push_back(Token{ content, tknType, startPos });
+		tokens.push(base + start, tknLen, tknType);
 
 	}
 
-	return tokens;
+	return false;
 }
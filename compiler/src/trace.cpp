@@ -0,0 +1,137 @@
+
+#include "trace.h"
+
+#include <atomic>
+#include <map>
+#include <sstream>
+
+using namespace caliburn;
+
+//Events are written out once this much has been buffered
+static constexpr size_t TRACE_BUFFER_SIZE = 64 * 1024;
+
+/*
+Chrome wants small integer thread IDs, so threads are numbered as they make their first event.
+*/
+static uint32_t traceThreadID()
+{
+	static atom<uint32_t> nextID = 1;
+	static thread_local uint32_t id = nextID++;
+
+	return id;
+}
+
+static void appendEscaped(out<std::string> out, std::string_view str)
+{
+	for (auto c : str)
+	{
+		switch (c)
+		{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+			{
+				if (SCAST<unsigned char>(c) < 0x20)
+				{
+					continue;
+				}
+
+				out += c;
+
+			}
+
+		}
+
+	}
+
+}
+
+sptr<TraceWriter> TraceWriter::forFile(in<std::string> path)
+{
+	//Almost every lookup is for the same file as the last one on this thread, so skip the lock
+	static thread_local std::string lastPath;
+	static thread_local sptr<TraceWriter> last;
+
+	if (last != nullptr && lastPath == path)
+	{
+		return last;
+	}
+
+	//Destroyed at exit, which writes out whatever is still buffered
+	static std::mutex writersLock;
+	static std::map<std::string, sptr<TraceWriter>> writers;
+
+	std::lock_guard<std::mutex> guard(writersLock);
+
+	auto& writer = writers[path];
+
+	if (writer == nullptr)
+	{
+		writer = new_sptr<TraceWriter>(path);
+	}
+
+	lastPath = path;
+	last = writer;
+
+	return writer;
+}
+
+TraceWriter::TraceWriter(in<std::string> path) : file(path, std::ios::out | std::ios::trunc)
+{
+	buffer = "[\n";
+
+}
+
+TraceWriter::~TraceWriter()
+{
+	flush();
+
+}
+
+void TraceWriter::addSpan(std::string_view name, std::string_view detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	using namespace std::chrono;
+
+	auto const ts = duration_cast<duration<double, std::micro>>(start - epoch).count();
+	auto const dur = duration_cast<duration<double, std::micro>>(end - start).count();
+
+	std::string event = "{\"name\":\"";
+	appendEscaped(event, name);
+
+	std::stringstream ss;
+	ss << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << traceThreadID() << std::fixed << ",\"ts\":" << ts << ",\"dur\":" << dur;
+	event += ss.str();
+
+	if (!detail.empty())
+	{
+		event += ",\"args\":{\"detail\":\"";
+		appendEscaped(event, detail);
+		event += "\"}";
+	}
+
+	event += "},\n";
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	buffer += event;
+
+	if (buffer.size() >= TRACE_BUFFER_SIZE)
+	{
+		file << buffer;
+		buffer.clear();
+	}
+
+}
+
+void TraceWriter::flush()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	file << buffer;
+	file.flush();
+	buffer.clear();
+
+}
@@ -0,0 +1,536 @@
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <vector>
+
+#include "diskcache.h"
+#include "resultcache.h"
+
+using namespace caliburn;
+
+namespace fs = std::filesystem;
+
+/*
+Makes an empty directory for a disk cache, unique to the test.
+*/
+static std::string freshCacheDir(const std::string& testName)
+{
+	auto const dir = fs::temp_directory_path() / ("caliburn_test_cache_" + testName);
+
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	return dir.string();
+}
+
+/*
+The path of the only entry in a cache directory.
+*/
+static fs::path onlyEntry(const std::string& dir)
+{
+	fs::path found;
+
+	for (auto const& entry : fs::recursive_directory_iterator(dir))
+	{
+		if (entry.is_regular_file())
+		{
+			EXPECT_TRUE(found.empty()) << "More than one cache entry";
+			found = entry.path();
+		}
+
+	}
+
+	return found;
+}
+
+static std::vector<char> readFile(const fs::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const fs::path& path, const std::vector<char>& bytes)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	file.write(bytes.data(), bytes.size());
+}
+
+static ShaderResult makeResult()
+{
+	ShaderResult result;
+
+	auto shader = new_uptr<Shader>(ShaderType::VERTEX, std::vector<uint32_t>{ 0x07230203, 1, 2, 3 });
+	shader->inputs.push_back(VertexInputAttribute{ "v", 0, 0 });
+	shader->cllr = { 1, 2, 3, 4 };
+
+	result.shaders.push_back(std::move(shader));
+
+	return result;
+}
+
+TEST(CacheTests, DiskCacheRoundTrip)
+{
+	auto const dir = freshCacheDir("DiskCacheRoundTrip");
+
+	DiskCache cache(dir);
+	Digest key{ 1 };
+
+	auto const stored = makeResult();
+	cache.store(key, stored);
+
+	ShaderResult loaded;
+	ASSERT_TRUE(cache.load(key, loaded));
+	ASSERT_EQ(loaded.shaders.size(), 1);
+	EXPECT_EQ(loaded.shaders[0]->code, stored.shaders[0]->code);
+	EXPECT_EQ(loaded.shaders[0]->cllr, stored.shaders[0]->cllr);
+
+	fs::remove_all(dir);
+
+}
+
+TEST(CacheTests, DiskCacheCorruptLength)
+{
+	auto const dir = freshCacheDir("DiskCacheCorruptLength");
+
+	DiskCache cache(dir);
+	Digest key{ 1 };
+
+	cache.store(key, makeResult());
+
+	auto const path = onlyEntry(dir);
+	auto bytes = readFile(path);
+
+	//The first shader's code length, after the magic, format, shader count, and shader type
+	ASSERT_GE(bytes.size(), 20);
+
+	for (size_t i = 16; i < 20; ++i)
+	{
+		bytes[i] = (char)0xFF;
+	}
+
+	writeFile(path, bytes);
+
+	//Has to fail without trying to allocate 16 GiB for the code
+	ShaderResult loaded;
+	EXPECT_FALSE(cache.load(key, loaded));
+	EXPECT_TRUE(loaded.shaders.empty());
+
+	//The bad entry is gone, so the next store replaces it
+	EXPECT_FALSE(fs::exists(path));
+
+	fs::remove_all(dir);
+
+}
+
+TEST(CacheTests, DiskCacheBadShaderType)
+{
+	auto const dir = freshCacheDir("DiskCacheBadShaderType");
+
+	DiskCache cache(dir);
+	Digest key{ 1 };
+
+	cache.store(key, makeResult());
+
+	auto const path = onlyEntry(dir);
+	auto bytes = readFile(path);
+
+	//The first shader's type, after the magic, format, and shader count
+	ASSERT_GE(bytes.size(), 16);
+
+	for (size_t i = 12; i < 16; ++i)
+	{
+		bytes[i] = (char)0xFF;
+	}
+
+	writeFile(path, bytes);
+
+	ShaderResult loaded;
+	EXPECT_FALSE(cache.load(key, loaded));
+	EXPECT_TRUE(loaded.shaders.empty());
+	EXPECT_FALSE(fs::exists(path));
+
+	fs::remove_all(dir);
+
+}
+
+TEST(CacheTests, DiskCacheTruncated)
+{
+	auto const dir = freshCacheDir("DiskCacheTruncated");
+
+	DiskCache cache(dir);
+	Digest key{ 1 };
+
+	cache.store(key, makeResult());
+
+	auto const path = onlyEntry(dir);
+	auto const size = fs::file_size(path);
+
+	//Every length up to the end marker, so each field's check gets a turn
+	for (uintmax_t cut = 0; cut < size; ++cut)
+	{
+		cache.store(key, makeResult());
+		fs::resize_file(path, cut);
+
+		ShaderResult loaded;
+		EXPECT_FALSE(cache.load(key, loaded)) << "Loaded an entry cut to " << cut << " bytes";
+		EXPECT_FALSE(fs::exists(path));
+
+	}
+
+	fs::remove_all(dir);
+
+}
+
+TEST(CacheTests, DiskCacheTrailingData)
+{
+	auto const dir = freshCacheDir("DiskCacheTrailingData");
+
+	DiskCache cache(dir);
+	Digest key{ 1 };
+
+	cache.store(key, makeResult());
+
+	auto const path = onlyEntry(dir);
+	auto bytes = readFile(path);
+
+	bytes.push_back(0);
+	writeFile(path, bytes);
+
+	ShaderResult loaded;
+	EXPECT_FALSE(cache.load(key, loaded));
+	EXPECT_FALSE(fs::exists(path));
+
+	fs::remove_all(dir);
+
+}
+
+TEST(CacheTests, SourceKey)
+{
+	CompilerSettings cs;
+
+	auto const srcKey = DiskCache::makeSourceKey("shader A {};", cs);
+
+	EXPECT_EQ(DiskCache::makeKey(srcKey, "A"), DiskCache::makeKey("shader A {};", cs, "A"));
+	EXPECT_NE(DiskCache::makeKey(srcKey, "A"), DiskCache::makeKey(srcKey, "B"));
+	EXPECT_NE(DiskCache::makeKey(srcKey, "A"), DiskCache::makeKey("shader B {};", cs, "A"));
+
+}
+
+TEST(CacheTests, ModuleStamp)
+{
+	auto const dir = freshCacheDir("ModuleStamp");
+
+	auto const empty = DiskCache::moduleStamp(dir);
+	EXPECT_EQ(DiskCache::moduleStamp(dir), empty);
+
+	writeFile(fs::path(dir) / "lighting.cbrnm", { 'C', 'B', 'R', 'N' });
+	//Same as Compiler::compileModule() does after writing one
+	DiskCache::forgetModuleStamps();
+
+	auto const oneModule = DiskCache::moduleStamp(dir);
+	EXPECT_NE(oneModule, empty);
+
+	//Only module files count
+	writeFile(fs::path(dir) / "notes.txt", { 'h', 'i' });
+	DiskCache::forgetModuleStamps();
+
+	EXPECT_EQ(DiskCache::moduleStamp(dir), oneModule);
+
+	//Rewriting a module in place doesn't touch the directory, but still has to change the stamp
+	writeFile(fs::path(dir) / "lighting.cbrnm", { 'C', 'B', 'R', 'N', 0 });
+
+	auto const rewritten = DiskCache::moduleStamp(dir);
+	EXPECT_NE(rewritten, oneModule);
+
+	//As does adding one right after the directory was last listed, even if its time hasn't moved on yet
+	writeFile(fs::path(dir) / "shadows.cbrnm", { 'C', 'B', 'R', 'N' });
+
+	EXPECT_NE(DiskCache::moduleStamp(dir), rewritten);
+
+	fs::remove_all(dir);
+
+}
+
+TEST(CacheTests, DiskCacheKeepsErrors)
+{
+	CompilerSettings cs;
+	cs.cacheDir = freshCacheDir("DiskCacheKeepsErrors");
+
+	Compiler compiler(cs);
+
+	//Parses fine, but fails once the shader is compiled
+	auto const src = R"(
+shader BrokenShader
+{
+	def frag(): vec4
+	{
+		return not_declared_anywhere;
+	};
+
+};
+)";
+
+	auto const first = compiler.compileSrcShaders(src, "BrokenShader");
+	ASSERT_FALSE(first.success());
+
+	//Would be a cache hit if the failure had been stored
+	auto const second = compiler.compileSrcShaders(src, "BrokenShader");
+	EXPECT_FALSE(second.success());
+	EXPECT_EQ(first.errors, second.errors);
+
+	fs::remove_all(cs.cacheDir);
+
+}
+
+TEST(CacheTests, CompileAsyncDiskCached)
+{
+	CompilerSettings cs;
+	cs.cacheDir = freshCacheDir("CompileAsyncDiskCached");
+	cs.memCacheBytes = 0;
+
+	Compiler compiler(cs);
+
+	auto const src = R"(
+shader TestShader
+{
+	vec4 frag_color;
+
+	def vertex(vec4 v, vec4 c): vec4
+	{
+		frag_color = c;
+		return v;
+	};
+
+	def frag(): vec4
+	{
+		return frag_color;
+	};
+
+};
+)";
+
+	auto const expected = compiler.compileSrcShaders(src, "TestShader");
+	ASSERT_TRUE(expected.success());
+
+	//Start from an empty cache, so that cancelled compiles are the first to get to it
+	fs::remove_all(cs.cacheDir);
+
+	std::vector<CancelToken> cancels(8);
+	std::vector<std::future<ShaderResult>> futures;
+
+	for (size_t i = 0; i < cancels.size(); ++i)
+	{
+		futures.push_back(compiler.compileAsync(src, "TestShader", cancels[i]));
+
+		if (i % 2 == 0)
+		{
+			cancels[i].cancel();
+		}
+
+	}
+
+	for (auto& future : futures)
+	{
+		auto const result = future.get();
+
+		if (result.cancelled)
+		{
+			EXPECT_TRUE(result.shaders.empty());
+			EXPECT_FALSE(result.success());
+		}
+
+	}
+
+	//A cancelled compile never reaches the cache, so whatever ended up there has to be a whole result
+	auto const cached = compiler.compileSrcShaders(src, "TestShader");
+	ASSERT_EQ(cached.shaders.size(), expected.shaders.size());
+
+	for (size_t i = 0; i < expected.shaders.size(); ++i)
+	{
+		EXPECT_EQ(cached.shaders[i]->code, expected.shaders[i]->code);
+	}
+
+	fs::remove_all(cs.cacheDir);
+
+}
+
+static Digest makeDigest(uint8_t n)
+{
+	Digest key{};
+	key[0] = n;
+
+	return key;
+}
+
+TEST(CacheTests, MemCacheEvictsLeastRecentlyUsed)
+{
+	auto const result = std::make_shared<const ShaderResult>(makeResult());
+	auto const size = ResultCache::sizeOf(*result);
+
+	//Room for exactly three results
+	ResultCache cache(size * 3);
+
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		cache.add(makeDigest(i), result);
+	}
+
+	auto stats = cache.getStats();
+	EXPECT_EQ(stats.entries, 3);
+	EXPECT_EQ(stats.bytes, size * 3);
+	EXPECT_EQ(stats.evictions, 0);
+
+	//Using the oldest makes the second one the least recently used
+	EXPECT_EQ(cache.find(makeDigest(0)), result);
+
+	cache.add(makeDigest(3), result);
+
+	EXPECT_EQ(cache.find(makeDigest(1)), nullptr);
+	EXPECT_EQ(cache.find(makeDigest(0)), result);
+	EXPECT_EQ(cache.find(makeDigest(2)), result);
+	EXPECT_EQ(cache.find(makeDigest(3)), result);
+
+	stats = cache.getStats();
+	EXPECT_EQ(stats.entries, 3);
+	EXPECT_EQ(stats.bytes, size * 3);
+	EXPECT_EQ(stats.evictions, 1);
+	EXPECT_EQ(stats.hits, 4);
+	EXPECT_EQ(stats.misses, 1);
+
+	//Adding a key that's already there changes nothing
+	cache.add(makeDigest(3), result);
+	EXPECT_EQ(cache.getStats().bytes, size * 3);
+
+	cache.clear();
+
+	stats = cache.getStats();
+	EXPECT_EQ(stats.entries, 0);
+	EXPECT_EQ(stats.bytes, 0);
+	EXPECT_EQ(stats.hits, 0);
+	EXPECT_EQ(cache.find(makeDigest(0)), nullptr);
+
+}
+
+TEST(CacheTests, MemCacheByteAccounting)
+{
+	auto const small = std::make_shared<const ShaderResult>(makeResult());
+
+	ShaderResult bigResult;
+	bigResult.shaders.push_back(new_uptr<Shader>(ShaderType::VERTEX, std::vector<uint32_t>(1024)));
+	auto const big = std::make_shared<const ShaderResult>(std::move(bigResult));
+
+	auto const smallSize = ResultCache::sizeOf(*small);
+	auto const bigSize = ResultCache::sizeOf(*big);
+
+	ASSERT_GT(bigSize, smallSize);
+
+	ResultCache cache(bigSize + smallSize);
+
+	cache.add(makeDigest(0), small);
+	cache.add(makeDigest(1), big);
+
+	EXPECT_EQ(cache.getStats().bytes, bigSize + smallSize);
+
+	//Needs both of them gone to fit
+	cache.add(makeDigest(2), big);
+
+	auto stats = cache.getStats();
+	EXPECT_EQ(stats.entries, 1);
+	EXPECT_EQ(stats.bytes, bigSize);
+	EXPECT_EQ(stats.evictions, 2);
+
+	//Never fits, so it's not added, and nothing is evicted for it
+	ResultCache tiny(smallSize - 1);
+	tiny.add(makeDigest(0), small);
+
+	stats = tiny.getStats();
+	EXPECT_EQ(stats.entries, 0);
+	EXPECT_EQ(stats.bytes, 0);
+	EXPECT_EQ(tiny.find(makeDigest(0)), nullptr);
+
+}
+
+TEST(CacheTests, MemCacheThroughCompiler)
+{
+	auto const src = R"(
+shader TestShader
+{
+	def vertex(vec4 v): vec4
+	{
+		return v;
+	};
+
+};
+)";
+
+	Compiler compiler;
+
+	auto const first = compiler.compileSrcShadersCached(src, "TestShader");
+	auto const second = compiler.compileSrcShadersCached(src, "TestShader");
+
+	ASSERT_TRUE(first->success());
+
+	//The very same result is handed out again
+	EXPECT_EQ(first, second);
+
+	auto const stats = compiler.getCacheStats();
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 1);
+	EXPECT_EQ(stats.entries, 1);
+	EXPECT_EQ(stats.bytes, ResultCache::sizeOf(*first));
+
+	CompilerSettings off;
+	off.memCacheBytes = 0;
+
+	Compiler uncached(off);
+
+	uncached.compileSrcShadersCached(src, "TestShader");
+	uncached.compileSrcShadersCached(src, "TestShader");
+
+	EXPECT_EQ(uncached.getCacheStats().entries, 0);
+	EXPECT_EQ(uncached.getCacheStats().hits, 0);
+
+}
+
+TEST(CacheTests, MemCacheKeyedByErrorSettings)
+{
+	auto const src = R"(
+shader BrokenShader
+{
+	def frag(): vec4
+	{
+		return missing_value;
+	};
+
+};
+)";
+
+	Compiler compiler;
+
+	auto const program = compiler.prepare(src);
+
+	CompilerSettings formatted;
+
+	CompilerSettings bare;
+	bare.formatErrors = false;
+
+	auto const first = compiler.compilePreparedCached(program, "BrokenShader", formatted);
+	auto const second = compiler.compilePreparedCached(program, "BrokenShader", bare);
+
+	ASSERT_FALSE(first->success());
+
+	//Failed results are cached, so one with differently formatted errors can't be handed out in place of the other
+	EXPECT_NE(first, second);
+	EXPECT_NE(first->errors, second->errors);
+	EXPECT_EQ(second->errors[0], second->diagnostics[0].message);
+
+	EXPECT_EQ(compiler.compilePreparedCached(program, "BrokenShader", bare), second);
+	EXPECT_EQ(compiler.getCacheStats().entries, 2);
+
+}
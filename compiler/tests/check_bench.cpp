@@ -0,0 +1,146 @@
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Everything is compiled into the benchmark, so don't import from the DLL
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+
+using namespace caliburn;
+
+/*
+Measures Compiler::check() latency, which editors call on every keystroke. The target is under 5 ms for a typical
+500-line shader, measured as the median of many runs. Build in release mode; Debug builds are several times slower.
+
+Usage: CaliburnCheckBench [file.cbrn]
+
+Without a file, a 500-line shader is generated. Exits with 1 if the target is missed.
+*/
+
+static constexpr double TARGET_MS = 5.0;
+static constexpr size_t WARMUP_RUNS = 10;
+static constexpr size_t TIMED_RUNS = 200;
+static constexpr size_t SRC_LINES = 500;
+
+/*
+Makes a shader of roughly the given number of lines, spread over a few helper functions and two stages, so that every
+part of type checking gets some work.
+*/
+static std::string makeSource(size_t lines)
+{
+	std::stringstream ss;
+
+	ss << "type FP = dynamic<fp32>;\n\n";
+	ss << "shader BenchShader\n{\n\tvec4 frag_color;\n\n";
+
+	ss << "\tdef vertex(vec4<FP> v, vec4 c): vec4<FP>\n\t{\n";
+
+	auto const stageLines = (lines - 16) / 2;
+
+	for (size_t i = 0; i < stageLines; ++i)
+	{
+		ss << "\t\tvar v" << i << " = " << (i == 0 ? "v" : "v" + std::to_string(i - 1)) << ";\n";
+	}
+
+	ss << "\t\tfrag_color = c;\n\t\treturn v" << (stageLines - 1) << ";\n\t};\n\n";
+
+	ss << "\tdef frag(): vec4\n\t{\n";
+
+	for (size_t i = 0; i < stageLines; ++i)
+	{
+		ss << "\t\tvar c" << i << " = " << (i == 0 ? "frag_color" : "c" + std::to_string(i - 1)) << ";\n";
+	}
+
+	ss << "\t\treturn c" << (stageLines - 1) << ";\n\t};\n\n};\n";
+
+	return ss.str();
+}
+
+static double median(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+
+	return samples[samples.size() / 2];
+}
+
+template<typename Fn>
+static std::vector<double> timeRuns(Fn run)
+{
+	for (size_t i = 0; i < WARMUP_RUNS; ++i)
+	{
+		run();
+	}
+
+	std::vector<double> samples;
+
+	for (size_t i = 0; i < TIMED_RUNS; ++i)
+	{
+		auto const start = std::chrono::steady_clock::now();
+
+		run();
+
+		auto const end = std::chrono::steady_clock::now();
+
+		samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+	}
+
+	return samples;
+}
+
+int main(int argc, char** argv)
+{
+	std::string src;
+
+	if (argc > 1)
+	{
+		std::ifstream file(argv[1], std::ios::binary);
+
+		if (!file)
+		{
+			std::cerr << "Could not read file: " << argv[1] << '\n';
+			return 2;
+		}
+
+		src = (std::stringstream() << file.rdbuf()).str();
+
+	}
+	else
+	{
+		src = makeSource(SRC_LINES);
+	}
+
+	CompilerSettings cs;
+
+	cs.dynTypes["FP"] = "fp32";
+	//Full compiles would otherwise be cache hits after the first run
+	cs.memCacheBytes = 0;
+
+	auto compiler = Compiler(cs);
+
+	auto const diags = compiler.check(src);
+
+	for (auto const& d : diags)
+	{
+		std::cout << d.format(src) << '\n';
+	}
+
+	auto const lineCount = std::count(src.begin(), src.end(), '\n');
+
+	auto const checkMs = timeRuns([&]() { compiler.check(src); });
+	auto const compileMs = timeRuns([&]() { compiler.compileAllShaders(src); });
+
+	auto const checkMedian = median(checkMs);
+
+	std::cout << "Source: " << lineCount << " lines, " << diags.size() << " errors\n";
+	std::cout << "check():             median " << checkMedian << " ms, max " << *std::max_element(checkMs.begin(), checkMs.end()) << " ms\n";
+	std::cout << "compileAllShaders(): median " << median(compileMs) << " ms, max " << *std::max_element(compileMs.begin(), compileMs.end()) << " ms\n";
+	std::cout << "Target: " << TARGET_MS << " ms; " << (checkMedian < TARGET_MS ? "PASS" : "FAIL") << '\n';
+
+	return checkMedian < TARGET_MS ? 0 : 1;
+}
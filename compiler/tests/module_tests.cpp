@@ -0,0 +1,418 @@
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+//Everything is compiled into the test, so don't import from the DLL
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+#include "modfile.h"
+#include "program.h"
+
+using namespace caliburn;
+
+namespace fs = std::filesystem;
+
+/*
+Makes an empty directory, unique to the test.
+*/
+static fs::path freshDir(const std::string& testName)
+{
+	auto const dir = fs::temp_directory_path() / ("caliburn_test_modules_" + testName);
+
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	return dir;
+}
+
+static std::string writeSource(const fs::path& dir, const std::string& name, const std::string& src)
+{
+	auto const path = (dir / name).string();
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	file << src;
+
+	return path;
+}
+
+static std::string readBytes(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::vector<std::string> messages(const std::vector<Diagnostic>& diags)
+{
+	std::vector<std::string> out;
+
+	for (auto const& d : diags)
+	{
+		out.push_back(d.message);
+	}
+
+	return out;
+}
+
+static bool anyContains(const std::vector<Diagnostic>& diags, const std::string& part)
+{
+	for (auto const& d : diags)
+	{
+		if (d.message.find(part) != std::string::npos)
+		{
+			return true;
+		}
+
+	}
+
+	return false;
+}
+
+//Only instantiated by whoever imports it, so the template has to survive the round trip
+static const std::string LIB_SRC = R"(
+module lighting;
+
+def pick<type T>(T a, T b): T
+{
+	return a;
+};
+)";
+
+static const std::string IMPORTER_SRC = R"(
+import lighting;
+
+shader TestShader
+{
+	def vertex(vec4 v, vec4 c): vec4
+	{
+		return lighting.pick<vec4>(v, c);
+	};
+
+};
+)";
+
+TEST(ModuleTests, RoundTrip)
+{
+	auto const dir = freshDir("RoundTrip");
+	auto const path = moduleFilePath(dir.string(), "lighting");
+
+	CompilerSettings cs;
+	cs.moduleDir = dir.string();
+
+	Compiler compiler(cs);
+
+	ASSERT_EQ(compiler.compileModule(LIB_SRC, path), std::vector<std::string>());
+
+	auto const mod = ModuleInterface::read(new_sptr<OwnedSource>(readBytes(path)));
+
+	ASSERT_NE(mod, nullptr);
+	EXPECT_EQ(mod->name, "lighting");
+	EXPECT_FALSE(mod->ast.empty());
+	EXPECT_NE(mod->text.find("def pick"), std::string_view::npos);
+
+	auto const result = compiler.compileSrcShaders(IMPORTER_SRC, "TestShader");
+
+	EXPECT_EQ(result.errors, std::vector<std::string>());
+	EXPECT_EQ(result.shaders.size(), 1);
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, CorruptModule)
+{
+	auto const dir = freshDir("CorruptModule");
+	auto const path = moduleFilePath(dir.string(), "lighting");
+
+	CompilerSettings cs;
+	cs.moduleDir = dir.string();
+
+	Compiler compiler(cs);
+
+	ASSERT_EQ(compiler.compileModule(LIB_SRC, path), std::vector<std::string>());
+
+	auto const bytes = readBytes(path);
+
+	ASSERT_NE(ModuleInterface::read(new_sptr<OwnedSource>(bytes)), nullptr);
+
+	//Every cut has to be caught, whether it lands in the header, the text, or the AST
+	for (size_t len = 0; len < bytes.size(); ++len)
+	{
+		EXPECT_EQ(ModuleInterface::read(new_sptr<OwnedSource>(bytes.substr(0, len))), nullptr) << "Truncated to " << len << " bytes";
+	}
+
+	auto badMagic = bytes;
+	badMagic[0] ^= 0xFF;
+	EXPECT_EQ(ModuleInterface::read(new_sptr<OwnedSource>(badMagic)), nullptr);
+
+	EXPECT_EQ(ModuleInterface::read(new_sptr<OwnedSource>(bytes + "x")), nullptr);
+
+	//Importing a broken file is an error, not a crash
+	writeSource(dir, fs::path(path).filename().string(), bytes.substr(0, bytes.size() / 2));
+
+	auto const result = compiler.compileSrcShaders(IMPORTER_SRC, "TestShader");
+
+	EXPECT_FALSE(result.success());
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, ProjectDiamond)
+{
+	auto const dir = freshDir("ProjectDiamond");
+
+	std::vector<std::string> paths = {
+		writeSource(dir, "main.cbrn", "import left;\nimport right;\n"),
+		writeSource(dir, "left.cbrn", "module left;\nimport base;\n"),
+		writeSource(dir, "right.cbrn", "module right;\nimport base;\n"),
+		writeSource(dir, "base.cbrn", "module base;\n")
+	};
+
+	Compiler compiler;
+
+	auto const progs = compiler.prepareProject(paths);
+
+	ASSERT_EQ(progs.size(), 4);
+
+	for (size_t i = 0; i < progs.size(); ++i)
+	{
+		EXPECT_TRUE(progs[i]->success()) << paths[i];
+		EXPECT_TRUE(progs[i]->headerErrors.empty()) << paths[i];
+	}
+
+	EXPECT_EQ(progs[0]->imports.size(), 2);
+
+	//Both sides of the diamond share the one program for the base
+	EXPECT_EQ(progs[1]->imports.at("base"), progs[3]);
+	EXPECT_EQ(progs[2]->imports.at("base"), progs[3]);
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, ProjectCycle)
+{
+	auto const dir = freshDir("ProjectCycle");
+
+	std::vector<std::string> paths = {
+		writeSource(dir, "a.cbrn", "module a;\nimport b;\n"),
+		writeSource(dir, "b.cbrn", "module b;\nimport a;\n"),
+		writeSource(dir, "c.cbrn", "module c;\nimport a;\n"),
+		writeSource(dir, "d.cbrn", "module d;\n")
+	};
+
+	Compiler compiler;
+
+	auto const progs = compiler.prepareProject(paths);
+
+	ASSERT_EQ(progs.size(), 4);
+
+	//Both files on the cycle fail, as does the one importing it, but nothing else
+	EXPECT_TRUE(anyContains(progs[0]->errors, "circular import"));
+	EXPECT_TRUE(anyContains(progs[1]->errors, "circular import"));
+	EXPECT_TRUE(anyContains(progs[2]->errors, "circular import"));
+	EXPECT_TRUE(progs[3]->success());
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, ProjectDuplicateModule)
+{
+	auto const dir = freshDir("ProjectDuplicateModule");
+
+	std::vector<std::string> paths = {
+		writeSource(dir, "first.cbrn", "module same;\n"),
+		writeSource(dir, "second.cbrn", "module same;\n"),
+		writeSource(dir, "user.cbrn", "import same;\n")
+	};
+
+	Compiler compiler;
+
+	auto const progs = compiler.prepareProject(paths);
+
+	ASSERT_EQ(progs.size(), 3);
+
+	//The first file to claim a name keeps it
+	EXPECT_TRUE(progs[0]->success());
+	EXPECT_TRUE(anyContains(progs[1]->errors, "already declared by " + paths[0]));
+
+	EXPECT_TRUE(progs[2]->success());
+	EXPECT_EQ(progs[2]->imports.at("same"), progs[0]);
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, ProjectDeterministic)
+{
+	auto const dir = freshDir("ProjectDeterministic");
+
+	std::vector<std::string> paths;
+
+	//A wide, deep graph with some broken files in it, so there are errors to compare as well
+	for (int i = 0; i < 32; ++i)
+	{
+		auto src = "module m" + std::to_string(i) + ";\n";
+
+		if (i > 0)
+		{
+			src += "import m" + std::to_string(i / 2) + ";\n";
+		}
+
+		if (i % 5 == 0)
+		{
+			src += "import missing" + std::to_string(i) + ";\n";
+		}
+
+		if (i % 7 == 0)
+		{
+			src += "import m" + std::to_string(i + 1) + ";\n";
+		}
+
+		paths.push_back(writeSource(dir, "m" + std::to_string(i) + ".cbrn", src));
+	}
+
+	paths.push_back(writeSource(dir, "dup.cbrn", "module m3;\n"));
+	paths.push_back(writeSource(dir, "nowhere.cbrn", ""));
+	fs::remove(paths.back());
+
+	std::vector<std::vector<std::shared_ptr<const PreparedProgram>>> runs;
+
+	for (uint32_t threads : { 1, 2, 8 })
+	{
+		CompilerSettings cs;
+		cs.workerThreads = threads;
+
+		Compiler compiler(cs);
+
+		runs.push_back(compiler.prepareProject(paths));
+
+	}
+
+	for (size_t r = 1; r < runs.size(); ++r)
+	{
+		ASSERT_EQ(runs[r].size(), paths.size());
+
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			auto const& expected = *runs[0][i];
+			auto const& actual = *runs[r][i];
+
+			EXPECT_EQ(messages(actual.errors), messages(expected.errors)) << paths[i];
+			EXPECT_EQ(messages(actual.headerErrors), messages(expected.headerErrors)) << paths[i];
+			EXPECT_EQ(actual.importKey, expected.importKey) << paths[i];
+			EXPECT_EQ(actual.imports.size(), expected.imports.size()) << paths[i];
+		}
+
+	}
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, NestedImportFromModuleDir)
+{
+	auto const dir = freshDir("NestedImportFromModuleDir");
+	auto const baseFile = moduleFilePath(dir.string(), "base");
+
+	CompilerSettings cs;
+	cs.moduleDir = dir.string();
+
+	Compiler compiler(cs);
+
+	ASSERT_EQ(compiler.compileModule("module base;\n", baseFile), std::vector<std::string>());
+	ASSERT_EQ(compiler.compileModule("module lighting;\nimport base;\n", moduleFilePath(dir.string(), "lighting")), std::vector<std::string>());
+
+	//The project has a base of its own, but lighting was built against the module file, which is gone now
+	fs::remove(baseFile);
+
+	std::vector<std::string> paths = {
+		writeSource(dir, "main.cbrn", "import base;\nimport lighting;\n"),
+		writeSource(dir, "base.cbrn", "module base;\n")
+	};
+
+	auto const progs = compiler.prepareProject(paths);
+
+	ASSERT_EQ(progs.size(), 2);
+	EXPECT_TRUE(progs[1]->headerErrors.empty());
+	EXPECT_TRUE(anyContains(progs[0]->headerErrors, "Module not found: base")) << ::testing::PrintToString(messages(progs[0]->headerErrors));
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, ModuleHeadersShared)
+{
+	auto const dir = freshDir("ModuleHeadersShared");
+	auto const path = moduleFilePath(dir.string(), "lighting");
+
+	auto cs = new_sptr<CompilerSettings>();
+	cs->moduleDir = dir.string();
+
+	Compiler compiler(*cs);
+
+	ASSERT_EQ(compiler.compileModule(LIB_SRC, path), std::vector<std::string>());
+
+	auto const mod = ModuleInterface::find(dir.string(), "lighting");
+	ASSERT_NE(mod, nullptr);
+
+	//Declared once per set of dynamic types
+	auto const first = mod->headers(cs);
+	EXPECT_EQ(mod->headers(cs), first);
+	EXPECT_TRUE(first->errors.empty());
+
+	auto fp16 = new_sptr<CompilerSettings>(*cs);
+	fp16->dynTypes["FP"] = "fp16";
+
+	EXPECT_NE(mod->headers(fp16), first);
+	EXPECT_EQ(mod->headers(fp16), mod->headers(fp16));
+
+	//Compiles importing it still work off the shared headers
+	for (int i = 0; i < 2; ++i)
+	{
+		auto const result = compiler.compileSrcShaders(IMPORTER_SRC, "TestShader");
+		EXPECT_EQ(result.errors, std::vector<std::string>());
+	}
+
+	fs::remove_all(dir);
+
+}
+
+TEST(ModuleTests, ReplaceLoadedModule)
+{
+	auto const dir = freshDir("ReplaceLoadedModule");
+	auto const path = moduleFilePath(dir.string(), "lighting");
+
+	CompilerSettings cs;
+	cs.moduleDir = dir.string();
+
+	Compiler compiler(cs);
+
+	ASSERT_EQ(compiler.compileModule(LIB_SRC, path), std::vector<std::string>());
+
+	//Loaded, and held on to, while the file is replaced
+	auto const before = ModuleInterface::find(dir.string(), "lighting");
+	ASSERT_NE(before, nullptr);
+	EXPECT_TRUE(compiler.compileSrcShaders(IMPORTER_SRC, "TestShader").success());
+
+	//Renames over the loaded file, which has to work wherever modules are kept loaded
+	ASSERT_EQ(compiler.compileModule("module lighting;\n", path), std::vector<std::string>());
+
+	auto const after = ModuleInterface::find(dir.string(), "lighting");
+	ASSERT_NE(after, nullptr);
+	EXPECT_NE(after, before);
+
+	//The old module is still whole, and the new one is what gets imported
+	EXPECT_NE(before->text.find("def pick"), std::string_view::npos);
+	EXPECT_FALSE(compiler.compileSrcShaders(IMPORTER_SRC, "TestShader").success());
+
+	fs::remove_all(dir);
+
+}
@@ -0,0 +1,334 @@
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Everything is compiled into the test, so don't import from the DLL
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+#include "program.h"
+
+using namespace caliburn;
+
+//Three declarations, the last of which has a type error, so there's a position to check after every edit
+static const std::string EDIT_SRC = R"(type FP = fp32;
+
+shader First
+{
+	vec4 frag_color;
+
+	def vertex(vec4 v, vec4 c): vec4
+	{
+		frag_color = c;
+		return v;
+	};
+
+	def frag(): vec4
+	{
+		return frag_color;
+	};
+
+};
+
+shader Second
+{
+	def frag(): vec4
+	{
+		return missing_value;
+	};
+
+};
+)";
+
+/*
+Every field of a diagnostic, so that two lists can be compared in one go.
+*/
+static std::vector<std::string> describe(const std::vector<Diagnostic>& diags)
+{
+	std::vector<std::string> out;
+
+	for (auto const& d : diags)
+	{
+		std::stringstream ss;
+
+		ss << (int)d.stage << ' ' << d.message << " @";
+
+		if (d.hasLocation)
+		{
+			ss << d.startLine << ':' << d.startColumn << '-' << d.endLine << ':' << d.endColumn;
+		}
+
+		if (d.hasContext)
+		{
+			ss << " in " << d.contextLine;
+		}
+
+		out.push_back(ss.str());
+	}
+
+	return out;
+}
+
+/*
+Makes an edit out of the text to find, and what to replace it with.
+*/
+static TextEdit makeEdit(in<std::string> src, in<std::string> find, in<std::string> replace, out<std::string> edited)
+{
+	auto const offset = src.find(find);
+
+	EXPECT_NE(offset, std::string::npos) << find;
+
+	edited = src.substr(0, offset) + replace + src.substr(offset + find.length());
+
+	return TextEdit{ offset, find.length(), replace.length() };
+}
+
+/*
+Reprepares the edited source, and checks that it came out the same as preparing it from scratch would have.
+*/
+static std::shared_ptr<const PreparedProgram> expectSameAsFresh(out<Compiler> compiler, in<std::shared_ptr<const PreparedProgram>> prev, in<std::string> src, in<TextEdit> edit)
+{
+	auto const re = compiler.reprepare(prev, src, edit);
+	auto const fresh = compiler.prepare(src);
+
+	EXPECT_EQ(re->success(), fresh->success());
+	EXPECT_EQ(describe(re->errors), describe(fresh->errors));
+	EXPECT_EQ(describe(re->headerErrors), describe(fresh->headerErrors));
+
+	EXPECT_EQ(re->tokens.offsets, fresh->tokens.offsets);
+	EXPECT_EQ(re->tokens.lengths, fresh->tokens.lengths);
+	EXPECT_EQ(re->tokens.types, fresh->tokens.types);
+
+	EXPECT_EQ(re->ast.size(), fresh->ast.size());
+	EXPECT_EQ(re->decls.size(), fresh->decls.size());
+
+	for (size_t i = 0; i < std::min(re->decls.size(), fresh->decls.size()); ++i)
+	{
+		EXPECT_EQ(re->decls[i].startByte, fresh->decls[i].startByte) << "Declaration " << i;
+		EXPECT_EQ(re->decls[i].firstToken, fresh->decls[i].firstToken) << "Declaration " << i;
+	}
+
+	//Errors from reused declarations have to land where they are now, not where they were first parsed
+	EXPECT_EQ(describe(compiler.checkPrepared(re)), describe(compiler.checkPrepared(fresh)));
+
+	return re;
+}
+
+TEST(ProgramTests, RepreparePrepareSame)
+{
+	Compiler compiler;
+
+	auto const prev = compiler.prepare(EDIT_SRC);
+	ASSERT_TRUE(prev->success());
+
+	//Stops at the type error in Second, so every edit below has to move it
+	ASSERT_FALSE(compiler.checkPrepared(prev).empty());
+
+	std::string src;
+
+	//Before a declaration
+	auto edit = makeEdit(EDIT_SRC, "shader Second", "//A comment\nshader Second", src);
+	expectSameAsFresh(compiler, prev, src, edit);
+
+	edit = makeEdit(EDIT_SRC, "type FP", "type Unused = fp32;\ntype FP", src);
+	expectSameAsFresh(compiler, prev, src, edit);
+
+	//Inside one
+	edit = makeEdit(EDIT_SRC, "return v;", "return c;", src);
+	expectSameAsFresh(compiler, prev, src, edit);
+
+	//After the last one
+	std::string const after = "\ntype After = fp32;\n";
+	expectSameAsFresh(compiler, prev, EDIT_SRC + after, TextEdit{ EDIT_SRC.length(), 0, after.length() });
+
+}
+
+TEST(ProgramTests, ReprepareNewline)
+{
+	Compiler compiler;
+
+	auto const prev = compiler.prepare(EDIT_SRC);
+	ASSERT_TRUE(prev->success());
+
+	std::string src;
+
+	//Second is reused, but is now a line further down, as is its error
+	auto const edit = makeEdit(EDIT_SRC, "\t\treturn v;", "\n\t\treturn v;", src);
+	auto const re = expectSameAsFresh(compiler, prev, src, edit);
+
+	auto const before = compiler.checkPrepared(prev);
+	auto const after = compiler.checkPrepared(re);
+
+	ASSERT_FALSE(before.empty());
+	ASSERT_FALSE(after.empty());
+	EXPECT_EQ(after[0].startLine, before[0].startLine + 1);
+
+	//The other way, from the edited program back
+	std::string back;
+	auto const undo = makeEdit(src, "\n\t\treturn v;", "\t\treturn v;", back);
+
+	ASSERT_EQ(back, EDIT_SRC);
+	expectSameAsFresh(compiler, re, back, undo);
+
+}
+
+TEST(ProgramTests, ReprepareJoinsTokens)
+{
+	Compiler compiler;
+
+	auto const prev = compiler.prepare(EDIT_SRC);
+	ASSERT_TRUE(prev->success());
+
+	std::string src;
+
+	//v and c become one argument named vc, so First now has errors of its own
+	auto const edit = makeEdit(EDIT_SRC, "v, vec4 c)", "vc)", src);
+	expectSameAsFresh(compiler, prev, src, edit);
+
+	//Leaves nothing between a declaration and the one before it
+	auto const joined = makeEdit(EDIT_SRC, "};\n\nshader Second", "};shader Second", src);
+	expectSameAsFresh(compiler, prev, src, joined);
+
+}
+
+TEST(ProgramTests, ReprepareInvalidEdit)
+{
+	Compiler compiler;
+
+	auto const prev = compiler.prepare(EDIT_SRC);
+	ASSERT_TRUE(prev->success());
+
+	std::string src;
+	auto edit = makeEdit(EDIT_SRC, "return v;", "return c;", src);
+
+	//Says more was inserted than was, so it has to be prepared from scratch
+	edit.inserted += 1;
+
+	auto const re = expectSameAsFresh(compiler, prev, src, edit);
+	EXPECT_TRUE(re->retained.empty());
+
+	//Runs off the end of the old source
+	edit = TextEdit{ EDIT_SRC.length(), 10, 0 };
+	expectSameAsFresh(compiler, prev, EDIT_SRC, edit);
+
+}
+
+TEST(ProgramTests, ReprepareRetainLimit)
+{
+	Compiler compiler;
+
+	auto prog = compiler.prepare(EDIT_SRC);
+	auto src = EDIT_SRC;
+
+	bool startedOver = false;
+
+	for (int i = 0; i < 40; ++i)
+	{
+		//A newline before First every time, so Second keeps being reused from further and further back
+		std::string edited;
+		auto const edit = makeEdit(src, "shader First", "\nshader First", edited);
+		auto const next = expectSameAsFresh(compiler, prog, edited, edit);
+
+		EXPECT_LE(next->retained.size(), 32);
+
+		if (next->retained.empty())
+		{
+			startedOver = true;
+		}
+
+		prog = next;
+		src = edited;
+
+	}
+
+	EXPECT_TRUE(startedOver);
+
+}
+
+static const std::string DYN_SRC = R"(
+type FP = dynamic<fp32>;
+
+shader TestShader
+{
+	vec4 frag_color;
+
+	def vertex(vec4<FP> v, vec4 c): vec4<FP>
+	{
+		frag_color = c;
+		return v;
+	};
+
+	def frag(): vec4
+	{
+		return frag_color;
+	};
+
+};
+)";
+
+static void expectSameCode(const ShaderResult& expected, const ShaderResult& actual)
+{
+	EXPECT_EQ(actual.errors, expected.errors);
+	ASSERT_EQ(actual.shaders.size(), expected.shaders.size());
+
+	for (size_t i = 0; i < expected.shaders.size(); ++i)
+	{
+		EXPECT_EQ(actual.shaders[i]->type, expected.shaders[i]->type);
+		EXPECT_EQ(actual.shaders[i]->code, expected.shaders[i]->code);
+	}
+
+}
+
+TEST(ProgramTests, CompilePermutations)
+{
+	CompilerSettings fp32;
+	fp32.dynTypes["FP"] = "fp32";
+
+	auto fp16 = fp32;
+	fp16.dynTypes["FP"] = "fp16";
+
+	auto optimized = fp32;
+	optimized.o = OptimizeLevel::PERFORMANCE;
+
+	Compiler compiler(fp32);
+
+	auto const program = compiler.prepare(DYN_SRC);
+	ASSERT_TRUE(program->success());
+
+	auto const tokenCount = program->tokens.types.size();
+	auto const astSize = program->ast.size();
+
+	std::vector<CompilerSettings> const permutations = { fp32, fp16, optimized };
+	auto const results = compiler.compilePermutations(program, { "TestShader" }, permutations);
+
+	ASSERT_EQ(results.size(), permutations.size());
+
+	//In the same order as the permutations, and the same as compiling from scratch with each one's settings
+	for (size_t i = 0; i < permutations.size(); ++i)
+	{
+		ASSERT_EQ(results[i].count("TestShader"), 1) << "Permutation " << i;
+		EXPECT_TRUE(results[i].at("TestShader").success()) << "Permutation " << i;
+
+		expectSameCode(Compiler(permutations[i]).compileSrcShaders(DYN_SRC, "TestShader"), results[i].at("TestShader"));
+
+	}
+
+	EXPECT_NE(results[0].at("TestShader").shaders[0]->code, results[1].at("TestShader").shaders[0]->code);
+
+	//Compiling only reads the program, so it can be used again, and still gives the same results
+	EXPECT_EQ(program->tokens.types.size(), tokenCount);
+	EXPECT_EQ(program->ast.size(), astSize);
+	EXPECT_EQ(program->headerDynTypes, fp32.dynTypes);
+
+	auto const again = compiler.compilePermutations(program, {}, { fp16 });
+
+	ASSERT_EQ(again.size(), 1);
+	ASSERT_EQ(again[0].count("TestShader"), 1);
+	expectSameCode(results[1].at("TestShader"), again[0].at("TestShader"));
+
+	expectSameCode(results[0].at("TestShader"), compiler.compilePrepared(program, { "TestShader" }).at("TestShader"));
+
+}
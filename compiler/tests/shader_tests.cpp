@@ -0,0 +1,583 @@
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+//Everything is compiled into the test, so don't import from the DLL
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+#include "cllr/cllrasm.h"
+#include "cllr/cllrtype.h"
+#include "cllr/cllrvalid.h"
+#include "error.h"
+#include "spirv/spirv.h"
+#include "threadpool.h"
+
+using namespace caliburn;
+
+/*
+The Location of every Input and Output variable in a SPIR-V module, split by storage class.
+*/
+struct SpvLocations
+{
+	std::multiset<uint32_t> inputs;
+	std::multiset<uint32_t> outputs;
+
+};
+
+static SpvLocations findLocations(const std::vector<uint32_t>& code)
+{
+	std::map<uint32_t, spirv::StorageClass> varClasses;
+	std::map<uint32_t, uint32_t> locations;
+
+	//Skips the 5 word header
+	for (size_t i = 5; i < code.size();)
+	{
+		auto const op = spirv::SpvOp(code[i]);
+
+		if (op.words == 0 || i + op.words > code.size())
+		{
+			ADD_FAILURE() << "Malformed SPIR-V instruction at word " << i;
+			break;
+		}
+
+		if (op.op == spirv::OpVariable(0).op)
+		{
+			varClasses[code[i + 2]] = spirv::StorageClass(code[i + 3]);
+		}
+		else if (op.op == spirv::OpDecorate(0).op && spirv::Decoration(code[i + 2]) == spirv::Decoration::Location)
+		{
+			locations[code[i + 1]] = code[i + 3];
+		}
+
+		i += op.words;
+	}
+
+	SpvLocations out;
+
+	for (auto const& [id, loc] : locations)
+	{
+		auto const sc = varClasses.find(id);
+
+		if (sc == varClasses.end())
+		{
+			continue;
+		}
+
+		if (sc->second == spirv::StorageClass::Input)
+		{
+			out.inputs.insert(loc);
+		}
+		else if (sc->second == spirv::StorageClass::Output)
+		{
+			out.outputs.insert(loc);
+		}
+
+	}
+
+	return out;
+}
+
+TEST(ShaderTests, IOLocationsPerInterface)
+{
+	//The varyings are declared in one order and written in another, so the stages only agree if they go by name
+	auto const src = R"(
+shader TestShader
+{
+	vec4 frag_normal;
+	vec4 frag_color;
+
+	def vertex(vec4 v, vec4 c, vec4 n): vec4
+	{
+		frag_color = c;
+		frag_normal = n;
+		return v;
+	};
+
+	def frag(): vec4
+	{
+		return frag_color;
+	};
+
+};
+)";
+
+	Compiler compiler;
+
+	auto const result = compiler.compileSrcShaders(src, "TestShader");
+	ASSERT_TRUE(result.success());
+	ASSERT_EQ(result.shaders.size(), 2);
+
+	auto const& vertex = *result.shaders[0];
+	auto const& frag = *result.shaders[1];
+
+	ASSERT_EQ(vertex.type, ShaderType::VERTEX);
+	ASSERT_EQ(frag.type, ShaderType::FRAGMENT);
+
+	//Vertex attributes start at 0, whatever the varyings are numbered as
+	std::multiset<uint32_t> attribs;
+
+	for (auto const& attrib : vertex.inputs)
+	{
+		attribs.insert(attrib.location);
+	}
+
+	EXPECT_EQ(attribs, (std::multiset<uint32_t>{ 0, 1, 2 }));
+
+	auto const vtxLocs = findLocations(vertex.code);
+	auto const fragLocs = findLocations(frag.code);
+
+	EXPECT_EQ(vtxLocs.inputs, attribs);
+	//Varyings follow declaration order, so frag_color is at 1 in both stages
+	EXPECT_EQ(vtxLocs.outputs, (std::multiset<uint32_t>{ 0, 1 }));
+	EXPECT_EQ(fragLocs.inputs, (std::multiset<uint32_t>{ 1 }));
+	//Just the returned colour
+	EXPECT_EQ(fragLocs.outputs, (std::multiset<uint32_t>{ 0 }));
+
+}
+
+/*
+Validates a vertex stage which assigns a float to whatever makeDest() declares.
+*/
+static bool validateAssignTo(std::function<cllr::SSA(out<cllr::Assembler>, sptr<cllr::LowType>)> makeDest)
+{
+	auto cs = new_sptr<CompilerSettings>();
+	cs->vLvl = ValidationLevel::FULL;
+
+	auto codeAsm = cllr::Assembler(ShaderType::VERTEX, cs);
+
+	auto floatType = cllr::Instruction(cllr::Opcode::TYPE_FLOAT, { 32 });
+	auto const type = codeAsm.pushType(floatType);
+
+	auto const dest = makeDest(codeAsm, type);
+
+	auto lit = cllr::Instruction(cllr::Opcode::VALUE_LIT_FP, { 0 });
+	auto const value = codeAsm.pushValue(lit, type);
+
+	codeAsm.push(cllr::Instruction(cllr::Opcode::ASSIGN, {}, { dest, value.value }));
+
+	return cllr::Validator(cs).validate(codeAsm);
+}
+
+TEST(ShaderTests, AssignTargets)
+{
+	EXPECT_TRUE(validateAssignTo([](out<cllr::Assembler> codeAsm, sptr<cllr::LowType> type)
+	{
+		return codeAsm.pushIOVar("color", ShaderIOVarType::OUTPUT, type).value;
+	}));
+
+	EXPECT_FALSE(validateAssignTo([](out<cllr::Assembler> codeAsm, sptr<cllr::LowType> type)
+	{
+		return codeAsm.pushIOVar("position", ShaderIOVarType::INPUT, type).value;
+	}));
+
+	EXPECT_FALSE(validateAssignTo([](out<cllr::Assembler> codeAsm, sptr<cllr::LowType> type)
+	{
+		auto desc = cllr::Instruction(cllr::Opcode::VAR_DESCRIPTOR, {}, { type->id });
+		return codeAsm.pushNew(desc);
+	}));
+
+}
+
+TEST(ShaderTests, AssignToVertexInput)
+{
+	auto const src = R"(
+shader TestShader
+{
+	def vertex(vec4 v, vec4 c): vec4
+	{
+		v = c;
+		return v;
+	};
+
+};
+)";
+
+	Compiler compiler;
+
+	auto const result = compiler.compileSrcShaders(src, "TestShader");
+	ASSERT_FALSE(result.success());
+	ASSERT_FALSE(result.diagnostics.empty());
+	EXPECT_NE(result.diagnostics[0].message.find("Vertex input"), std::string::npos);
+
+}
+
+TEST(ShaderTests, TakeCode)
+{
+	auto const src = R"(
+shader TestShader
+{
+	def vertex(vec4 v): vec4
+	{
+		return v;
+	};
+
+};
+)";
+
+	Compiler compiler;
+
+	auto result = compiler.compileSrcShaders(src, "TestShader");
+	ASSERT_TRUE(result.success());
+	ASSERT_EQ(result.shaders.size(), 1);
+
+	auto const expected = result.shaders[0]->code;
+	auto const taken = std::move(result).takeCode(0);
+
+	EXPECT_EQ(taken, expected);
+	EXPECT_TRUE(result.shaders[0]->code.empty());
+
+}
+
+static const std::string CLLR_SRC = R"(
+shader TestShader
+{
+	vec4 frag_color;
+
+	def vertex(vec4 v, vec4 c): vec4
+	{
+		frag_color = c;
+		return v;
+	};
+
+	def frag(): vec4
+	{
+		return frag_color;
+	};
+
+};
+)";
+
+TEST(ShaderTests, StagesCompileInParallel)
+{
+	//ShaderStmt::compile() hands its stages to ThreadPool::forEach(); Each call here waits for the other to start, so
+	//they can only both get through if they run at the same time
+	ThreadPool pool(2);
+
+	std::mutex lock;
+	std::condition_variable arrived;
+	size_t started = 0;
+	std::vector<bool> metOther(2, false);
+
+	pool.forEach(2, [&](size_t i)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+
+		++started;
+		arrived.notify_all();
+
+		//Timed, so that running them one after another fails instead of hanging
+		metOther[i] = arrived.wait_for(guard, std::chrono::seconds(10), [&]() { return started == 2; });
+
+	});
+
+	EXPECT_TRUE(metOther[0]);
+	EXPECT_TRUE(metOther[1]);
+
+	CompilerSettings cs;
+	cs.workerThreads = 2;
+
+	Compiler compiler(cs);
+
+	auto const result = compiler.compileSrcShaders(CLLR_SRC, "TestShader");
+	ASSERT_TRUE(result.success());
+	ASSERT_EQ(result.shaders.size(), 2);
+
+	//Still in pipeline order, whichever stage finished first
+	EXPECT_EQ(result.shaders[0]->type, ShaderType::VERTEX);
+	EXPECT_EQ(result.shaders[1]->type, ShaderType::FRAGMENT);
+
+}
+
+TEST(ShaderTests, CLLRRoundTrip)
+{
+	CompilerSettings cs;
+	cs.emitCLLR = true;
+
+	Compiler compiler(cs);
+
+	auto const result = compiler.compileSrcShaders(CLLR_SRC, "TestShader");
+	ASSERT_TRUE(result.success());
+	ASSERT_EQ(result.shaders.size(), 2);
+
+	for (auto const& shader : result.shaders)
+	{
+		ASSERT_FALSE(shader->cllr.empty());
+
+		auto const lowered = compiler.lowerCLLR(shader->cllr);
+		ASSERT_TRUE(lowered.success()) << (lowered.errors.empty() ? "" : lowered.errors[0]);
+		ASSERT_EQ(lowered.shaders.size(), 1);
+
+		EXPECT_EQ(lowered.shaders[0]->type, shader->type);
+		EXPECT_EQ(lowered.shaders[0]->code, shader->code);
+		EXPECT_EQ(lowered.shaders[0]->inputs.size(), shader->inputs.size());
+
+	}
+
+}
+
+TEST(ShaderTests, CLLRCorrupt)
+{
+	CompilerSettings cs;
+	cs.emitCLLR = true;
+
+	Compiler compiler(cs);
+
+	auto const result = compiler.compileSrcShaders(CLLR_SRC, "TestShader");
+	ASSERT_TRUE(result.success());
+
+	auto const& cllr = result.shaders[0]->cllr;
+
+	//Every cut has to fail cleanly
+	for (size_t cut = 0; cut < cllr.size(); ++cut)
+	{
+		auto const lowered = compiler.lowerCLLR(std::vector<uint8_t>(cllr.begin(), cllr.begin() + cut));
+		EXPECT_FALSE(lowered.success()) << "Lowered CLLR cut to " << cut << " bytes";
+		EXPECT_TRUE(lowered.shaders.empty());
+
+	}
+
+	//Damaged bytes may happen to still make valid code, but must never crash the backend
+	for (size_t i = 0; i < cllr.size(); ++i)
+	{
+		for (uint8_t const flip : { 0x01, 0x80, 0xFF })
+		{
+			auto damaged = cllr;
+			damaged[i] ^= flip;
+
+			auto const lowered = compiler.lowerCLLR(damaged);
+			EXPECT_EQ(lowered.success(), !lowered.shaders.empty());
+
+		}
+
+	}
+
+}
+
+//Two shaders, one of which doesn't compile, so one frontend pass has to give separate results for each
+static const std::string MULTI_SRC = R"(
+shader Good
+{
+	def vertex(vec4 v, vec4 c): vec4
+	{
+		return v;
+	};
+
+};
+
+shader Bad
+{
+	def frag(): vec4
+	{
+		return missing_value;
+	};
+
+};
+)";
+
+TEST(ShaderTests, CompileAllShaders)
+{
+	Compiler compiler;
+
+	auto const results = compiler.compileAllShaders(MULTI_SRC);
+
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_EQ(results.count("Good"), 1);
+	ASSERT_EQ(results.count("Bad"), 1);
+
+	EXPECT_TRUE(results.at("Good").success());
+	EXPECT_FALSE(results.at("Bad").success());
+
+	//Same as compiling each one on its own
+	auto const good = compiler.compileSrcShaders(MULTI_SRC, "Good");
+	ASSERT_EQ(results.at("Good").shaders.size(), good.shaders.size());
+
+	for (size_t i = 0; i < good.shaders.size(); ++i)
+	{
+		EXPECT_EQ(results.at("Good").shaders[i]->code, good.shaders[i]->code);
+	}
+
+	EXPECT_EQ(results.at("Bad").errors, compiler.compileSrcShaders(MULTI_SRC, "Bad").errors);
+
+	//A source which doesn't parse only has the one result, under an empty name
+	auto const broken = compiler.compileAllShaders("shader Broken {");
+
+	ASSERT_EQ(broken.size(), 1);
+	ASSERT_EQ(broken.count(""), 1);
+	EXPECT_FALSE(broken.at("").success());
+
+	//Even if some shaders were parsed before the error
+	auto const partial = compiler.compileAllShaders(MULTI_SRC + "\nshader Broken {");
+
+	ASSERT_EQ(partial.size(), 1);
+	ASSERT_EQ(partial.count(""), 1);
+	EXPECT_FALSE(partial.at("").success());
+
+}
+
+TEST(ShaderTests, CompileShadersEmptyName)
+{
+	Compiler compiler;
+
+	//The empty name doesn't stop the others from being compiled
+	auto const results = compiler.compileShaders(MULTI_SRC, { "Good", "", "Bad", "Missing" });
+
+	ASSERT_EQ(results.size(), 4);
+	EXPECT_TRUE(results.at("Good").success());
+	EXPECT_FALSE(results.at("").success());
+	EXPECT_FALSE(results.at("Bad").success());
+	EXPECT_FALSE(results.at("Missing").success());
+
+	//A source which doesn't parse still gives every requested name a result
+	auto const broken = compiler.compileShaders(MULTI_SRC + "\nshader Broken {", { "Good", "Bad" });
+
+	ASSERT_EQ(broken.size(), 2);
+	EXPECT_FALSE(broken.at("Good").success());
+	EXPECT_FALSE(broken.at("Bad").success());
+
+}
+
+static bool statsEmpty(const CompileStats& s)
+{
+	return s.tokenizerNs == 0 && s.parserNs == 0 && s.symbolGenNs == 0 && s.cllrEmitNs == 0 && s.cllrValidationNs == 0
+		&& s.optimizationNs == 0 && s.outEmitNs == 0 && s.tokens == 0 && s.astNodes == 0 && s.cllrInstructions == 0
+		&& s.ssaIDs == 0 && s.spirvWords == 0 && s.genericInstances == 0;
+}
+
+TEST(ShaderTests, StatsOnlyWhenCollected)
+{
+	Compiler quiet;
+
+	auto const plain = quiet.compileSrcShaders(CLLR_SRC, "TestShader");
+	ASSERT_TRUE(plain.success());
+	EXPECT_TRUE(statsEmpty(plain.stats));
+
+	EXPECT_TRUE(statsEmpty(quiet.compilePrepared(quiet.prepare(CLLR_SRC), { "TestShader" }).at("TestShader").stats));
+
+	CompilerSettings cs;
+	cs.collectStats = true;
+
+	Compiler counting(cs);
+
+	auto const result = counting.compileSrcShaders(CLLR_SRC, "TestShader");
+	ASSERT_TRUE(result.success());
+
+	auto const& stats = result.stats;
+
+	EXPECT_GT(stats.tokens, 0);
+	EXPECT_GT(stats.astNodes, 0);
+	EXPECT_GT(stats.cllrInstructions, 0);
+	EXPECT_GT(stats.ssaIDs, 0);
+
+	//Timings can come out as 0 on a coarse clock, but the whole compile can't
+	EXPECT_GT(stats.tokenizerNs + stats.parserNs + stats.symbolGenNs + stats.cllrEmitNs + stats.cllrValidationNs + stats.optimizationNs + stats.outEmitNs, 0);
+
+	//Summed across both stages
+	size_t words = 0;
+
+	for (auto const& shader : result.shaders)
+	{
+		words += shader->code.size();
+	}
+
+	EXPECT_EQ(stats.spirvWords, words);
+
+	//The frontend only ran once, so every shader from the same program gets the same numbers for it
+	auto const program = counting.prepare(CLLR_SRC);
+	auto const first = counting.compilePrepared(program, { "TestShader" });
+	auto const second = counting.compilePrepared(program, { "TestShader" });
+
+	EXPECT_GT(first.at("TestShader").stats.tokens, 0);
+	EXPECT_EQ(first.at("TestShader").stats.tokenizerNs, second.at("TestShader").stats.tokenizerNs);
+	EXPECT_EQ(first.at("TestShader").stats.parserNs, second.at("TestShader").stats.parserNs);
+
+}
+
+TEST(ShaderTests, MaxErrors)
+{
+	auto capped = new_sptr<CompilerSettings>();
+	capped->maxErrors = 3;
+
+	ErrorHandler errs(CompileStage::PARSER, capped);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		//Dropped errors still take notes, they just go nowhere
+		errs.err(std::string("Error ") + std::to_string(i), Token())->note("A note");
+	}
+
+	EXPECT_TRUE(errs.isFull());
+	EXPECT_EQ(errs.errors.size(), 3);
+
+	std::vector<Diagnostic> diags;
+	errs.report(diags);
+
+	ASSERT_EQ(diags.size(), 4);
+
+	for (size_t i = 0; i < 3; ++i)
+	{
+		EXPECT_EQ(diags[i].message, "Error " + std::to_string(i));
+		EXPECT_EQ(diags[i].notes.size(), 1);
+	}
+
+	//The summary comes last, and counts everything that didn't make it in
+	EXPECT_EQ(diags[3].message, "Too many errors; Stopped after 3, and 7 more were dropped");
+	EXPECT_EQ(diags[3].stage, CompileStage::PARSER);
+
+	//0 is no limit, so there's nothing to summarize
+	auto unlimited = new_sptr<CompilerSettings>();
+	unlimited->maxErrors = 0;
+
+	ErrorHandler all(CompileStage::PARSER, unlimited);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		all.err(std::string("Error ") + std::to_string(i), Token());
+	}
+
+	EXPECT_FALSE(all.isFull());
+
+	diags.clear();
+	all.report(diags);
+
+	EXPECT_EQ(diags.size(), 10);
+
+}
+
+TEST(ShaderTests, ThrowingCallback)
+{
+	CompilerSettings cs;
+	cs.workerThreads = 1;
+
+	Compiler compiler(cs);
+
+	//Thrown on the only worker, which has to survive it to run the next compile
+	compiler.compileAsync(CLLR_SRC, "TestShader", [](ShaderResult)
+	{
+		throw std::runtime_error("Thrown from a callback");
+	});
+
+	auto const result = compiler.compileAsync(CLLR_SRC, "TestShader").get();
+	EXPECT_TRUE(result.success());
+
+	ThreadPool pool(1);
+
+	pool.submit([]()
+	{
+		throw std::runtime_error("Thrown from a task");
+	});
+
+	std::promise<bool> ran;
+	pool.submit([&]() { ran.set_value(true); });
+
+	EXPECT_TRUE(ran.get_future().get());
+
+}
@@ -0,0 +1,145 @@
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+//Everything is compiled into the test, so don't import from the DLL
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+#include "program.h"
+#include "source.h"
+
+using namespace caliburn;
+
+namespace fs = std::filesystem;
+
+/*
+Makes an empty directory, unique to the test.
+*/
+static fs::path freshDir(const std::string& testName)
+{
+	auto const dir = fs::temp_directory_path() / ("caliburn_test_sources_" + testName);
+
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	return dir;
+}
+
+static std::string writeSource(const fs::path& dir, const std::string& name, const std::string& src)
+{
+	auto const path = (dir / name).string();
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	file << src;
+
+	return path;
+}
+
+static const std::string FILE_SRC = R"(
+shader TestShader
+{
+	def vertex(vec4 v): vec4
+	{
+		return v;
+	};
+
+};
+)";
+
+TEST(SourceTests, OwnedSource)
+{
+	std::string src = "type FP = fp32;";
+	OwnedSource owned(src);
+
+	//A copy, so changing the original changes nothing
+	src[0] = 'X';
+
+	EXPECT_EQ(owned.text(), "type FP = fp32;");
+	EXPECT_NE(owned.text().data(), src.data());
+
+	OwnedSource moved(std::string("moved"));
+	EXPECT_EQ(moved.text(), "moved");
+
+	EXPECT_TRUE(OwnedSource(std::string()).text().empty());
+
+}
+
+TEST(SourceTests, ViewSource)
+{
+	std::string const src = "type FP = fp32;";
+	ViewSource view(src);
+
+	//No copy at all
+	EXPECT_EQ(view.text().data(), src.data());
+	EXPECT_EQ(view.text().size(), src.size());
+
+	EXPECT_TRUE(ViewSource(std::string_view()).text().empty());
+
+}
+
+TEST(SourceTests, MappedFile)
+{
+	auto const dir = freshDir("MappedFile");
+	auto const path = writeSource(dir, "shader.cbrn", FILE_SRC);
+
+	auto mapped = MappedFile::open(path);
+
+	ASSERT_NE(mapped, nullptr);
+	EXPECT_EQ(mapped->text(), FILE_SRC);
+
+	//Nothing to map, but still a valid, empty source
+	auto empty = MappedFile::open(writeSource(dir, "empty.cbrn", ""));
+
+	ASSERT_NE(empty, nullptr);
+	EXPECT_TRUE(empty->text().empty());
+
+	EXPECT_EQ(MappedFile::open((dir / "missing.cbrn").string()), nullptr);
+
+	//Directories, and anything else which isn't a regular file, can't be mapped
+	EXPECT_EQ(MappedFile::open(dir.string()), nullptr);
+
+	//Windows won't delete files which are still open
+	mapped = nullptr;
+	empty = nullptr;
+
+	fs::remove_all(dir);
+
+}
+
+TEST(SourceTests, MappedFileLifetime)
+{
+	auto const dir = freshDir("MappedFileLifetime");
+	auto const path = writeSource(dir, "shader.cbrn", FILE_SRC);
+
+	Compiler compiler;
+
+	auto prog = compiler.prepareFile(path);
+
+	ASSERT_NE(prog, nullptr);
+	ASSERT_TRUE(prog->success());
+	EXPECT_EQ(prog->path, path);
+
+	//The program holds the only reference to the mapping, which has to stay valid for as long as the program does
+	EXPECT_EQ(prog->src->text(), FILE_SRC);
+
+#ifndef _WIN32
+	//The mapping keeps the contents alive on its own, even once the file's gone; Windows won't delete a mapped file
+	fs::remove(path);
+
+	EXPECT_EQ(prog->src->text(), FILE_SRC);
+#endif
+
+	auto const results = compiler.compilePrepared(prog, { "TestShader" });
+	EXPECT_TRUE(results.at("TestShader").success());
+
+	EXPECT_EQ(compiler.prepareFile((dir / "missing.cbrn").string()), nullptr);
+	EXPECT_FALSE(compiler.compileFileShaders((dir / "missing.cbrn").string(), "TestShader").success());
+
+	prog = nullptr;
+
+	fs::remove_all(dir);
+
+}
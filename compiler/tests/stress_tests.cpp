@@ -0,0 +1,199 @@
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+//Everything is compiled into the test, so don't import from the DLL
+#define CBRN_NO_IMPORT
+#include "caliburn.h"
+
+using namespace caliburn;
+
+/*
+These are meant to be run under ThreadSanitizer; Configure with -DCALIBURN_TSAN=ON. Without it, they still check that
+concurrent compiles give the same results as a single-threaded one.
+*/
+
+static constexpr size_t STRESS_THREADS = 32;
+static constexpr size_t STRESS_ITERATIONS = 8;
+
+static const std::string STRESS_SRC = R"(
+type FP = dynamic<fp32>;
+
+shader TestShader
+{
+	vec4 frag_color;
+
+	def vertex(vec4<FP> v, vec4 c): vec4<FP>
+	{
+		frag_color = c;
+		return v;
+	};
+
+	def frag(): vec4
+	{
+		return frag_color;
+	};
+
+};
+)";
+
+static CompilerSettings stressSettings()
+{
+	CompilerSettings cs;
+
+	cs.dynTypes["FP"] = "fp32";
+	//Otherwise most compiles would just be cache hits
+	cs.memCacheBytes = 0;
+	cs.workerThreads = 4;
+
+	return cs;
+}
+
+static void expectSameResult(const ShaderResult& expected, const ShaderResult& actual)
+{
+	EXPECT_EQ(expected.errors, actual.errors);
+	ASSERT_EQ(expected.shaders.size(), actual.shaders.size());
+
+	for (size_t i = 0; i < expected.shaders.size(); ++i)
+	{
+		EXPECT_EQ(expected.shaders[i]->type, actual.shaders[i]->type);
+		EXPECT_EQ(expected.shaders[i]->code, actual.shaders[i]->code);
+	}
+
+}
+
+/*
+Runs fn on STRESS_THREADS threads at once, STRESS_ITERATIONS times each.
+*/
+template<typename Fn>
+static void runConcurrently(Fn fn)
+{
+	std::atomic<bool> go = false;
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < STRESS_THREADS; ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			//Line everyone up first, so the compiles actually overlap
+			while (!go)
+			{
+				std::this_thread::yield();
+			}
+
+			for (size_t i = 0; i < STRESS_ITERATIONS; ++i)
+			{
+				fn(t, i);
+			}
+
+		});
+
+	}
+
+	go = true;
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+}
+
+TEST(StressTests, CompileSrcShaders)
+{
+	Compiler compiler(stressSettings());
+
+	auto const expected = compiler.compileSrcShaders(STRESS_SRC, "TestShader");
+
+	runConcurrently([&](size_t, size_t)
+	{
+		expectSameResult(expected, compiler.compileSrcShaders(STRESS_SRC, "TestShader"));
+	});
+
+}
+
+TEST(StressTests, CompileSrcShadersCached)
+{
+	auto cs = stressSettings();
+	cs.memCacheBytes = 1024 * 1024;
+
+	Compiler compiler(cs);
+
+	auto const expected = compiler.compileSrcShaders(STRESS_SRC, "TestShader");
+
+	runConcurrently([&](size_t t, size_t)
+	{
+		//Half the threads clear the cache, so that hits, misses, and clears all race each other
+		if (t % 2 == 0)
+		{
+			compiler.clearCache();
+		}
+
+		expectSameResult(expected, *compiler.compileSrcShadersCached(STRESS_SRC, "TestShader"));
+		compiler.getCacheStats();
+	});
+
+}
+
+TEST(StressTests, SharedPreparedProgram)
+{
+	Compiler compiler(stressSettings());
+
+	auto const program = compiler.prepare(STRESS_SRC);
+	auto const expected = compiler.compilePrepared(program, { "TestShader" });
+
+	auto fp16 = stressSettings();
+	fp16.dynTypes["FP"] = "fp16";
+
+	runConcurrently([&](size_t t, size_t)
+	{
+		//Odd threads use different dynamic types, which redeclares the headers
+		if (t % 2 == 0)
+		{
+			expectSameResult(expected.at("TestShader"), compiler.compilePrepared(program, { "TestShader" }).at("TestShader"));
+		}
+		else
+		{
+			compiler.compilePermutations(program, { "TestShader" }, { fp16, stressSettings() });
+		}
+
+	});
+
+}
+
+TEST(StressTests, CompileAsync)
+{
+	Compiler compiler(stressSettings());
+
+	auto const expected = compiler.compileSrcShaders(STRESS_SRC, "TestShader");
+
+	runConcurrently([&](size_t t, size_t)
+	{
+		CancelToken cancel;
+		auto future = compiler.compileAsync(STRESS_SRC, "TestShader", cancel);
+
+		//Some get cancelled partway through; Those have to come back cancelled, never half-done
+		if (t % 4 == 0)
+		{
+			cancel.cancel();
+		}
+
+		auto const result = future.get();
+
+		if (result.cancelled)
+		{
+			EXPECT_TRUE(result.shaders.empty());
+			EXPECT_FALSE(result.success());
+		}
+		else
+		{
+			expectSameResult(expected, result);
+		}
+
+	});
+
+}
@@ -0,0 +1,87 @@
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "charscan.h"
+#include "tokenizer.h"
+
+using namespace caliburn;
+
+/*
+Measures tokenizer throughput in MB/s on large generated shaders. Build in release mode; Debug builds are several times
+slower.
+
+Usage: CaliburnTokenizerBench [megabytes]
+*/
+
+static constexpr size_t DEFAULT_MB = 16;
+static constexpr size_t RUNS = 5;
+
+/*
+Repeats a shader-like chunk with a bit of everything in it: Indentation, comments, long and short identifiers, number
+literals, strings, and operators.
+*/
+static std::string makeSource(size_t bytes)
+{
+	std::stringstream ss;
+	size_t n = 0;
+
+	while (ss.tellp() < (std::streamoff)bytes)
+	{
+		ss << "#Helper number " << n << "; Does some lighting math, more or less. Comments tend to be long-ish.\n";
+		ss << "def light_contribution_" << n << "(vec3 surfaceNormal, vec3 lightDirection, fp32 intensity): fp32\n";
+		ss << "{\n";
+		ss << "\tvar: fp32 nDotL = dot(surfaceNormal, lightDirection);\n";
+		ss << "\tconst scale = 0x1F + 1.5e3 * intensity / 255;\n";
+		ss << "\tvar label = \"light number " << n << ", with an \\\"escaped\\\" quote\";\n";
+		ss << "\n";
+		ss << "\tif (nDotL <= 0.0f && intensity != 0)\n";
+		ss << "\t{\n";
+		ss << "\t\treturn 0.0f;\n";
+		ss << "\t};\n";
+		ss << "\n";
+		ss << "\treturn nDotL * scale;\n";
+		ss << "};\n\n";
+
+		++n;
+	}
+
+	return ss.str();
+}
+
+int main(int argc, char** argv)
+{
+	auto const mb = argc > 1 ? std::max<size_t>(1, std::stoul(argv[1])) : DEFAULT_MB;
+	auto const src = makeSource(mb * 1024 * 1024);
+
+	std::vector<double> rates;
+	size_t tokenCount = 0;
+
+	for (size_t i = 0; i < RUNS; ++i)
+	{
+		auto const doc = new_sptr<TextDoc>(src);
+		auto tokenizer = Tokenizer(doc);
+
+		auto const start = std::chrono::steady_clock::now();
+
+		tokenCount = tokenizer.tokenize().size();
+
+		auto const end = std::chrono::steady_clock::now();
+		auto const secs = std::chrono::duration<double>(end - start).count();
+
+		rates.push_back((src.size() / (1024.0 * 1024.0)) / secs);
+
+	}
+
+	std::sort(rates.begin(), rates.end());
+
+	std::cout << "Scanner: " << charScanImpl() << '\n';
+	std::cout << "Source: " << (src.size() / (1024 * 1024)) << " MB, " << tokenCount << " tokens\n";
+	std::cout << "Tokenizer: median " << rates[rates.size() / 2] << " MB/s, best " << rates.back() << " MB/s\n";
+
+	return 0;
+}
@@ -1,6 +1,7 @@
 
 #include <gtest/gtest.h>
 
+#include "tokencursor.h"
 #include "tokenizer.h"
 
 using namespace caliburn;
@@ -130,3 +131,94 @@ TEST(TokenTests, SmallShader)
     //no, we're not testing every token in the file, just pick one and call it a day.
     assertToken(tokens[49], "frag_color", TokenType::IDENTIFIER);
 }
+
+//Longer than a vector, so the SIMD scanners' tails get used too
+TEST(TokenTests, LongRuns)
+{
+    CBRN_TEST_TOKENIZE("a_very_long_identifier_spanning_more_than_one_vector \t\t\t                                          \r\n\r\n    next");
+    ASSERT_EQ(tokens.size(), 2);
+    assertToken(tokens[0], "a_very_long_identifier_spanning_more_than_one_vector", TokenType::IDENTIFIER);
+    assertToken(tokens[1], "next", TokenType::IDENTIFIER);
+    EXPECT_EQ(tokens[1].pos.line, 2);
+    EXPECT_EQ(tokens[1].pos.column, 4);
+}
+
+TEST(TokenTests, LongCommentsAndStrings)
+{
+    CBRN_TEST_TOKENIZE("# A comment which goes on for quite a while, with \"quotes\" and \\ in it\n\"a string which also goes on for quite a while\\\" before ending\" x");
+    ASSERT_EQ(tokens.size(), 2);
+    assertToken(tokens[0], "\"a string which also goes on for quite a while\\\" before ending\"", TokenType::LITERAL_STR);
+    assertToken(tokens[1], "x", TokenType::IDENTIFIER);
+    EXPECT_EQ(tokens[0].pos.line, 1);
+}
+
+TEST(TokenTests, NonASCIIIdentifier)
+{
+    CBRN_TEST_TOKENIZE("caf\xC3\xA9 x");
+    ASSERT_EQ(tokens.size(), 2);
+    assertToken(tokens[0], "caf\xC3\xA9", TokenType::IDENTIFIER);
+    assertToken(tokens[1], "x", TokenType::IDENTIFIER);
+}
+
+//Streaming pulls a few tokens at a time; They should be the same ones tokenize() makes
+TEST(TokenTests, TokenizeInChunks)
+{
+    CBRN_TEST_TOKENIZE("def frag(vec4 c) : vec4 { return c * 2.0; };");
+
+    Tokenizer chunked(doc);
+    TokenStream pulled(doc);
+
+    while (!chunked.done())
+    {
+        auto const before = pulled.size();
+        chunked.tokenizeUntil({}, pulled, 3);
+        ASSERT_LE(pulled.size() - before, 3);
+    }
+
+    ASSERT_EQ(pulled.size(), tokens.size());
+
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        assertToken(pulled[i], tokens[i].str, tokens[i].type);
+    }
+
+}
+
+//A streaming cursor lets go of old tokens, so going back further than it keeps has to fail loudly in every build
+TEST(TokenTests, CursorBeforeWindow)
+{
+    std::string src;
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        src += "x" + std::to_string(i) + " ";
+    }
+
+    auto doc = new_sptr<TextDoc>(src);
+    Tokenizer tokenizer(doc);
+    TokenCursor cursor(tokenizer);
+
+    for (size_t i = 0; i < 500; ++i)
+    {
+        cursor.take();
+    }
+
+    assertToken(cursor.peekBack(1), "x499", TokenType::IDENTIFIER);
+    EXPECT_THROW(cursor.peekBack(400), std::out_of_range);
+
+    //Unless a checkpoint holds on to them
+    Tokenizer again(doc);
+    TokenCursor pinned(again);
+
+    pinned.take();
+    auto const point = pinned.mark();
+
+    for (size_t i = 0; i < 500; ++i)
+    {
+        pinned.take();
+    }
+
+    pinned.revertTo(point);
+    assertToken(pinned.cur(), "x1", TokenType::IDENTIFIER);
+
+}
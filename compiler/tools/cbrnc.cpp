@@ -0,0 +1,617 @@
+
+/*
+cbrnc: Command-line batch compiler.
+
+Compiles any number of Caliburn sources in one process, so that startup and the standard library are only paid for
+once. Each distinct source is read and prepared once, then compiled once per job that uses it, across the compiler's
+pool of worker threads.
+
+Every source is prepared as part of one project, so sources starting with a module statement can be imported by the
+others. Errors found while preparing a source are reported once, and every job using it fails.
+
+Usage: cbrnc [options] [inputs...]
+
+Options:
+	-j N				Number of worker threads. Defaults to one per hardware thread.
+	-o DIR				Output directory. Defaults to the current directory.
+	-s NAME				Shader object to compile; Can be repeated. Defaults to every shader object in the source.
+	-p PREFIX			Prefix for output file names, after the output directory.
+	-O N				Optimization level, from 0 to 3.
+	-D INNER=CONCRETE	Sets a dynamic type.
+	-V LEVEL			Validation level: none, basic, full, or dev.
+	--cache-dir DIR		Persistent compilation cache to use; Reused between invocations.
+	--module-dir DIR	Where to find the interface files of imported modules.
+	--manifest FILE		Reads additional jobs from a file. See below.
+	--depfile FILE		Writes a single Makefile/Ninja depfile covering every output.
+	-MD					Writes a depfile next to each job's first output, named after it plus ".d".
+
+Depfiles list every input, every project source and module interface file those import, and any manifests. Output
+directories, and the depfile's directory, are made if they don't exist.
+
+Every shader stage is written to <dir>/<prefix><shader>.<stage>.spv, where stage is the usual Vulkan extension, such as
+vert or frag.
+
+A manifest has one job per line. Each line is an input path followed by any of the per-job options above (-o, -s, -p,
+-O, -D, -V), which apply on top of the ones given on the command line. Words are split on whitespace, with no
+quoting, so manifest paths can't contain spaces. Blank lines and lines starting with # are ignored. Inputs given on the
+command line are jobs with no extra options.
+
+Parsed sources are shared between every job in one invocation. To reuse work between invocations, use --cache-dir.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "caliburn.h"
+
+using namespace caliburn;
+
+namespace fs = std::filesystem;
+
+/*
+Everything which can differ between jobs.
+*/
+struct JobOptions
+{
+	std::string outDir = ".";
+	std::string prefix;
+	std::vector<std::string> shaders;
+	CompilerSettings settings;
+
+};
+
+struct Job
+{
+	std::string input;
+	JobOptions opts;
+
+	std::vector<std::string> outputs;
+	bool failed = false;
+
+};
+
+static const std::map<ShaderType, std::string> STAGE_EXTENSIONS = {
+	{ ShaderType::COMPUTE, "comp" },
+	{ ShaderType::VERTEX, "vert" },
+	{ ShaderType::FRAGMENT, "frag" },
+	{ ShaderType::TESS_CTRL, "tesc" },
+	{ ShaderType::TESS_EVAL, "tese" },
+	{ ShaderType::GEOMETRY, "geom" },
+	{ ShaderType::RT_GEN, "rgen" },
+	{ ShaderType::RT_CLOSE, "rchit" },
+	{ ShaderType::RT_ANY_HIT, "rahit" },
+	{ ShaderType::RT_INTERSECT, "rint" },
+	{ ShaderType::RT_MISS, "rmiss" },
+	{ ShaderType::TASK, "task" },
+	{ ShaderType::MESH, "mesh" }
+};
+
+static const std::map<std::string, ValidationLevel> VALIDATION_LEVELS = {
+	{ "none", ValidationLevel::NONE },
+	{ "basic", ValidationLevel::BASIC },
+	{ "full", ValidationLevel::FULL },
+	{ "dev", ValidationLevel::DEV }
+};
+
+static void usage()
+{
+	std::cerr << "Usage: cbrnc [-j N] [-o DIR] [-s NAME] [-p PREFIX] [-O N] [-D INNER=CONCRETE] [-V LEVEL]\n"
+		<< "             [--cache-dir DIR] [--module-dir DIR] [--manifest FILE] [--depfile FILE] [-MD] [inputs...]\n";
+}
+
+static bool readFile(const std::string& path, std::string& out)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << file.rdbuf();
+	out = ss.str();
+
+	return true;
+}
+
+/*
+Makefile and Ninja depfiles both need spaces escaped, and Make needs $ doubled.
+*/
+static std::string escapeDep(const std::string& path)
+{
+	std::string out;
+
+	for (auto c : path)
+	{
+		if (c == ' ' || c == '#')
+		{
+			out += '\\';
+		}
+		else if (c == '$')
+		{
+			out += '$';
+		}
+
+		out += c;
+	}
+
+	return out;
+}
+
+/*
+Parses one per-job option, starting at args[i]. Advances i past any option argument.
+
+Returns false, after complaining, if the option is invalid. Returns true without doing anything if the option isn't a
+per-job one, and sets handled accordingly.
+*/
+static bool parseJobOption(const std::vector<std::string>& args, size_t& i, JobOptions& opts, bool& handled)
+{
+	auto const& arg = args[i];
+	handled = true;
+
+	if (arg != "-o" && arg != "-s" && arg != "-p" && arg != "-O" && arg != "-D" && arg != "-V")
+	{
+		handled = false;
+		return true;
+	}
+
+	if (i + 1 >= args.size())
+	{
+		std::cerr << "cbrnc: " << arg << " needs an argument\n";
+		return false;
+	}
+
+	auto const& value = args[++i];
+
+	if (arg == "-o")
+	{
+		opts.outDir = value;
+	}
+	else if (arg == "-s")
+	{
+		opts.shaders.push_back(value);
+	}
+	else if (arg == "-p")
+	{
+		opts.prefix = value;
+	}
+	else if (arg == "-O")
+	{
+		if (value.size() != 1 || value[0] < '0' || value[0] > '3')
+		{
+			std::cerr << "cbrnc: Invalid optimization level: " << value << '\n';
+			return false;
+		}
+
+		opts.settings.o = (OptimizeLevel)(value[0] - '0');
+
+	}
+	else if (arg == "-D")
+	{
+		auto const eq = value.find('=');
+
+		if (eq == std::string::npos || eq == 0 || eq + 1 == value.size())
+		{
+			std::cerr << "cbrnc: Invalid dynamic type, expected INNER=CONCRETE: " << value << '\n';
+			return false;
+		}
+
+		opts.settings.dynTypes[value.substr(0, eq)] = value.substr(eq + 1);
+
+	}
+	else if (arg == "-V")
+	{
+		auto found = VALIDATION_LEVELS.find(value);
+
+		if (found == VALIDATION_LEVELS.end())
+		{
+			std::cerr << "cbrnc: Invalid validation level: " << value << '\n';
+			return false;
+		}
+
+		opts.settings.vLvl = found->second;
+
+	}
+
+	return true;
+}
+
+static bool readManifest(const std::string& path, const JobOptions& defaults, std::vector<Job>& jobs)
+{
+	std::string text;
+
+	if (!readFile(path, text))
+	{
+		std::cerr << "cbrnc: Could not read manifest " << path << '\n';
+		return false;
+	}
+
+	std::stringstream lines(text);
+	std::string line;
+	size_t lineNum = 0;
+
+	while (std::getline(lines, line))
+	{
+		++lineNum;
+
+		std::stringstream words(line);
+		std::vector<std::string> args;
+		std::string word;
+
+		while (words >> word)
+		{
+			args.push_back(word);
+		}
+
+		if (args.empty() || args[0][0] == '#')
+		{
+			continue;
+		}
+
+		Job job;
+		job.input = args[0];
+		job.opts = defaults;
+
+		for (size_t i = 1; i < args.size(); ++i)
+		{
+			bool handled;
+
+			if (!parseJobOption(args, i, job.opts, handled))
+			{
+				std::cerr << "cbrnc: ...in " << path << ':' << lineNum << '\n';
+				return false;
+			}
+
+			if (!handled)
+			{
+				std::cerr << "cbrnc: " << path << ':' << lineNum << ": Not a per-job option: " << args[i] << '\n';
+				return false;
+			}
+
+		}
+
+		jobs.push_back(std::move(job));
+
+	}
+
+	return true;
+}
+
+/*
+Parses a thread count. Returns 0 unless the whole value is a number above 0, which fits in a u32.
+*/
+static uint32_t parseThreadCount(const std::string& value)
+{
+	if (value.empty() || !std::isdigit((unsigned char)value[0]))
+	{
+		return 0;
+	}
+
+	errno = 0;
+	char* end = nullptr;
+	auto const n = std::strtoul(value.c_str(), &end, 10);
+
+	if (*end != '\0' || errno == ERANGE || n > UINT32_MAX)
+	{
+		return 0;
+	}
+
+	return (uint32_t)n;
+}
+
+/*
+Makes the directory a file goes in, if it doesn't exist yet. Complains and returns false if it can't.
+*/
+static bool makeParentDir(const std::string& path)
+{
+	auto const parent = fs::path(path).parent_path();
+
+	if (parent.empty())
+	{
+		return true;
+	}
+
+	std::error_code ec;
+	fs::create_directories(parent, ec);
+
+	if (ec)
+	{
+		std::cerr << "cbrnc: Could not make directory " << parent.string() << ": " << ec.message() << '\n';
+		return false;
+	}
+
+	return true;
+}
+
+static void writeDeps(std::ostream& dep, const std::vector<std::string>& outputs, const std::set<std::string>& deps)
+{
+	for (auto const& output : outputs)
+	{
+		dep << escapeDep(output) << ' ';
+	}
+
+	dep << ':';
+
+	for (auto const& d : deps)
+	{
+		dep << ' ' << escapeDep(d);
+	}
+
+	dep << '\n';
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+
+	JobOptions defaults;
+	uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<std::string> inputs;
+	std::vector<std::string> manifests;
+	std::string depfile;
+	bool depfilePerJob = false;
+
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		auto const& arg = args[i];
+		bool handled;
+
+		if (!parseJobOption(args, i, defaults, handled))
+		{
+			return 2;
+		}
+
+		if (handled)
+		{
+			continue;
+		}
+
+		if (arg == "-h" || arg == "--help")
+		{
+			usage();
+			return 0;
+		}
+		else if (arg == "-MD")
+		{
+			depfilePerJob = true;
+		}
+		else if (arg == "-j" || arg == "--cache-dir" || arg == "--module-dir" || arg == "--manifest" || arg == "--depfile")
+		{
+			if (i + 1 >= args.size())
+			{
+				std::cerr << "cbrnc: " << arg << " needs an argument\n";
+				return 2;
+			}
+
+			auto const& value = args[++i];
+
+			if (arg == "-j")
+			{
+				threadCount = parseThreadCount(value);
+
+				if (threadCount == 0)
+				{
+					std::cerr << "cbrnc: -j needs a whole number above 0, not \"" << value << "\"\n";
+					return 2;
+				}
+			}
+			else if (arg == "--cache-dir")
+			{
+				defaults.settings.cacheDir = value;
+			}
+			else if (arg == "--module-dir")
+			{
+				defaults.settings.moduleDir = value;
+			}
+			else if (arg == "--manifest")
+			{
+				manifests.push_back(value);
+			}
+			else
+			{
+				depfile = value;
+			}
+
+		}
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			std::cerr << "cbrnc: Unknown option: " << arg << '\n';
+			usage();
+			return 2;
+		}
+		else
+		{
+			inputs.push_back(arg);
+		}
+
+	}
+
+	std::vector<Job> jobs;
+
+	for (auto const& input : inputs)
+	{
+		Job job;
+		job.input = input;
+		job.opts = defaults;
+
+		jobs.push_back(std::move(job));
+
+	}
+
+	for (auto const& manifest : manifests)
+	{
+		if (!readManifest(manifest, defaults, jobs))
+		{
+			return 2;
+		}
+
+	}
+
+	if (jobs.empty())
+	{
+		usage();
+		return 2;
+	}
+
+	//Every job compiles through compileBatch(), which uses the job's own settings
+	defaults.settings.workerThreads = threadCount;
+	Compiler compiler(defaults.settings);
+
+	//Read and prepare every distinct source once, no matter how many jobs use it
+	std::vector<std::string> sources;
+	std::map<std::string, size_t> sourceIdx;
+
+	for (auto const& job : jobs)
+	{
+		if (sourceIdx.emplace(job.input, sources.size()).second)
+		{
+			sources.push_back(job.input);
+		}
+
+	}
+
+	auto const programs = compiler.prepareProject(sources);
+
+	//Errors found while preparing are checked with each job's own settings, since dynamic types and error formatting
+	//change them; Jobs sharing a source mostly find the same ones, which are only reported once
+	std::set<std::pair<size_t, std::string>> reported;
+	std::vector<BatchJob> batch;
+	std::vector<size_t> batchJobs;
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		auto& job = jobs[i];
+		auto const idx = sourceIdx.at(job.input);
+		auto const errors = compiler.diagnose(programs[idx], job.opts.settings);
+
+		if (!errors.empty())
+		{
+			for (auto const& err : errors)
+			{
+				if (reported.emplace(idx, err).second)
+				{
+					std::cerr << job.input << ": " << err << '\n';
+				}
+
+			}
+
+			job.failed = true;
+			continue;
+		}
+
+		batch.push_back(BatchJob{ programs[idx], job.opts.shaders, job.opts.settings });
+		batchJobs.push_back(i);
+
+	}
+
+	auto const results = compiler.compileBatch(batch);
+
+	for (size_t b = 0; b < batch.size(); ++b)
+	{
+		auto& job = jobs[batchJobs[b]];
+
+		for (auto const& [name, result] : results[b])
+		{
+			if (!result.success())
+			{
+				job.failed = true;
+
+				for (auto const& err : result.errors)
+				{
+					std::cerr << job.input << ": " << err << '\n';
+				}
+
+				continue;
+			}
+
+			for (auto const& shader : result.shaders)
+			{
+				auto const path = job.opts.outDir + "/" + job.opts.prefix + name + "." + STAGE_EXTENSIONS.at(shader->type) + ".spv";
+
+				if (!makeParentDir(path))
+				{
+					job.failed = true;
+					continue;
+				}
+
+				std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+				//SPIR-V is a stream of 32-bit words; Every supported host is little-endian
+				out.write((const char*)shader->code.data(), shader->code.size() * sizeof(uint32_t));
+
+				if (!out)
+				{
+					job.failed = true;
+					std::cerr << "cbrnc: Could not write " << path << '\n';
+
+					continue;
+				}
+
+				job.outputs.push_back(path);
+
+			}
+
+		}
+
+	}
+
+	bool anyFailed = false;
+	std::set<std::string> allDeps(manifests.begin(), manifests.end());
+
+	for (auto const& job : jobs)
+	{
+		anyFailed |= job.failed;
+
+		auto const deps = compiler.dependencies(programs[sourceIdx.at(job.input)]);
+		std::set<std::string> jobDeps(deps.begin(), deps.end());
+
+		//Even if it couldn't be read, so that making it reruns the build
+		jobDeps.insert(job.input);
+		allDeps.insert(jobDeps.begin(), jobDeps.end());
+
+		if (depfilePerJob && !job.outputs.empty())
+		{
+			std::ofstream dep(job.outputs[0] + ".d", std::ios::trunc);
+
+			writeDeps(dep, job.outputs, jobDeps);
+
+		}
+
+	}
+
+	if (!depfile.empty())
+	{
+		if (!makeParentDir(depfile))
+		{
+			return 1;
+		}
+
+		std::vector<std::string> allOutputs;
+
+		for (auto const& job : jobs)
+		{
+			allOutputs.insert(allOutputs.end(), job.outputs.begin(), job.outputs.end());
+		}
+
+		std::ofstream dep(depfile, std::ios::trunc);
+
+		writeDeps(dep, allOutputs, allDeps);
+
+	}
+
+	return anyFailed ? 1 : 0;
+}
@@ -0,0 +1,773 @@
+
+/*
+cbrnd: Long-lived compile server.
+
+Keeps prepared sources and compiled results warm between requests, which build tools and editors send over a Unix
+domain socket instead of starting a new compiler process each time. The standard library is built once, when the first
+source is prepared.
+
+Every request goes through one compiler, whatever its settings, so there's one worker pool and one bounded result cache
+for the whole server. Only the most recently used sources are kept prepared; See MAX_SOURCES.
+
+Usage: cbrnd [-j N] [--cache-dir DIR] SOCKET
+
+PROTOCOL
+
+Every message, in either direction, is a frame: A u32 payload length, then the payload. All integers are little-endian
+u32s. A string is a u32 length followed by that many bytes. Clients may send any number of requests on one connection;
+Each one gets exactly one response, in order.
+
+Request payload:
+	u32 kind (see RequestKind)
+
+	COMPILE:
+		string path			Identifies the source; Sources with the same path are prepared incrementally from one another.
+		string src			The source text. If empty, the server reads the file at path instead; If it can't, the
+							response is COMPILE_ERRORS, with one nameless result saying so.
+		u32 optLevel		OptimizeLevel; Values past the last level are malformed
+		u32 validation		ValidationLevel; Same as above
+		u32 dynTypeCount	Followed by that many (string inner, string concrete) pairs
+		u32 shaderCount		Followed by that many strings; If 0, every shader object is compiled
+
+	STATS, SHUTDOWN: No fields.
+
+Response payload:
+	u32 status (see ResponseStatus)
+
+	COMPILE:
+		u32 resultCount, followed by that many results:
+			string name
+			u32 errorCount, followed by that many strings
+			u32 shaderCount, followed by that many shaders:
+				u32 type			ShaderType
+				u32 wordCount		Followed by that many SPIR-V words
+
+	STATS:
+		u32 requests, u32 preparedSources, then the result cache's hits, misses, evictions, entries, and bytes, as u32s
+		each (saturated).
+
+	SHUTDOWN: No fields. The server stops accepting connections and exits once the response is sent.
+
+Malformed requests, and frames longer than MAX_FRAME_SIZE, get a PROTOCOL_ERROR response with one string describing the
+problem, then the connection is closed.
+*/
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "caliburn.h"
+
+using namespace caliburn;
+
+enum class RequestKind : uint32_t
+{
+	COMPILE = 1,
+	STATS = 2,
+	SHUTDOWN = 3
+};
+
+enum class ResponseStatus : uint32_t
+{
+	//Every shader compiled
+	OK = 0,
+	//The request was fine, but some shaders had errors
+	COMPILE_ERRORS = 1,
+	PROTOCOL_ERROR = 2
+};
+
+//Anything bigger is assumed to be garbage, rather than a very large source
+static constexpr uint32_t MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
+//Prepared sources kept between requests; Past this, the least recently used one is dropped
+static constexpr size_t MAX_SOURCES = 256;
+
+//How long to wait before accepting again, when out of file descriptors
+static constexpr auto ACCEPT_BACKOFF = std::chrono::milliseconds(100);
+
+enum class FrameStatus
+{
+	OK,
+	CLOSED,
+	TOO_LARGE
+};
+
+/*
+Reads fields out of a request payload. Running past the end sets failed, and returns zeroes from then on.
+*/
+struct FrameReader
+{
+	const std::string& data;
+	size_t off = 0;
+	bool failed = false;
+
+	FrameReader(const std::string& d) : data(d) {}
+
+	uint32_t u32()
+	{
+		if (failed || data.size() - off < 4)
+		{
+			failed = true;
+			return 0;
+		}
+
+		auto const bytes = (const unsigned char*)data.data() + off;
+		off += 4;
+
+		return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	}
+
+	std::string str()
+	{
+		auto const len = u32();
+
+		if (failed || data.size() - off < len)
+		{
+			failed = true;
+			return "";
+		}
+
+		auto s = data.substr(off, len);
+		off += len;
+
+		return s;
+	}
+
+};
+
+struct FrameWriter
+{
+	std::string data;
+
+	void u32(uint32_t v)
+	{
+		data.push_back((char)(v & 0xFF));
+		data.push_back((char)((v >> 8) & 0xFF));
+		data.push_back((char)((v >> 16) & 0xFF));
+		data.push_back((char)((v >> 24) & 0xFF));
+	}
+
+	void str(const std::string& s)
+	{
+		u32((uint32_t)s.size());
+		data += s;
+	}
+
+};
+
+static bool readAll(int fd, char* buf, size_t len)
+{
+	while (len > 0)
+	{
+		auto const got = read(fd, buf, len);
+
+		if (got <= 0)
+		{
+			return false;
+		}
+
+		buf += got;
+		len -= (size_t)got;
+	}
+
+	return true;
+}
+
+static bool writeAll(int fd, const char* buf, size_t len)
+{
+	while (len > 0)
+	{
+		auto const sent = send(fd, buf, len, MSG_NOSIGNAL);
+
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		buf += sent;
+		len -= (size_t)sent;
+	}
+
+	return true;
+}
+
+static FrameStatus readFrame(int fd, std::string& payload)
+{
+	char lenBytes[4];
+
+	if (!readAll(fd, lenBytes, 4))
+	{
+		return FrameStatus::CLOSED;
+	}
+
+	auto const len = FrameReader(std::string(lenBytes, 4)).u32();
+
+	if (len > MAX_FRAME_SIZE)
+	{
+		return FrameStatus::TOO_LARGE;
+	}
+
+	payload.resize(len);
+
+	return readAll(fd, payload.data(), len) ? FrameStatus::OK : FrameStatus::CLOSED;
+}
+
+static bool writeFrame(int fd, const std::string& payload)
+{
+	FrameWriter len;
+	len.u32((uint32_t)payload.size());
+
+	return writeAll(fd, len.data.data(), 4) && writeAll(fd, payload.data(), payload.size());
+}
+
+static uint32_t saturate(uint64_t v)
+{
+	return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+/*
+Everything kept warm between requests.
+*/
+struct Server
+{
+	struct Source
+	{
+		std::string path;
+		std::string text;
+		std::shared_ptr<const PreparedProgram> program;
+
+	};
+
+	const CompilerSettings defaults;
+
+	//Settings only change per request, so every request shares this, along with its pool and result cache
+	Compiler compiler;
+
+	std::mutex lock;
+
+	//Front is the most recently used
+	std::list<std::shared_ptr<Source>> sourceLru;
+	std::map<std::string, std::list<std::shared_ptr<Source>>::iterator> sources;
+
+	std::atomic<uint64_t> requests = 0;
+	std::atomic<bool> stopping = false;
+
+	//Connections still being served; Shutting down waits for them
+	std::mutex connLock;
+	std::condition_variable connDone;
+	std::set<int> openFds;
+
+	Server(const CompilerSettings& cs) : defaults(cs), compiler(cs) {}
+
+	/*
+	Returns the program for a path, preparing it only if the text changed since the last request for it. Changes are
+	narrowed down to a single edit, so only the declarations around it are parsed again.
+	*/
+	std::shared_ptr<const PreparedProgram> programFor(const std::string& path, const std::string& text)
+	{
+		std::shared_ptr<Source> prev;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			auto found = sources.find(path);
+
+			if (found != sources.end())
+			{
+				prev = *found->second;
+				sourceLru.splice(sourceLru.begin(), sourceLru, found->second);
+			}
+
+		}
+
+		if (prev != nullptr && prev->text == text)
+		{
+			return prev->program;
+		}
+
+		auto next = std::make_shared<Source>();
+		next->path = path;
+		next->text = text;
+
+		if (prev == nullptr)
+		{
+			next->program = compiler.prepare(text);
+		}
+		else
+		{
+			//The edit covers everything between the common prefix and the common suffix
+			auto const& old = prev->text;
+			auto const maxCommon = std::min(old.size(), text.size());
+
+			size_t prefix = 0;
+
+			while (prefix < maxCommon && old[prefix] == text[prefix])
+			{
+				++prefix;
+			}
+
+			size_t suffix = 0;
+
+			while (suffix < maxCommon - prefix && old[old.size() - 1 - suffix] == text[text.size() - 1 - suffix])
+			{
+				++suffix;
+			}
+
+			next->program = compiler.reprepare(prev->program, text, TextEdit{ prefix, old.size() - prefix - suffix, text.size() - prefix - suffix });
+
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		//Another request for the same path may have gotten here first
+		auto found = sources.find(path);
+
+		if (found != sources.end())
+		{
+			sourceLru.erase(found->second);
+			sources.erase(found);
+		}
+
+		sourceLru.push_front(next);
+		sources.emplace(path, sourceLru.begin());
+
+		while (sources.size() > MAX_SOURCES)
+		{
+			sources.erase(sourceLru.back()->path);
+			sourceLru.pop_back();
+		}
+
+		return next->program;
+	}
+
+	void compile(FrameReader& req, FrameWriter& resp)
+	{
+		auto const path = req.str();
+		auto text = req.str();
+
+		auto cs = defaults;
+		auto const o = req.u32();
+		auto const vLvl = req.u32();
+
+		cs.o = (OptimizeLevel)o;
+		cs.vLvl = (ValidationLevel)vLvl;
+
+		auto const dynCount = req.u32();
+
+		for (uint32_t i = 0; i < dynCount && !req.failed; ++i)
+		{
+			auto inner = req.str();
+			cs.dynTypes[inner] = req.str();
+		}
+
+		std::vector<std::string> names;
+		auto const nameCount = req.u32();
+
+		for (uint32_t i = 0; i < nameCount && !req.failed; ++i)
+		{
+			names.push_back(req.str());
+		}
+
+		if (req.failed || req.off != req.data.size())
+		{
+			resp.u32((uint32_t)ResponseStatus::PROTOCOL_ERROR);
+			resp.str("Malformed COMPILE request");
+			return;
+		}
+
+		//Both come straight from the client, so they can't be trusted to name a real level
+		if (o > (uint32_t)OptimizeLevel::PERFORMANCE || vLvl > (uint32_t)ValidationLevel::FULL)
+		{
+			resp.u32((uint32_t)ResponseStatus::PROTOCOL_ERROR);
+			resp.str("Unknown optimization or validation level");
+			return;
+		}
+
+		if (text.empty())
+		{
+			std::ifstream file(path, std::ios::binary);
+
+			if (!file.is_open())
+			{
+				errorResult(resp, "Could not read file: " + path);
+				return;
+			}
+
+			std::stringstream ss;
+			ss << file.rdbuf();
+			text = ss.str();
+		}
+
+		auto program = programFor(path, text);
+
+		std::map<std::string, std::shared_ptr<const ShaderResult>> results;
+
+		if (names.empty())
+		{
+			for (auto& [name, result] : compiler.compilePermutations(program, {}, { cs })[0])
+			{
+				results[name] = std::make_shared<const ShaderResult>(std::move(result));
+			}
+
+		}
+		else
+		{
+			for (auto const& name : names)
+			{
+				results[name] = compiler.compilePreparedCached(program, name, cs);
+			}
+
+		}
+
+		bool success = true;
+
+		for (auto const& [_, result] : results)
+		{
+			success &= result->success();
+		}
+
+		resp.u32((uint32_t)(success ? ResponseStatus::OK : ResponseStatus::COMPILE_ERRORS));
+		resp.u32((uint32_t)results.size());
+
+		for (auto const& [name, result] : results)
+		{
+			resp.str(name);
+			resp.u32((uint32_t)result->errors.size());
+
+			for (auto const& err : result->errors)
+			{
+				resp.str(err);
+			}
+
+			resp.u32((uint32_t)result->shaders.size());
+
+			for (auto const& shader : result->shaders)
+			{
+				resp.u32((uint32_t)shader->type);
+				resp.u32((uint32_t)shader->code.size());
+
+				for (auto word : shader->code)
+				{
+					resp.u32(word);
+				}
+
+			}
+
+		}
+
+	}
+
+	/*
+	Answers a COMPILE request which couldn't get as far as compiling, or threw partway through, with one nameless result
+	holding the error.
+	*/
+	static void errorResult(FrameWriter& resp, const std::string& msg)
+	{
+		resp.u32((uint32_t)ResponseStatus::COMPILE_ERRORS);
+		resp.u32(1);
+
+		resp.str("");
+		resp.u32(1);
+		resp.str(msg);
+		resp.u32(0);
+
+	}
+
+	void stats(FrameWriter& resp)
+	{
+		auto const total = compiler.getCacheStats();
+		uint64_t sourceCount = 0;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			sourceCount = sources.size();
+		}
+
+		resp.u32((uint32_t)ResponseStatus::OK);
+		resp.u32(saturate(requests));
+		resp.u32(saturate(sourceCount));
+		resp.u32(saturate(total.hits));
+		resp.u32(saturate(total.misses));
+		resp.u32(saturate(total.evictions));
+		resp.u32(saturate(total.entries));
+		resp.u32(saturate(total.bytes));
+
+	}
+
+	/*
+	Serves one connection until the client hangs up, or asks the server to shut down.
+	*/
+	void serve(int fd, int listenFd)
+	{
+		std::string payload;
+
+		while (true)
+		{
+			auto const frame = readFrame(fd, payload);
+
+			if (frame == FrameStatus::TOO_LARGE)
+			{
+				FrameWriter resp;
+				resp.u32((uint32_t)ResponseStatus::PROTOCOL_ERROR);
+				resp.str("Frame is larger than " + std::to_string(MAX_FRAME_SIZE) + " bytes");
+
+				writeFrame(fd, resp.data);
+			}
+
+			if (frame != FrameStatus::OK)
+			{
+				break;
+			}
+
+			++requests;
+
+			FrameReader req(payload);
+			FrameWriter resp;
+
+			auto const kind = (RequestKind)req.u32();
+			bool keepGoing = true;
+
+			if (kind == RequestKind::COMPILE)
+			{
+				//The tokenizer throws on some malformed sources; That's one bad request, not a reason to take the server down
+				try
+				{
+					compile(req, resp);
+				}
+				catch (std::exception const& e)
+				{
+					resp = FrameWriter();
+					errorResult(resp, "Internal compiler error: " + std::string(e.what()));
+				}
+				catch (...)
+				{
+					resp = FrameWriter();
+					errorResult(resp, "Internal compiler error");
+				}
+
+			}
+			else if (kind == RequestKind::STATS)
+			{
+				stats(resp);
+			}
+			else if (kind == RequestKind::SHUTDOWN)
+			{
+				resp.u32((uint32_t)ResponseStatus::OK);
+				keepGoing = false;
+			}
+			else
+			{
+				resp.u32((uint32_t)ResponseStatus::PROTOCOL_ERROR);
+				resp.str("Unknown request kind");
+			}
+
+			if (!writeFrame(fd, resp.data))
+			{
+				break;
+			}
+
+			if (kind == RequestKind::SHUTDOWN)
+			{
+				stopping = true;
+				//Wakes the accept loop up
+				shutdown(listenFd, SHUT_RDWR);
+
+				//Other clients finish their current request, but don't get to send another
+				std::lock_guard<std::mutex> guard(connLock);
+
+				for (auto other : openFds)
+				{
+					if (other != fd)
+					{
+						shutdown(other, SHUT_RD);
+					}
+
+				}
+
+			}
+
+			if (!keepGoing || FrameReader(resp.data).u32() == (uint32_t)ResponseStatus::PROTOCOL_ERROR)
+			{
+				break;
+			}
+
+		}
+
+		close(fd);
+
+		//Notified under the lock; Otherwise main() could see no connections left and destroy the server first
+		std::lock_guard<std::mutex> guard(connLock);
+
+		openFds.erase(fd);
+		connDone.notify_all();
+
+	}
+
+};
+
+/*
+Parses a thread count. Returns 0 unless the whole value is a number above 0, which fits in a u32.
+*/
+static uint32_t parseThreadCount(const std::string& value)
+{
+	if (value.empty() || !std::isdigit((unsigned char)value[0]))
+	{
+		return 0;
+	}
+
+	errno = 0;
+	char* end = nullptr;
+	auto const n = std::strtoul(value.c_str(), &end, 10);
+
+	if (*end != '\0' || errno == ERANGE || n > UINT32_MAX)
+	{
+		return 0;
+	}
+
+	return (uint32_t)n;
+}
+
+int main(int argc, char** argv)
+{
+	CompilerSettings cs;
+	std::string socketPath;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if ((arg == "-j" || arg == "--cache-dir") && i + 1 < argc)
+		{
+			std::string value = argv[++i];
+
+			if (arg == "-j")
+			{
+				cs.workerThreads = parseThreadCount(value);
+
+				if (cs.workerThreads == 0)
+				{
+					std::cerr << "cbrnd: -j needs a whole number above 0, not \"" << value << "\"\n";
+					return 2;
+				}
+			}
+			else
+			{
+				cs.cacheDir = value;
+			}
+
+		}
+		else if (socketPath.empty() && !arg.empty() && arg[0] != '-')
+		{
+			socketPath = arg;
+		}
+		else
+		{
+			std::cerr << "Usage: cbrnd [-j N] [--cache-dir DIR] SOCKET\n";
+			return 2;
+		}
+
+	}
+
+	if (socketPath.empty())
+	{
+		std::cerr << "Usage: cbrnd [-j N] [--cache-dir DIR] SOCKET\n";
+		return 2;
+	}
+
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+
+	if (socketPath.size() >= sizeof(addr.sun_path))
+	{
+		std::cerr << "cbrnd: Socket path is too long: " << socketPath << '\n';
+		return 2;
+	}
+
+	socketPath.copy(addr.sun_path, socketPath.size());
+
+	int const listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	//A socket file left over from a server which didn't shut down cleanly would make bind() fail
+	unlink(socketPath.c_str());
+
+	if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0)
+	{
+		std::cerr << "cbrnd: Could not listen on " << socketPath << '\n';
+		return 1;
+	}
+
+	Server server(cs);
+	int exitCode = 0;
+
+	while (!server.stopping)
+	{
+		int const fd = accept(listenFd, nullptr, nullptr);
+
+		if (fd < 0)
+		{
+			//Out of file descriptors or memory; Give open connections a chance to close, instead of spinning
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+			{
+				std::this_thread::sleep_for(ACCEPT_BACKOFF);
+				continue;
+			}
+
+			if (errno == EINTR || errno == ECONNABORTED || server.stopping)
+			{
+				continue;
+			}
+
+			std::cerr << "cbrnd: Could not accept connections: " << std::strerror(errno) << '\n';
+			exitCode = 1;
+
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(server.connLock);
+
+			if (server.stopping)
+			{
+				close(fd);
+				break;
+			}
+
+			server.openFds.insert(fd);
+
+		}
+
+		//Detached, since a long-running server can go through any number of connections
+		std::thread(&Server::serve, &server, fd, listenFd).detach();
+
+	}
+
+	{
+		std::unique_lock<std::mutex> guard(server.connLock);
+		server.connDone.wait(guard, [&]() { return server.openFds.empty(); });
+	}
+
+	close(listenFd);
+	unlink(socketPath.c_str());
+
+	return exitCode;
+}